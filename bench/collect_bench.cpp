@@ -0,0 +1,186 @@
+#include "metrics_library.h"
+#include "segment_archiver.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+/*
+    Сквозной бенчмарк сбора и записи: MetricsCollector::collectAndWrite с заданным интервалом
+    и MetricsWriter, пишущий снимки в файл на общем исполнителе ввода-вывода.
+    Для каждой пары (число метрик, интервал) в течение заданного времени выводит:
+      - процентили длительности такта сбора (collectAndWrite: сбор значений и передача снимка);
+      - байт в секунду, записанных в файл (с учетом дописывания очереди после последнего такта);
+      - глубину очереди писателя по времени (WriterStats::queued после каждого такта);
+      - процессорное время записи (время процесса без времени потока сбора) и потока сбора.
+
+    Перед каждым тактом все метрики обновляются (вне измерения длительности такта, но во времени
+    потока сбора), чтобы записывались настоящие значения, а не нули после сброса. Такт, начавшийся позже своего срока,
+    считается опоздавшим; если очередь писателя держит больше kMaxQueuedSamples значений,
+    такт пропускается, чтобы отставший писатель не исчерпал память.
+
+    Запуск: ./collect_bench [длительность_с] [числа_метрик] [интервалы_мс]
+    Списки — через запятую, по умолчанию 1000,100000,1000000 и 10,100,1000.
+*/
+
+namespace {
+
+constexpr std::size_t kMaxQueuedSamples = 4000000;
+
+std::vector<long> parseList(const char *text) {
+    std::vector<long> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        values.push_back(std::strtol(item.c_str(), nullptr, 10));
+    }
+    return values;
+}
+
+double cpuSeconds(const timeval &user, const timeval &system) {
+    return static_cast<double>(user.tv_sec + system.tv_sec) + (user.tv_usec + system.tv_usec) / 1e6;
+}
+
+// Процессорное время процесса
+double processCpu() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return cpuSeconds(usage.ru_utime, usage.ru_stime);
+}
+
+// Процессорное время текущего потока
+double threadCpu() {
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<double>(time.tv_sec) + time.tv_nsec / 1e9;
+}
+
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Удаляет файл и его сегменты после ротации
+void removeOutput(const std::string &filename) {
+    std::remove(filename.c_str());
+    for (const auto &segment : SegmentArchiver::listSegments(filename)) {
+        std::remove(segment.c_str());
+    }
+}
+
+void run(long metric_count, long interval_ms, double duration) {
+    std::vector<std::shared_ptr<Gauge>> gauges;
+    std::vector<std::shared_ptr<Counter>> counters;
+    MetricsCollector collector;
+    for (long i = 0; i < metric_count; ++i) {
+        if (i % 2 == 0) {
+            gauges.push_back(std::make_shared<Gauge>("metric_" + std::to_string(i)));
+            collector.addMetric(gauges.back());
+        } else {
+            counters.push_back(std::make_shared<Counter>("metric_" + std::to_string(i)));
+            collector.addMetric(counters.back());
+        }
+    }
+
+    WriterOptions options;
+    options.flush_bytes = 64 * 1024;
+    options.flush_interval = std::chrono::milliseconds(1000);
+    // Ограничивает место на диске при больших снимках
+    options.rotate_bytes = 256ull * 1024 * 1024;
+    options.retention = 1;
+    auto writer = std::make_shared<MetricsWriter>("bench_collect.out", options);
+    collector.addSink(writer);
+
+    const std::size_t queue_limit = std::max<std::size_t>(kMaxQueuedSamples / metric_count, 1);
+    const auto interval = std::chrono::milliseconds(interval_ms);
+    std::vector<double> tick_ms;
+    std::vector<std::size_t> depths;
+    std::size_t late = 0;
+    std::size_t skipped = 0;
+
+    double process_start = processCpu();
+    double collector_start = threadCpu();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+    auto next = start;
+    for (std::size_t tick = 0; next < end && std::chrono::steady_clock::now() < end; ++tick, next += interval) {
+        for (std::size_t i = 0; i < gauges.size(); ++i) {
+            gauges[i]->update(static_cast<double>((i + tick) % 1000) * 0.25);
+        }
+        for (std::size_t i = 0; i < counters.size(); ++i) {
+            counters[i]->increment(static_cast<int>((i + tick) % 100));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < next) {
+            std::this_thread::sleep_until(next);
+        } else if (now - next > interval / 10) {
+            ++late;
+        }
+        if (writer->getStats().queued >= queue_limit) {
+            ++skipped;
+            depths.push_back(writer->getStats().queued);
+            continue;
+        }
+        auto tick_start = std::chrono::steady_clock::now();
+        collector.collectAndWrite();
+        tick_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tick_start).count());
+        depths.push_back(writer->getStats().queued);
+    }
+    double collector_cpu = threadCpu() - collector_start;
+    writer->flush();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double writer_cpu = processCpu() - process_start - collector_cpu;
+    WriterStats stats = writer->getStats();
+
+    std::vector<double> sorted = tick_ms;
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << std::right << std::setw(8) << metric_count << std::setw(8) << interval_ms << std::setw(7)
+              << tick_ms.size() << std::setw(6) << late << std::setw(6) << skipped << std::fixed
+              << std::setprecision(2) << std::setw(10) << percentile(sorted, 0.50) << std::setw(10)
+              << percentile(sorted, 0.90) << std::setw(10) << percentile(sorted, 0.99) << std::setw(10)
+              << (sorted.empty() ? 0.0 : sorted.back()) << std::setprecision(1) << std::setw(9)
+              << stats.bytes / elapsed / 1e6 << std::setw(9) << writer_cpu / elapsed * 100 << "%" << std::setw(8)
+              << collector_cpu / elapsed * 100 << "%\n";
+
+    // Глубина очереди по времени: не больше 20 точек на прогон
+    std::cout << "        queue depth:";
+    std::size_t step = std::max<std::size_t>(depths.size() / 20, 1);
+    for (std::size_t i = 0; i < depths.size(); i += step) {
+        std::cout << ' ' << depths[i];
+    }
+    std::cout << "  (max " << (depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end()))
+              << ", every " << step << " ticks)\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    double duration = argc > 1 ? std::strtod(argv[1], nullptr) : 5.0;
+    std::vector<long> metric_counts = parseList(argc > 2 ? argv[2] : "1000,100000,1000000");
+    std::vector<long> intervals = parseList(argc > 3 ? argv[3] : "10,100,1000");
+
+    std::cout << " metrics   every  ticks  late  skip   p50 ms    p90 ms    p99 ms    max ms     MB/s   writer  collect\n";
+    for (long metric_count : metric_counts) {
+        for (long interval_ms : intervals) {
+            if (metric_count > 0 && interval_ms > 0) {
+                run(metric_count, interval_ms, duration);
+                removeOutput("bench_collect.out");
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "metrics_library.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Бенчмарк конкуренции на путях обновления метрик: Counter::increment, Gauge::update
+    и Histogram::observe для 1..N потоков.
+    Режим same — все потоки обновляют одну метрику, distinct — у каждого потока своя.
+    Для каждого прогона выводятся среднее время операции в потоке (ns/op), общая
+    пропускная способность (ops/s) и процентили времени операции.
+
+    Процентили считаются по пачкам из kBatch операций (время пачки / kBatch): измерение
+    каждой операции часами стоит больше самой операции и исказило бы результат.
+
+    Результаты дополнительно записываются в JSON-файл для сравнения между версиями.
+
+    Запуск: ./contention_bench [операций_на_поток] [максимум_потоков] [файл_json]
+*/
+
+namespace {
+
+constexpr std::size_t kBatch = 64;
+
+// Путь обновления: создает метрику и выполняет над ней одну операцию
+struct UpdatePath
+{
+    const char *name;
+    std::function<std::shared_ptr<Metric>()> create;
+    std::function<void(Metric &, std::size_t)> update;
+};
+
+struct Result
+{
+    std::string metric;
+    std::string mode;
+    int threads = 0;
+    double ns_per_op = 0.0;
+    double ops_per_sec = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+Result run(const UpdatePath &path, bool same, int threads, std::size_t ops) {
+    std::vector<std::shared_ptr<Metric>> metrics;
+    for (int t = 0; t < (same ? 1 : threads); ++t) {
+        metrics.push_back(path.create());
+    }
+
+    std::size_t batches = std::max<std::size_t>(ops / kBatch, 1);
+    std::vector<std::vector<double>> batch_ns(threads);
+    std::vector<double> thread_seconds(threads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            Metric &metric = *metrics[same ? 0 : t];
+            std::vector<double> &samples = batch_ns[t];
+            samples.reserve(batches);
+            // Все потоки начинают одновременно, чтобы конкуренция шла на всем прогоне
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            auto start = std::chrono::steady_clock::now();
+            auto batch_start = start;
+            for (std::size_t b = 0; b < batches; ++b) {
+                for (std::size_t i = 0; i < kBatch; ++i) {
+                    path.update(metric, b * kBatch + i);
+                }
+                auto now = std::chrono::steady_clock::now();
+                samples.push_back(std::chrono::duration<double, std::nano>(now - batch_start).count() / kBatch);
+                batch_start = now;
+            }
+            thread_seconds[t] = std::chrono::duration<double>(batch_start - start).count();
+        });
+    }
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    all.reserve(batches * threads);
+    double busy = 0.0;
+    for (int t = 0; t < threads; ++t) {
+        all.insert(all.end(), batch_ns[t].begin(), batch_ns[t].end());
+        busy += thread_seconds[t];
+    }
+    std::sort(all.begin(), all.end());
+
+    Result result;
+    result.metric = path.name;
+    result.mode = same ? "same" : "distinct";
+    result.threads = threads;
+    std::size_t done = batches * kBatch;
+    result.ns_per_op = busy * 1e9 / (static_cast<double>(done) * threads);
+    result.ops_per_sec = static_cast<double>(done) * threads / wall;
+    result.p50 = percentile(all, 0.50);
+    result.p90 = percentile(all, 0.90);
+    result.p99 = percentile(all, 0.99);
+    result.p999 = percentile(all, 0.999);
+    result.max = all.empty() ? 0.0 : all.back();
+    return result;
+}
+
+void print(const Result &result) {
+    std::cout << std::left << std::setw(11) << result.metric << std::setw(10) << result.mode << std::right
+              << std::setw(7) << result.threads << std::fixed << std::setprecision(1) << std::setw(11)
+              << result.ns_per_op << std::setw(10) << result.ops_per_sec / 1e6 << std::setw(9) << result.p50
+              << std::setw(9) << result.p90 << std::setw(9) << result.p99 << std::setw(10) << result.p999
+              << std::setw(11) << result.max << "\n";
+}
+
+void writeJson(const std::string &filename, std::size_t ops, const std::vector<Result> &results) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "{\n  \"benchmark\": \"contention_bench\",\n  \"ops_per_thread\": " << ops
+        << ",\n  \"batch\": " << kBatch << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency()
+        << ",\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        out << "    {\"metric\": \"" << r.metric << "\", \"mode\": \"" << r.mode << "\", \"threads\": " << r.threads
+            << ", \"ns_per_op\": " << r.ns_per_op << ", \"ops_per_sec\": " << r.ops_per_sec
+            << ", \"p50_ns\": " << r.p50 << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+            << ", \"p999_ns\": " << r.p999 << ", \"max_ns\": " << r.max << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+
+    std::ofstream file(filename);
+    file << out.str();
+    if (!file) {
+        std::cerr << "Cannot write " << filename << "\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(hardware);
+    std::string json = argc > 3 ? argv[3] : "contention_bench.json";
+
+    const std::vector<UpdatePath> paths = {
+        {"counter", [] { return std::make_shared<Counter>("bench_counter"); },
+         [](Metric &metric, std::size_t) { static_cast<Counter &>(metric).increment(); }},
+        {"gauge", [] { return std::make_shared<Gauge>("bench_gauge"); },
+         [](Metric &metric, std::size_t i) { static_cast<Gauge &>(metric).update(static_cast<double>(i & 1023)); }},
+        {"histogram",
+         [] { return std::make_shared<Histogram>("bench_histogram", std::vector<double>{1, 5, 10, 50, 100, 500}); },
+         [](Metric &metric, std::size_t i) {
+             static_cast<Histogram &>(metric).observe(static_cast<double>(i & 1023));
+         }},
+    };
+
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    if (max_threads > 0 && thread_counts.back() != max_threads) {
+        thread_counts.push_back(max_threads);
+    }
+
+    std::cout << "metric     mode      threads    ns/op   M ops/s      p50      p90      p99     p99.9        max\n";
+    std::vector<Result> results;
+    for (const UpdatePath &path : paths) {
+        for (bool same : {true, false}) {
+            for (int threads : thread_counts) {
+                results.push_back(run(path, same, threads, ops));
+                print(results.back());
+            }
+        }
+    }
+    writeJson(json, ops, results);
+    std::cout << "\nJSON: " << json << "\n";
+    return 0;
+}
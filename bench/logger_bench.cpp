@@ -0,0 +1,122 @@
+#include "logger.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Бенчмарк стоимости вызова журнала для вызывающего потока.
+    Сравнивает прежнюю схему (глобальный мьютекс, открытие std::ofstream, форматирование
+    метки времени и закрытие файла на каждый вызов) с асинхронным Logger для 1..N потоков.
+    Время включает построение сообщения, как в src/main.cpp ("..." + std::to_string(value)).
+    Режим LogFormat::Binary (METRICS_LOG_INFO без форматирования, запись номера места вызова
+    и аргумента в буфер потока) измеряется на тех же вызовах.
+    Отдельно измеряется стоимость записи ниже порога уровня: logInfo() со строкой, собранной
+    вызывающим, против METRICS_LOG_INFO, который проверяет уровень до форматирования.
+
+    Запуск: ./logger_bench [вызовов_на_поток] [максимум_потоков]
+*/
+
+namespace {
+
+// Прежняя реализация Logger::logInfo
+class SyncLogger
+{
+public:
+    void logInfo(const std::string &message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ofstream log_file("bench_logger_sync.log", std::ios::app);
+        if (log_file.is_open()) {
+            char timestamp[TimestampFormatter::kLength];
+            timestamps_.format(std::chrono::system_clock::now(), timestamp);
+            log_file.write(timestamp, TimestampFormatter::kSecondsLength);
+            log_file << " [INFO] " << message << std::endl;
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    TimestampFormatter timestamps_;
+};
+
+template <typename Log>
+void run(const char *name, int threads, std::size_t calls, Log log) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&log, calls] {
+            for (std::size_t i = 0; i < calls; ++i) {
+                log(i);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Каждый поток выполнял calls вызовов за все время работы
+    std::cout << std::left << std::setw(10) << name << std::right << std::setw(8) << threads << std::fixed
+              << std::setprecision(1) << std::setw(14) << seconds * 1e9 / calls << " ns/call" << std::setw(12)
+              << threads * calls / seconds / 1e6 << " M calls/s\n";
+}
+
+// Стоимость вызова, отброшенного порогом уровня
+template <typename Log>
+void runDisabled(const char *name, std::size_t calls, Log log) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < calls; ++i) {
+        log(i);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << seconds * 1e9 / calls << " ns/call\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t calls = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : 4;
+
+    std::cout << "logger     threads      per call   throughput\n";
+    SyncLogger sync;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        run("sync", threads, calls / 10,
+            [&sync](std::size_t i) { sync.logInfo("CPU usage simulated: " + std::to_string(i)); });
+    }
+    std::remove("bench_logger_sync.log");
+
+    Logger &logger = Logger::getInstance();
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::uint64_t dropped = logger.droppedRecords();
+        run("async", threads, calls,
+            [&logger](std::size_t i) { logger.logInfo("CPU usage simulated: " + std::to_string(i)); });
+        logger.flush();
+        std::cout << "           dropped on full queue: " << logger.droppedRecords() - dropped << "\n";
+    }
+
+    logger.setLogFormat(LogFormat::Binary);
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::uint64_t dropped = logger.droppedRecords();
+        run("binary", threads, calls, [](std::size_t i) { METRICS_LOG_INFO("CPU usage simulated: {}", i); });
+        logger.flush();
+        std::cout << "           dropped on full buffer: " << logger.droppedRecords() - dropped << "\n";
+    }
+    logger.setLogFormat(LogFormat::Text);
+
+    // Записи INFO при пороге WARN
+    logger.setLevel(LogLevel::Warn);
+    std::cout << "\ndisabled level     per call\n";
+    runDisabled("eager logInfo", calls, [&logger](std::size_t i) {
+        logger.logInfo("CPU usage simulated: " + std::to_string(i));
+    });
+    runDisabled("METRICS_LOG_INFO", calls, [](std::size_t i) { METRICS_LOG_INFO("CPU usage simulated: {}", i); });
+    logger.setLevel(LogLevel::Info);
+    return 0;
+}
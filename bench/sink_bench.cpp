@@ -0,0 +1,205 @@
+#include "influx_sink.h"
+#include "memory_sink.h"
+#include "metrics_library.h"
+#include "otlp_encoder.h"
+#include "prometheus_exporter.h"
+#include "statsd_sink.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+    Бенчмарк пропускной способности встроенных получателей снимков (Sink).
+    Для каждого получателя передает count заранее собранных снимков по metrics метрик
+    и измеряет время до записи (отправки) последнего из них: снимки/с и МБ/с на выходе.
+    Отдельно сравнивает два текстовых получателя одного сборщика с общим кодированием полей
+    (Snapshot::shared_encodings) и без него.
+
+    Запуск: ./sink_bench [число_снимков] [число_метрик]
+*/
+
+namespace {
+
+using Snapshots = std::vector<std::shared_ptr<const Snapshot>>;
+
+// Снимки с чередующимися метриками Gauge и Counter; shared — маска общих представлений
+Snapshots makeSnapshots(std::size_t count, int metrics, std::uint32_t shared = 0) {
+    Snapshot base;
+    for (int i = 0; i < metrics; ++i) {
+        MetricSample sample;
+        sample.name = "metric_" + std::to_string(i);
+        if (i % 2 == 0) {
+            sample.type = MetricType::Gauge;
+            sample.gauge = i * 7.25;
+        } else {
+            sample.type = MetricType::Counter;
+            sample.counter = i * 1000;
+        }
+        base.samples.push_back(sample);
+    }
+    base.shared_encodings = shared;
+    Snapshots snapshots;
+    snapshots.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        snapshots.push_back(std::make_shared<const Snapshot>(base));
+    }
+    return snapshots;
+}
+
+void report(const char *name, std::size_t count, std::chrono::steady_clock::duration elapsed, std::uint64_t bytes) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << count / seconds << " snapshots/s" << std::setprecision(1) << std::setw(10)
+              << bytes / seconds / 1e6 << " MB/s" << "  (" << bytes << " bytes)\n";
+}
+
+// Передает снимки публикатору publish; finish дожидается записи и возвращает число байт на выходе
+void run(const char *name, const Snapshots &snapshots, const std::function<void(std::shared_ptr<const Snapshot>)> &publish,
+         const std::function<std::uint64_t()> &finish) {
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &snapshot : snapshots) {
+        publish(snapshot);
+    }
+    std::uint64_t bytes = finish();
+    report(name, snapshots.size(), std::chrono::steady_clock::now() - start, bytes);
+}
+
+void runWriter(const char *name, const Snapshots &snapshots, OutputFormat format) {
+    const std::string filename = "bench_sink.out";
+    std::remove(filename.c_str());
+    WriterOptions options;
+    options.format = format;
+    options.flush_bytes = 64 * 1024;
+    options.flush_interval = std::chrono::milliseconds(1000);
+    {
+        MetricsWriter writer(filename, options);
+        run(name, snapshots, [&](std::shared_ptr<const Snapshot> snapshot) { writer.publish(std::move(snapshot)); },
+            [&] {
+                writer.flush();
+                return writer.getStats().bytes;
+            });
+    }
+    std::remove(filename.c_str());
+}
+
+void runMemory(const char *name, const Snapshots &snapshots, std::unique_ptr<Encoder> encoder) {
+    MemorySink sink(std::move(encoder));
+    std::uint64_t bytes = 0;
+    run(name, snapshots,
+        [&](std::shared_ptr<const Snapshot> snapshot) {
+            sink.publish(std::move(snapshot));
+            // Имитация потребителя, периодически забирающего данные
+            if (sink.snapshots() % 256 == 0) {
+                bytes += sink.take().size();
+            }
+        },
+        [&] { return bytes + sink.take().size(); });
+}
+
+void runInflux(const char *name, const Snapshots &snapshots, bool gzip) {
+    InfluxOptions options;
+    options.path = "bench_sink.lp";
+    options.gzip = gzip;
+    options.queue_limit = snapshots.size();
+    std::remove(options.path.c_str());
+    {
+        InfluxSink sink(options);
+        run(name, snapshots, [&](std::shared_ptr<const Snapshot> snapshot) { sink.publish(std::move(snapshot)); },
+            [&] {
+                sink.flush();
+                return sink.getStats().bytes;
+            });
+    }
+    std::remove(options.path.c_str());
+}
+
+void runStatsd(const Snapshots &snapshots) {
+    // Приемник, который не читает датаграммы: измеряется только сторона отправителя
+    int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (receiver < 0 || ::bind(receiver, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::getsockname(receiver, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        std::cerr << "statsd: cannot bind a UDP receiver\n";
+        return;
+    }
+    StatsdOptions options;
+    options.port = ntohs(address.sin_port);
+    options.queue_limit = snapshots.size();
+    {
+        StatsdSink sink(options);
+        run("statsd udp", snapshots, [&](std::shared_ptr<const Snapshot> snapshot) { sink.publish(std::move(snapshot)); },
+            [&] {
+                // Ждет, пока поток отправки обработает все снимки
+                StatsdStats stats = sink.getStats();
+                while (stats.snapshots + stats.dropped_snapshots < snapshots.size()) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    stats = sink.getStats();
+                }
+                if (stats.dropped_datagrams > 0) {
+                    std::cout << "  (" << stats.dropped_datagrams << " datagrams dropped on EAGAIN)\n";
+                }
+                return stats.bytes;
+            });
+    }
+    ::close(receiver);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    int metrics = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    std::cout << "sink                           throughput\n";
+    Snapshots snapshots = makeSnapshots(count, metrics);
+    runWriter("file text", snapshots, OutputFormat::Text);
+    runWriter("file csv", snapshots, OutputFormat::Csv);
+    runWriter("file binary", snapshots, OutputFormat::Binary);
+    runMemory("memory text", snapshots, makeEncoder(OutputFormat::Text));
+    runMemory("memory binary", snapshots, makeEncoder(OutputFormat::Binary));
+    runMemory("memory otlp", snapshots, std::make_unique<OtlpEncoder>());
+    runInflux("influx file", snapshots, false);
+    runInflux("influx file gzip", snapshots, true);
+    runStatsd(snapshots);
+    {
+        PrometheusOptions options;
+        options.port = 0;
+        PrometheusExporter exporter(options);
+        run("prometheus publish", snapshots,
+            [&](std::shared_ptr<const Snapshot> snapshot) { exporter.publish(std::move(snapshot)); },
+            [] { return std::uint64_t(0); });
+    }
+
+    // Два текстовых получателя: каждый кодирует поля сам или оба используют общее представление
+    std::cout << "\ntwo text sinks per snapshot\n";
+    for (bool shared : {false, true}) {
+        Snapshots fresh = makeSnapshots(count, metrics, shared ? encodingBit(SharedEncoding::TextFields) : 0);
+        MemorySink first;
+        MemorySink second;
+        std::uint64_t bytes = 0;
+        run(shared ? "shared encoding" : "separate encoding", fresh,
+            [&](std::shared_ptr<const Snapshot> snapshot) {
+                first.publish(snapshot);
+                second.publish(std::move(snapshot));
+                if (first.snapshots() % 256 == 0) {
+                    bytes += first.take().size() + second.take().size();
+                }
+            },
+            [&] { return bytes + first.take().size() + second.take().size(); });
+    }
+    return 0;
+}
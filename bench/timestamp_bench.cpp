@@ -0,0 +1,74 @@
+#include "timestamp_formatter.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+    Бенчмарк форматирования меток времени.
+    Сравнивает прежний способ (localtime + put_time + stringstream на каждую метку)
+    с кэширующим TimestampFormatter для локального времени и UTC.
+    Метки идут с шагом 1 мс, как при частой записи строк: префикс до секунд
+    пересчитывается раз в 1000 вызовов.
+
+    Запуск: ./timestamp_bench [число_меток]
+*/
+
+namespace {
+
+// Прежняя реализация из MetricsWriter::run и Logger
+std::string formatWithStream(std::chrono::system_clock::time_point now) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+    auto timer = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&timer), "%Y-%m-%d %H:%M:%S");
+    ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
+    return ss.str();
+}
+
+void report(const char *name, std::int64_t count, std::chrono::steady_clock::duration elapsed, unsigned checksum) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(1) << count / seconds / 1e6 << " M/s" << std::setw(10) << std::setprecision(2)
+              << seconds * 1e9 / count << " ns" << "  (checksum " << checksum << ")\n";
+}
+
+void runFormatter(const char *name, TimestampFormatter::Zone zone, std::int64_t base_ms, std::int64_t count) {
+    TimestampFormatter formatter(zone);
+    char out[TimestampFormatter::kLength];
+    unsigned checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::int64_t i = 0; i < count; ++i) {
+        formatter.format(base_ms + i, out);
+        checksum += static_cast<unsigned char>(out[22]) + static_cast<unsigned char>(out[18]);
+    }
+    report(name, count, std::chrono::steady_clock::now() - start, checksum);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::int64_t count = argc > 1 ? std::atoll(argv[1]) : 200000000;
+    std::int64_t base_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    std::cout << "method                       throughput   per call\n";
+
+    std::int64_t stream_count = count / 100 > 0 ? count / 100 : 1;
+    unsigned checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::int64_t i = 0; i < stream_count; ++i) {
+        std::string stamp = formatWithStream(std::chrono::system_clock::time_point(std::chrono::milliseconds(base_ms + i)));
+        checksum += static_cast<unsigned char>(stamp[22]);
+    }
+    report("localtime+put_time", stream_count, std::chrono::steady_clock::now() - start, checksum);
+
+    runFormatter("cached local", TimestampFormatter::Zone::Local, base_ms, count);
+    runFormatter("cached utc", TimestampFormatter::Zone::Utc, base_ms, count);
+    return 0;
+}
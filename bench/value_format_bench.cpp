@@ -0,0 +1,80 @@
+#include "value_format.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    Бенчмарк форматирования значений метрик.
+    Сравнивает стоимость вывода одного значения прежними способами
+    (std::stringstream с std::fixed << std::setprecision(2) для Gauge и std::to_string для Counter)
+    с std::to_chars в переиспользуемый буфер вывода (appendGauge / appendCounter).
+
+    Запуск: ./value_format_bench [число_значений]
+*/
+
+namespace {
+
+void report(const char *name, std::size_t count, std::chrono::steady_clock::duration elapsed, std::size_t bytes) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << seconds * 1e9 / count << " ns/value" << std::setw(10) << count / seconds / 1e6
+              << " M/s" << "  (" << bytes << " bytes)\n";
+}
+
+template <typename Format>
+void run(const char *name, std::size_t count, Format format) {
+    std::string out;
+    out.reserve(64 * 1024);
+    std::size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+        format(i, out);
+        // Имитация сброса буфера MetricsWriter
+        if (out.size() > 60 * 1024) {
+            bytes += out.size();
+            out.clear();
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    report(name, count, elapsed, bytes + out.size());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> gauge_dist(0.0, 10000.0);
+    std::uniform_int_distribution<std::int64_t> counter_dist(0, 1000000);
+    const std::size_t kValues = 4096;
+    std::vector<double> gauges(kValues);
+    std::vector<std::int64_t> counters(kValues);
+    for (std::size_t i = 0; i < kValues; ++i) {
+        gauges[i] = gauge_dist(rng);
+        counters[i] = counter_dist(rng);
+    }
+
+    std::cout << "method                          per value  throughput\n";
+    run("gauge stringstream fixed(2)", count, [&](std::size_t i, std::string &out) {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2) << gauges[i % kValues];
+        out += ss.str();
+    });
+    run("gauge to_chars fixed(2)", count,
+        [&](std::size_t i, std::string &out) { appendGauge(out, gauges[i % kValues], 2); });
+    run("gauge to_chars fixed(6)", count,
+        [&](std::size_t i, std::string &out) { appendGauge(out, gauges[i % kValues], 6); });
+    run("gauge to_chars shortest", count,
+        [&](std::size_t i, std::string &out) { appendGauge(out, gauges[i % kValues], kShortestPrecision); });
+    run("counter std::to_string", count,
+        [&](std::size_t i, std::string &out) { out += std::to_string(counters[i % kValues]); });
+    run("counter to_chars", count, [&](std::size_t i, std::string &out) { appendCounter(out, counters[i % kValues]); });
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "metrics_library.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Бенчмарк политик сброса MetricsWriter.
+    Сравнивает число системных вызовов и пропускную способность при записи после каждой строки
+    (поведение по умолчанию) и при буферизации по размеру/времени, в том числе с fdatasync,
+    для бэкендов write(2), io_uring и mmap.
+
+    Запуск: ./writer_flush_bench [длительность_в_секундах] [число_метрик]
+*/
+
+namespace {
+
+struct Policy {
+    const char *name;
+    WriterOptions options;
+};
+
+std::vector<Policy> makePolicies() {
+    WriterOptions per_line;
+
+    WriterOptions buffered;
+    buffered.flush_bytes = 64 * 1024;
+    buffered.flush_interval = std::chrono::milliseconds(1000);
+
+    WriterOptions buffered_sync = buffered;
+    buffered_sync.fsync_interval = std::chrono::milliseconds(1000);
+
+    WriterOptions uring = buffered;
+    uring.backend = WriterBackend::IoUring;
+
+    WriterOptions uring_sync = buffered_sync;
+    uring_sync.backend = WriterBackend::IoUring;
+
+    WriterOptions mmap;
+    mmap.backend = WriterBackend::Mmap;
+
+    return {{"per-line", per_line}, {"64KB/1s", buffered}, {"64KB/1s+fdatasync", buffered_sync},
+            {"io_uring 64KB/1s", uring}, {"io_uring+fdatasync", uring_sync}, {"mmap per-line", mmap}};
+}
+
+std::vector<std::pair<std::string, std::string>> makeSnapshot(int metrics) {
+    std::vector<std::pair<std::string, std::string>> snapshot;
+    for (int i = 0; i < metrics; ++i) {
+        snapshot.emplace_back("metric_" + std::to_string(i), std::to_string(i * 7 % 1000) + ".25");
+    }
+    return snapshot;
+}
+
+// Запись с заданным интервалом сбора в течение duration
+void runInterval(const Policy &policy, std::chrono::milliseconds interval, std::chrono::seconds duration, int metrics) {
+    const std::string filename = "bench_writer_flush.txt";
+    std::remove(filename.c_str());
+    auto snapshot = makeSnapshot(metrics);
+
+    WriterStats stats;
+    {
+        MetricsWriter writer(filename, policy.options);
+        auto next = std::chrono::steady_clock::now();
+        auto end = next + duration;
+        while (next < end) {
+            writer.write(snapshot);
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+        writer.flush();
+        stats = writer.getStats();
+    }
+    std::remove(filename.c_str());
+
+    std::printf("  interval=%-6lldms %-20s lines=%-6llu write()=%-6llu fdatasync()=%-4llu lines/write=%.1f\n",
+                static_cast<long long>(interval.count()), policy.name,
+                static_cast<unsigned long long>(stats.lines),
+                static_cast<unsigned long long>(stats.write_calls),
+                static_cast<unsigned long long>(stats.sync_calls),
+                stats.write_calls ? static_cast<double>(stats.lines) / stats.write_calls : 0.0);
+}
+
+// Запись без пауз: максимальная пропускная способность политики
+void runThroughput(const Policy &policy, int snapshots, int metrics) {
+    const std::string filename = "bench_writer_flush.txt";
+    std::remove(filename.c_str());
+    auto snapshot = makeSnapshot(metrics);
+
+    WriterStats stats;
+    auto start = std::chrono::steady_clock::now();
+    {
+        MetricsWriter writer(filename, policy.options);
+        for (int i = 0; i < snapshots; ++i) {
+            writer.write(snapshot);
+        }
+        writer.flush();
+        stats = writer.getStats();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::remove(filename.c_str());
+
+    std::printf("  %-20s %d lines in %.3f s: %.0f lines/s, %.1f MB/s, write()=%llu\n", policy.name, snapshots, seconds,
+                snapshots / seconds, stats.bytes / seconds / (1024.0 * 1024.0),
+                static_cast<unsigned long long>(stats.write_calls));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::chrono::seconds duration(argc > 1 ? std::atoi(argv[1]) : 5);
+    int metrics = argc > 2 ? std::atoi(argv[2]) : 20;
+    auto policies = makePolicies();
+
+    std::printf("Collection intervals (%lld s, %d metrics per line):\n", static_cast<long long>(duration.count()), metrics);
+    for (auto interval : {std::chrono::milliseconds(10), std::chrono::milliseconds(1000)}) {
+        for (const auto &policy : policies) {
+            runInterval(policy, interval, duration, metrics);
+        }
+    }
+
+    std::printf("Throughput (no pauses between snapshots):\n");
+    for (const auto &policy : policies) {
+        runThroughput(policy, 100000, metrics);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "encoder.h"
+#include "snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Двоичный колоночный формат файла метрик.
+
+    Файл начинается с сигнатуры kBinaryMagic (8 байт), далее идут записи:
+      'D' varint(n) n × { varint(длина) имя u8(MetricType) }
+          — словарь имен; записывается в начале каждого сегмента (файла или сеанса записи)
+            и повторно, только когда меняется набор метрик;
+      'B' varint(длина) блок
+          — блок строк для текущего словаря.
+
+    Блок: varint(rows) i64(first_ts) i64(last_ts) и битовый поток, в котором подряд
+    хранятся колонки: метки времени (миллисекунды, delta-of-delta как в Gorilla),
+    затем по колонке на каждую метрику словаря:
+      Gauge   — varint(режим), затем значения:
+                режим p + 1 — значения с точностью p знаков после запятой как целые value × 10^p:
+                zigzag varint первого значения, затем zigzag varint delta-of-delta;
+                режим 0 — первое значение 64 битами, далее XOR с предыдущим (сжатие Gorilla);
+                целыми хранятся колонки, все значения которых в блоке записаны с одной фиксированной
+                точностью (MetricSample::precision) и по модулю меньше 2^53 после масштабирования,
+                остальные (kShortestPrecision, NaN, бесконечности) — XOR;
+      Counter — zigzag varint разности с предыдущим значением (первое — с нулем);
+      Text    — varint(длина) и байты строки.
+    Histogram хранится колонкой Text в текстовом виде appendHistogram() (count=N;sum=S;...).
+    Gauge с фиксированной точностью, как и в текстовом формате, сохраняются округленными до нее.
+    Каждый блок кодируется независимо, поэтому читатель может перейти к любому блоку,
+    зная только текущий словарь. Целые числа фиксированной длины — little-endian.
+*/
+
+// Сигнатура двоичного файла метрик.
+constexpr char kBinaryMagic[8] = {'M', 'T', 'R', 'X', 'B', 'I', 'N', '1'};
+
+// Теги записей двоичного формата.
+constexpr char kBinaryDictionaryTag = 'D';
+constexpr char kBinaryBlockTag = 'B';
+
+/*
+    Колонка одной метрики в раскодированном блоке.
+*/
+struct BinaryColumn
+{
+    std::string name;                   // Имя метрики.
+    MetricType type = MetricType::Text; // Тип значений колонки.
+    std::vector<double> gauges;         // Значения для MetricType::Gauge.
+    int precision = kShortestPrecision; // Точность значений Gauge в блоке или kShortestPrecision (XOR Gorilla).
+    std::vector<std::int64_t> counters; // Значения для MetricType::Counter.
+    std::vector<std::string> texts;     // Значения для MetricType::Text.
+};
+
+/*
+    Раскодированный блок: метки времени строк и колонки значений.
+*/
+struct BinaryBlock
+{
+    std::vector<std::int64_t> timestamps; // Метки времени строк, миллисекунды с начала эпохи.
+    std::vector<BinaryColumn> columns;    // Колонки в порядке словаря.
+};
+
+/*
+    Кодировщик снимков в двоичный формат. Накапливает строки текущего блока
+    и выдает закодированные записи в выходной буфер.
+*/
+class BinaryEncoder : public Encoder
+{
+public:
+    // block_rows — максимальное количество строк в блоке.
+    explicit BinaryEncoder(std::size_t block_rows = 120);
+
+    // Начинает новый сегмент: при new_file пишет сигнатуру, а словарь будет записан перед первой строкой.
+    void begin(std::string &out, bool new_file) override;
+
+    // Добавляет строку; закрывает текущий блок, если он заполнен или изменился набор метрик.
+    void add(const Snapshot &snapshot, std::int64_t timestamp_ms, std::string &out);
+
+    // Кодирует накопленные строки в блок и дописывает его в out.
+    void finishBlock(std::string &out);
+
+    // Есть ли строки, еще не закодированные в блок.
+    bool hasPendingRows() const { return !timestamps_.empty(); }
+
+    // Реализация Encoder: add() с меткой времени в миллисекундах, finishBlock() и hasPendingRows().
+    void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) override;
+    void finish(std::string &out) override { finishBlock(out); }
+    bool hasPending() const override { return hasPendingRows(); }
+
+private:
+    // Совпадает ли набор метрик снимка с текущим словарем.
+    bool matchesDictionary(const Snapshot &snapshot) const;
+
+    void writeDictionary(std::string &out);
+
+    std::size_t block_rows_;
+    bool dictionary_written_ = false;     // Записан ли словарь в текущем сегменте.
+    std::vector<BinaryColumn> columns_;   // Словарь и значения строк текущего блока.
+    std::vector<std::int64_t> timestamps_;
+    std::string block_;                   // Буфер для кодирования блока (переиспользуется).
+};
+
+/*
+    Последовательный декодер двоичного файла метрик.
+*/
+class BinaryDecoder
+{
+public:
+    // data должен оставаться доступным, пока используется декодер.
+    BinaryDecoder(const char *data, std::size_t size);
+
+    // Раскодирует следующий блок. Возвращает false в конце данных или при ошибке формата (см. error()).
+    bool next(BinaryBlock &block);
+
+    // Позиция в данных после последней прочитанной записи.
+    std::size_t offset() const { return offset_; }
+
+    // Текущий словарь (по колонкам без значений).
+    const std::vector<BinaryColumn> &dictionary() const { return dictionary_; }
+
+    // Была ли обнаружена ошибка формата или обрезанная запись.
+    bool error() const { return error_; }
+
+    // Проверяет сигнатуру формата в начале данных.
+    static bool hasMagic(const char *data, std::size_t size);
+
+    // Читает заголовок блока (количество строк и метки времени первой и последней строк).
+    static bool readBlockHeader(const char *payload, std::size_t size, std::uint64_t &rows,
+                                std::int64_t &first_ts, std::int64_t &last_ts);
+
+    // Раскодирует тело блока с учетом словаря.
+    static bool decodeBlock(const char *payload, std::size_t size, const std::vector<BinaryColumn> &dictionary,
+                            BinaryBlock &block);
+
+    // Читает запись словаря, начинающуюся после тега; продвигает offset.
+    static bool readDictionary(const char *data, std::size_t size, std::size_t &offset,
+                               std::vector<BinaryColumn> &dictionary);
+
+    // Читает varint; продвигает offset.
+    static bool readVarint(const char *data, std::size_t size, std::size_t &offset, std::uint64_t &value);
+
+private:
+    const char *data_;
+    std::size_t size_;
+    std::size_t offset_ = 0;
+    bool error_ = false;
+    std::vector<BinaryColumn> dictionary_;
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+    Двоичный журнал с отложенным форматированием (файл metrics.log.bin, Logger в режиме LogFormat::Binary).
+
+    Вызывающий поток пишет в свой кольцевой буфер только номер места вызова (формат, уровень
+    и типы аргументов регистрируются один раз на место вызова), счетчик тактов и байты аргументов.
+    Фоновый поток Logger сливает буферы потоков по времени и дописывает записи в файл как есть;
+    текст строится только при декодировании (утилита log_decoder, decodeBinaryLog()).
+
+    Формат файла — последовательность записей с байтом-тегом (числа — в порядке байтов машины):
+      'S' "MLOGBIN1"                         — начало сессии процесса, словарь мест вызова сбрасывается;
+      'D' u32 id, u8 level, u8 n, n байт типов, u32 длина, формат — место вызова;
+      'R' u32 длина, u32 id, u64 время (нс от эпохи), аргументы — запись;
+      'X' u64 время, u64 количество         — записи, отброшенные из-за переполнения буферов.
+
+    Типы аргументов: 'i' — целое со знаком (i64), 'u' — без знака (u64), 'd' — double,
+    'b' — bool (1 байт), 'c' — char (1 байт), 's' — строка (u32 длина и байты).
+*/
+namespace binary_log {
+
+// Сигнатура начала сессии (после тега 'S').
+constexpr char kMagic[8] = {'M', 'L', 'O', 'G', 'B', 'I', 'N', '1'};
+
+constexpr char kSessionTag = 'S';
+constexpr char kSiteTag = 'D';
+constexpr char kRecordTag = 'R';
+constexpr char kDroppedTag = 'X';
+
+// Заголовок записи в кольцевом буфере и файле: длина, номер места вызова, время.
+constexpr std::size_t kRecordHeader = 4 + 4 + 8;
+
+/*
+    Кольцевой буфер записей одного потока (один писатель, один читатель).
+    Запись всегда непрерывна: если до конца буфера места не хватает, остаток пропускается
+    (в нем записывается нулевая длина, если помещается 4 байта) и запись начинается с начала.
+*/
+class StagingBuffer
+{
+public:
+    static constexpr std::size_t kCapacity = 64 * 1024;
+
+    StagingBuffer() : data_(new char[kCapacity]) {}
+
+    // Писатель: непрерывные size байт под запись или nullptr, если места нет.
+    char *reserve(std::size_t size) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        std::size_t rest = kCapacity - (pos & (kCapacity - 1));
+        std::size_t skip = rest < size ? rest : 0;
+        if (pos + skip + size - tail_cache_ > kCapacity) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (pos + skip + size - tail_cache_ > kCapacity) {
+                return nullptr;
+            }
+        }
+        if (skip >= 4) {
+            std::memset(data_.get() + (pos & (kCapacity - 1)), 0, 4);
+        }
+        reserved_ = pos + skip;
+        return data_.get() + (reserved_ & (kCapacity - 1));
+    }
+
+    // Писатель: публикует запись из size байт, начатую последним reserve().
+    void commit(std::size_t size) { head_.store(reserved_ + size, std::memory_order_release); }
+
+    // Писатель: заполнен ли буфер больше чем наполовину (по последнему прочитанному tail).
+    bool halfFull() const { return reserved_ - tail_cache_ > kCapacity / 2; }
+
+    // Читатель: позиция конца опубликованных записей.
+    std::size_t head() const { return head_.load(std::memory_order_acquire); }
+    std::size_t tail() const { return tail_.load(std::memory_order_relaxed); }
+
+    // Читатель: позиция записи с учетом пропуска в конце буфера (pos != head()).
+    std::size_t recordAt(std::size_t pos) const {
+        std::size_t rest = kCapacity - (pos & (kCapacity - 1));
+        if (rest < 4) {
+            return pos + rest;
+        }
+        std::uint32_t length;
+        std::memcpy(&length, data(pos), sizeof(length));
+        return length == 0 ? pos + rest : pos;
+    }
+
+    // Читатель: начало записи с позиции pos (после recordAt).
+    const char *data(std::size_t pos) const { return data_.get() + (pos & (kCapacity - 1)); }
+
+    // Читатель: освобождает место до позиции end.
+    void release(std::size_t end) { tail_.store(end, std::memory_order_release); }
+
+    // Поток-владелец завершился: после опустошения буфер удаляется.
+    std::atomic<bool> retired{false};
+
+private:
+    std::unique_ptr<char[]> data_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    std::size_t reserved_ = 0;   // Начало записи, зарезервированной писателем.
+    std::size_t tail_cache_ = 0; // Последнее прочитанное писателем значение tail_.
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// Метка времени записи: счетчик тактов процессора (на x86 — rdtsc, иначе steady_clock).
+// В наносекунды реального времени ее переводит фоновый поток Logger.
+inline std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+static_assert((StagingBuffer::kCapacity & (StagingBuffer::kCapacity - 1)) == 0,
+              "StagingBuffer::kCapacity must be a power of two");
+
+// Аргументы, которые записываются как строки.
+template <typename T>
+constexpr bool kIsString = std::is_convertible_v<const T &, std::string_view> ||
+                           std::is_same_v<std::decay_t<T>, const char *> || std::is_same_v<std::decay_t<T>, char *>;
+
+// Код типа аргумента в записи.
+template <typename T>
+constexpr char typeCode() {
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, bool>) {
+        return 'b';
+    } else if constexpr (std::is_same_v<D, char>) {
+        return 'c';
+    } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+        return 'i';
+    } else if constexpr (std::is_integral_v<D>) {
+        return 'u';
+    } else if constexpr (std::is_floating_point_v<D>) {
+        return 'd';
+    } else {
+        static_assert(kIsString<T>, "Unsupported binary log argument type");
+        return 's';
+    }
+}
+
+template <typename T>
+std::string_view stringArg(const T &value) {
+    if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        return value;
+    } else {
+        return value != nullptr ? std::string_view(value) : std::string_view("(null)");
+    }
+}
+
+// Размер аргумента в записи.
+template <typename T>
+std::size_t argSize(const T &value) {
+    constexpr char code = typeCode<T>();
+    if constexpr (code == 'b' || code == 'c') {
+        return 1;
+    } else if constexpr (code == 's') {
+        return 4 + stringArg(value).size();
+    } else {
+        return 8;
+    }
+}
+
+// Записывает аргумент в зарезервированную запись и сдвигает указатель.
+template <typename T>
+void putArg(char *&out, const T &value) {
+    constexpr char code = typeCode<T>();
+    if constexpr (code == 'b' || code == 'c') {
+        *out++ = static_cast<char>(value);
+    } else if constexpr (code == 'i' || code == 'u' || code == 'd') {
+        using Stored = std::conditional_t<code == 'i', std::int64_t,
+                                          std::conditional_t<code == 'u', std::uint64_t, double>>;
+        auto number = static_cast<Stored>(value);
+        std::memcpy(out, &number, sizeof(number));
+        out += sizeof(number);
+    } else {
+        std::string_view text = stringArg(value);
+        auto length = static_cast<std::uint32_t>(text.size());
+        std::memcpy(out, &length, sizeof(length));
+        std::memcpy(out + sizeof(length), text.data(), text.size());
+        out += sizeof(length) + text.size();
+    }
+}
+
+/*
+    Декодирует двоичный журнал в текстовый формат metrics.log
+    (YYYY-MM-DD HH:MM:SS [LEVEL] сообщение). Возвращает количество выведенных строк.
+    Выбрасывает std::runtime_error, если файл поврежден.
+*/
+std::size_t decodeBinaryLog(std::istream &in, std::ostream &out);
+
+} // namespace binary_log
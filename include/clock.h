@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+    Источник времени библиотеки: реальное время для меток, монотонное — для интервалов и сроков.
+    MetricsCollector, MetricsWriter (WriterOptions::clock) и CollectionScheduler получают его извне,
+    поэтому тесты и воспроизведение могут подменить системные часы виртуальными (VirtualClock).
+*/
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    // Текущее реальное время.
+    virtual std::chrono::system_clock::time_point now() const = 0;
+
+    // Текущее монотонное время.
+    virtual std::chrono::steady_clock::time_point steadyNow() const = 0;
+
+    // Ждет, пока монотонное время не достигнет deadline.
+    virtual void sleepUntil(std::chrono::steady_clock::time_point deadline) = 0;
+
+    // Момент по std::chrono::steady_clock, когда наступит deadline этих часов, или time_point::max(),
+    // если он не наступит без вызовов этих часов (виртуальное время). По нему IoExecutor ставит
+    // срок обслуживания задачи.
+    virtual std::chrono::steady_clock::time_point wakeTime(std::chrono::steady_clock::time_point deadline) const {
+        return deadline;
+    }
+
+    // Системные часы (std::chrono::system_clock и steady_clock); используются по умолчанию.
+    static Clock &system();
+};
+
+/*
+    Виртуальные часы: время меняется только advance() и sleepUntil(), который не ждет,
+    а сразу переводит часы вперед до deadline. Поэтому часы тактов сбора с интервалом в минуту
+    выполняются за миллисекунды, а сроки сброса, синхронизации и ротации наступают
+    ровно в заданные моменты. Монотонное время совпадает с реальным (от начала эпохи),
+    поэтому оба сдвигаются вместе.
+*/
+class VirtualClock : public Clock
+{
+public:
+    // Часы, начинающиеся с реального времени start (по умолчанию 2024-01-01 00:00:00 UTC).
+    explicit VirtualClock(std::chrono::system_clock::time_point start = kDefaultStart);
+
+    static constexpr std::chrono::system_clock::time_point kDefaultStart{std::chrono::seconds(1704067200)};
+
+    std::chrono::system_clock::time_point now() const override;
+    std::chrono::steady_clock::time_point steadyNow() const override;
+    void sleepUntil(std::chrono::steady_clock::time_point deadline) override;
+
+    // Сроки виртуальных часов не наступают сами: задачи проверяют их при следующем обслуживании.
+    std::chrono::steady_clock::time_point wakeTime(std::chrono::steady_clock::time_point deadline) const override;
+
+    // Переводит часы вперед на duration.
+    void advance(std::chrono::nanoseconds duration);
+
+private:
+    std::atomic<std::int64_t> now_ns_; // Текущее время от начала эпохи.
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "snapshot.h"
+#include "timestamp_formatter.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+    Формат файла, который пишет MetricsWriter.
+*/
+enum class OutputFormat
+{
+    Text,   // Строки вида: YYYY-MM-DD HH:MM:SS.mmm "Name" value ...
+    Binary, // Двоичный колоночный формат со словарем имен (см. binary_format.h).
+    Csv,    // Строка заголовка timestamp,Name1,Name2,... при смене набора метрик, далее строки значений.
+    Tsv     // То же, что Csv, с разделителем табуляцией.
+};
+
+/*
+    Кодировщик снимков в байтовый формат получателя (файла, сокета, памяти).
+
+    Получатель вызывает begin() в начале каждого файла или потока, encode() для каждого снимка
+    и finish() перед тем, как отдать накопленные данные (сброс буфера, ротация, остановка).
+    Кодировщик может хранить состояние между снимками (словарь, заголовок, незакрытый блок),
+    поэтому один экземпляр используется одним получателем в одном потоке.
+*/
+class Encoder
+{
+public:
+    virtual ~Encoder() = default;
+
+    // Начинает новый файл (new_file) или сеанс записи в существующий: дописывает в out заголовки формата.
+    virtual void begin(std::string &out, bool new_file) = 0;
+
+    // Кодирует снимок, относящийся к моменту time (времени сбора снимка), в конец out.
+    virtual void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) = 0;
+
+    // Дописывает в out данные, накопленные, но еще не выданные (например, незакрытый блок).
+    virtual void finish(std::string & /*out*/) {}
+
+    // Есть ли данные, которые finish() еще должен выдать.
+    virtual bool hasPending() const { return false; }
+
+    // Биты encodingBit() общих представлений снимка, которые использует кодировщик (см. Sink::sharedEncodings).
+    virtual std::uint32_t sharedEncodings() const { return 0; }
+};
+
+/*
+    Текстовый формат: YYYY-MM-DD HH:MM:SS.mmm "Name" value ...
+*/
+class TextEncoder : public Encoder
+{
+public:
+    explicit TextEncoder(TimestampFormatter::Zone zone = TimestampFormatter::Zone::Local);
+
+    void begin(std::string &out, bool new_file) override;
+    void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) override;
+    std::uint32_t sharedEncodings() const override { return encodingBit(SharedEncoding::TextFields); }
+
+private:
+    TimestampFormatter timestamps_;
+};
+
+/*
+    Форматы Csv (delimiter ',') и Tsv (delimiter '\t'): строка заголовка с именами метрик
+    в начале каждого файла и при смене набора метрик, далее строки значений.
+*/
+class DelimitedEncoder : public Encoder
+{
+public:
+    explicit DelimitedEncoder(char delimiter, TimestampFormatter::Zone zone = TimestampFormatter::Zone::Local);
+
+    void begin(std::string &out, bool new_file) override;
+    void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) override;
+    std::uint32_t sharedEncodings() const override;
+
+private:
+    char delimiter_;
+    TimestampFormatter timestamps_;
+    std::vector<std::string> header_; // Имена колонок последней строки заголовка в текущем файле.
+};
+
+// Создает встроенный кодировщик формата format.
+// utc_timestamps — метки времени текстовых форматов в UTC; binary_block_rows — строк в блоке двоичного формата.
+std::unique_ptr<Encoder> makeEncoder(OutputFormat format, bool utc_timestamps = false, std::size_t binary_block_rows = 120);
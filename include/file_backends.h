@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+    Способ, которым MetricsWriter передает данные в файл.
+*/
+enum class WriterBackend
+{
+    Posix,   // write(2) в файл, открытый с O_APPEND.
+    IoUring, // Асинхронная дозапись через io_uring с зарегистрированными буферами (при недоступности — pwrite).
+    Mmap     // Копирование в отображенный в память, заранее выделенный файл с заголовком длины (см. MmapFileHeader).
+};
+
+/*
+    Заголовок файла, который пишет MmapFileBackend. Занимает первые 64 байта файла;
+    за ним следуют committed байт данных в обычном текстовом формате.
+    Внешний читатель отображает файл к себе и читает committed с семантикой acquire:
+    все байты до [sizeof(MmapFileHeader) + committed) уже записаны целиком.
+*/
+struct MmapFileHeader
+{
+    static constexpr char kMagic[8] = {'M', 'T', 'R', 'X', 'M', 'M', 'A', 'P'};
+    static constexpr std::uint32_t kVersion = 1;
+
+    char magic[8];           // Сигнатура kMagic.
+    std::uint32_t version;   // Версия формата заголовка.
+    std::uint32_t header_size; // Размер заголовка (смещение начала данных).
+    std::uint64_t committed; // Длина записанных данных после заголовка.
+    char reserved[40];       // Зарезервировано, заполнено нулями.
+};
+static_assert(sizeof(MmapFileHeader) == 64, "MmapFileHeader must be 64 bytes");
+
+/*
+    Базовый класс для бэкендов записи файла метрик.
+    Все методы вызываются только из потока записи MetricsWriter.
+*/
+class FileBackend
+{
+public:
+    virtual ~FileBackend() = default;
+
+    // Дописывает данные в конец файла и возвращает, сколько байт принято. Принятые данные
+    // копируются или записываются до возврата, поэтому буфер вызывающего можно сразу переиспользовать.
+    // Меньше size принимается, только если бэкенд не может принять данные без ожидания
+    // (все буферы UringFileBackend в работе): остаток передается повторно позже.
+    // Данные, не записанные из-за ошибки, считаются принятыми и учитываются в errors().
+    virtual std::size_t append(const char *data, std::size_t size) = 0;
+
+    // Запрашивает fdatasync для всех ранее дописанных данных. Возвращает false, если запрос
+    // нельзя поставить без ожидания; тогда его нужно повторить позже.
+    virtual bool sync() = 0;
+
+    // Дожидается завершения всех начатых операций записи и синхронизации.
+    virtual void drain() {}
+
+    // Имя бэкенда для логов и бенчмарков.
+    virtual const char *name() const = 0;
+
+    // Текущий размер данных в файле с учетом еще не завершенных дозаписей.
+    virtual std::uint64_t size() const = 0;
+
+    // Длина записанных метрик без служебного заголовка файла; 0 — в файл еще ничего не записано.
+    virtual std::uint64_t dataSize() const { return size(); }
+
+    // Количество системных вызовов, выполненных для записи данных.
+    std::uint64_t writeCalls() const { return write_calls_.load(std::memory_order_relaxed); }
+
+    // Количество запросов синхронизации с диском.
+    std::uint64_t syncCalls() const { return sync_calls_.load(std::memory_order_relaxed); }
+
+    // Количество ошибок записи и синхронизации.
+    std::uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+
+protected:
+    std::atomic<std::uint64_t> write_calls_{0};
+    std::atomic<std::uint64_t> sync_calls_{0};
+    std::atomic<std::uint64_t> errors_{0};
+};
+
+/*
+    Бэкенд на обычных системных вызовах write/fdatasync.
+*/
+class PosixFileBackend : public FileBackend
+{
+public:
+    // Открывает файл на дозапись; при ошибке бросает std::runtime_error.
+    explicit PosixFileBackend(const std::string &filename);
+    ~PosixFileBackend() override;
+
+    std::size_t append(const char *data, std::size_t size) override;
+    bool sync() override;
+    const char *name() const override { return "posix"; }
+    std::uint64_t size() const override { return size_; }
+
+private:
+    std::string filename_; // Имя файла (для сообщений об ошибках).
+    int fd_;               // Дескриптор файла, открытого с O_APPEND.
+    std::uint64_t size_;   // Размер файла при открытии плюс дописанные байты.
+};
+
+/*
+    Бэкенд на io_uring: данные копируются в один из зарегистрированных буферов
+    и отправляются операцией IORING_OP_WRITE_FIXED по явному смещению, не дожидаясь завершения.
+    Завершения собираются без блокировки при следующих вызовах. Если все буферы заняты
+    незавершенными операциями, append() принимает только часть данных, а sync() при заполненном
+    кольце возвращает false: поток записи общий, и ядро он ждет только в drain().
+    Если ядро не поддерживает io_uring (или он запрещен), используется pwrite по тому же смещению.
+    Если кольцо перестает работать (io_uring_enter возвращает неустранимую ошибку), незавершенные
+    операции учитываются в errors() как потерянные, а дальнейшие записи также идут через pwrite.
+*/
+class UringFileBackend : public FileBackend
+{
+public:
+    // Открывает файл и создает кольцо из buffer_count буферов по buffer_size байт.
+    // При ошибке открытия файла бросает std::runtime_error.
+    UringFileBackend(const std::string &filename, std::size_t buffer_size = 64 * 1024, unsigned buffer_count = 8);
+    ~UringFileBackend() override;
+
+    // Не ждет завершения записей: если все буферы в работе, принимает только часть данных.
+    std::size_t append(const char *data, std::size_t size) override;
+    bool sync() override;
+    void drain() override;
+    const char *name() const override { return ring_fd_ >= 0 ? "io_uring" : "pwrite"; }
+    std::uint64_t size() const override { return file_offset_; }
+
+    // Возвращает true, если используется io_uring, а не запасной путь через pwrite.
+    bool usingUring() const { return ring_fd_ >= 0; }
+
+    // Сколько раз append() принял не все данные, потому что все буферы были в работе.
+    std::uint64_t stalls() const { return stalls_; }
+
+private:
+    // Состояние одного зарегистрированного буфера.
+    struct Slot
+    {
+        char *data = nullptr;   // Память буфера.
+        std::size_t length = 0; // Длина данных, ожидающих записи.
+        std::uint64_t offset = 0; // Смещение в файле, по которому пишутся данные.
+        bool busy = false;      // Буфер отправлен в ядро и еще не завершен.
+    };
+
+    bool setupRing(unsigned entries);
+    void teardownRing();
+    void pwriteAll(const char *data, std::size_t size);
+    void submitWrite(unsigned slot_index);
+    void pushSqe(std::uint8_t opcode, std::uint8_t flags, std::uint64_t user_data, unsigned slot_index);
+    void submitPending();
+    bool reapCompletions(unsigned min_complete);
+    void abandonRing(int err);
+    int acquireSlot(); // Свободный буфер без ожидания или -1, если все буферы в работе.
+
+    // Сколько раз подряд отправка повторяется при EAGAIN/EBUSY, прежде чем кольцо считается неисправным.
+    static constexpr unsigned kMaxBusyRetries = 1000;
+
+    std::string filename_;
+    int fd_;                       // Дескриптор файла (без O_APPEND: смещения задаются явно).
+    std::uint64_t file_offset_;    // Смещение для следующей дозаписи.
+    std::size_t buffer_size_;
+    std::vector<Slot> slots_;
+    char *arena_ = nullptr;        // Общая память всех буферов.
+    std::size_t arena_size_ = 0;
+    unsigned inflight_ = 0;        // Количество отправленных, но не завершенных операций.
+    unsigned to_submit_ = 0;       // Количество подготовленных, но не отправленных SQE.
+    std::uint64_t stalls_ = 0;
+
+    // Состояние кольца io_uring
+    int ring_fd_ = -1;
+    unsigned sq_entries_ = 0;
+    void *sq_ring_ = nullptr;
+    std::size_t sq_ring_size_ = 0;
+    void *cq_ring_ = nullptr;
+    std::size_t cq_ring_size_ = 0;
+    void *sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_mask_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned *cq_mask_ = nullptr;
+    void *cqes_ = nullptr;
+};
+
+/*
+    Бэкенд без системных вызовов на каждую запись: файл заранее выделяется (fallocate)
+    экстентами по extent_size байт и отображается в память, данные дописываются memcpy,
+    после чего продвигается поле committed в заголовке. Системные вызовы нужны только
+    при выделении следующего экстента и при синхронизации. При закрытии невостребованный
+    хвост экстента отрезается. Если файл уже существует, запись продолжается с committed.
+*/
+class MmapFileBackend : public FileBackend
+{
+public:
+    // Открывает или создает файл; при ошибке или чужом формате файла бросает std::runtime_error.
+    MmapFileBackend(const std::string &filename, std::size_t extent_size = 16 * 1024 * 1024);
+    ~MmapFileBackend() override;
+
+    std::size_t append(const char *data, std::size_t size) override;
+    bool sync() override;
+    const char *name() const override { return "mmap"; }
+    std::uint64_t size() const override { return sizeof(MmapFileHeader) + committed(); }
+    std::uint64_t dataSize() const override { return committed(); }
+
+    // Количество записанных данных после заголовка.
+    std::uint64_t committed() const;
+
+private:
+    // Увеличивает файл и отображение так, чтобы в них помещалось required байт.
+    void grow(std::uint64_t required);
+
+    MmapFileHeader *header() const { return reinterpret_cast<MmapFileHeader *>(map_); }
+
+    std::string filename_;
+    int fd_;
+    std::size_t extent_size_;       // Шаг предварительного выделения.
+    char *map_ = nullptr;           // Отображение всего файла.
+    std::uint64_t mapped_size_ = 0; // Размер файла и отображения.
+    std::uint64_t synced_ = 0;      // Длина данных, уже синхронизированных с диском.
+};
+
+// Создает бэкенд указанного типа. buffer_size — рекомендуемый размер одной записи,
+// extent_size — шаг предварительного выделения для WriterBackend::Mmap.
+std::unique_ptr<FileBackend> makeFileBackend(WriterBackend backend, const std::string &filename,
+                                             std::size_t buffer_size, std::size_t extent_size = 16 * 1024 * 1024);
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "sink.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+/*
+    Куда InfluxSink пишет пакеты строк.
+*/
+enum class InfluxTarget
+{
+    File, // Дозапись в файл InfluxOptions::path.
+    Unix, // Потоковый Unix-сокет InfluxOptions::path.
+    Tcp   // TCP-соединение InfluxOptions::host:port.
+};
+
+/*
+    Параметры InfluxSink.
+*/
+struct InfluxOptions
+{
+    InfluxTarget target = InfluxTarget::File;
+    std::string path = "metrics.lp";           // Файл или путь Unix-сокета.
+    std::string host = "127.0.0.1";            // Адрес для InfluxTarget::Tcp.
+    std::uint16_t port = 8094;                 // Порт для InfluxTarget::Tcp.
+    std::string measurement = "metrics";       // Имя измерения; метрики снимка становятся его полями.
+    std::vector<std::pair<std::string, std::string>> tags; // Теги каждой точки (например, {"host", "web1"}).
+    std::size_t batch_lines = 5000;            // Отправлять пакет, когда в нем набралось столько строк.
+    std::chrono::milliseconds batch_interval{1000}; // ... или когда с первой строки пакета прошло это время.
+    bool gzip = false;                         // Сжимать каждый пакет отдельным членом gzip.
+    int gzip_level = 1;                        // Уровень сжатия zlib (1 — быстрее всего).
+    std::size_t queue_limit = 1024;            // Сколько снимков может ждать кодирования; более новые отбрасываются.
+    std::chrono::milliseconds reconnect_delay{1000}; // Пауза перед повторным подключением сокета.
+};
+
+/*
+    Статистика InfluxSink.
+*/
+struct InfluxStats
+{
+    std::uint64_t points = 0;         // Закодированные точки (снимки).
+    std::uint64_t dropped_points = 0; // Точки, отброшенные из-за переполнения очереди или ошибки отправки.
+    std::uint64_t batches = 0;        // Записанные пакеты.
+    std::uint64_t raw_bytes = 0;      // Байты строк до сжатия.
+    std::uint64_t bytes = 0;          // Записанные байты (после сжатия, если оно включено).
+    std::uint64_t errors = 0;         // Ошибки подключения и записи.
+};
+
+/*
+    Запись снимков в формате InfluxDB line protocol:
+      measurement[,tag=value...] name1=1.5,name2=7i,name3="text" <наносекунды с начала эпохи>
+    Gauge пишется как число с плавающей точкой, Counter — как целое (суффикс i), Text — как строка.
+    Метка времени — время сбора снимка (Snapshot::captured_at), а не время записи.
+
+    Подключается к MetricsCollector рядом с файлом MetricsWriter (addSink), поэтому тот же снимок
+    попадает в TSDB без отдельного процесса конвертации. Кодирование и запись выполняются
+    в собственном потоке: строки копятся в пакет до batch_lines или batch_interval и пишутся
+    одним вызовом; при gzip пакет сжимается отдельным членом gzip (поток членов — корректный
+    gzip-файл). При ошибке сокета пакет отбрасывается с учетом в статистике, а подключение
+    повторяется не чаще reconnect_delay.
+*/
+class InfluxSink : public Sink
+{
+public:
+    // Открывает файл или подключается к сокету; при ошибке открытия файла бросает std::runtime_error.
+    // Недоступный сокет не является ошибкой: подключение повторяется при отправке пакетов.
+    explicit InfluxSink(const InfluxOptions &options = InfluxOptions());
+
+    // Записывает оставшиеся снимки и останавливает поток.
+    ~InfluxSink() override;
+
+    InfluxSink(const InfluxSink &) = delete;
+    InfluxSink &operator=(const InfluxSink &) = delete;
+
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
+
+    // Поля строки не зависят от настроек и кодируются один раз на снимок для всех InfluxSink сборщика.
+    std::uint32_t sharedEncodings() const override { return encodingBit(SharedEncoding::InfluxFields); }
+
+    // Дожидается записи всех ранее переданных снимков, не дожидаясь заполнения пакета.
+    void flush();
+
+    InfluxStats getStats() const;
+
+    // Очередь, записанные байты, отброшенные точки (снимки) и ошибки.
+    SinkStats sinkStats() const override;
+
+private:
+    // Снимок и время его сбора.
+    struct Entry
+    {
+        std::shared_ptr<const Snapshot> snapshot; // nullptr — маркер flush().
+        std::int64_t timestamp_ns = 0;
+    };
+
+    void run();
+    void encode(const Entry &entry);
+    void writeBatch();
+    bool connect();
+    bool writeAll(const char *data, std::size_t size);
+
+    InfluxOptions options_;
+    int fd_ = -1;
+    std::string prefix_;                // measurement[,tags] с экранированием.
+    std::chrono::steady_clock::time_point next_connect_;
+
+    std::deque<Entry> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_var_;
+    bool stopped_ = false;
+    std::uint64_t flush_requested_ = 0; // Номер последнего запроса flush().
+    std::uint64_t flush_done_ = 0;      // Номер последнего выполненного запроса flush().
+    std::condition_variable flush_cv_;
+
+    // Буферы потока записи (переиспользуются между пакетами).
+    std::string batch_;
+    std::size_t batch_lines_ = 0;
+    std::string compressed_;
+    z_stream zstream_{};
+    bool zstream_ready_ = false;
+
+    std::atomic<std::uint64_t> points_{0};
+    std::atomic<std::uint64_t> dropped_points_{0};
+    std::atomic<std::uint64_t> batches_{0};
+    std::atomic<std::uint64_t> raw_bytes_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> errors_{0};
+
+    std::thread thread_;
+};
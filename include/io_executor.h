@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Приоритет обслуживания задачи ввода-вывода.
+enum class IoPriority : std::uint8_t
+{
+    Low,    // Журнал библиотеки.
+    Normal, // Запись снимков метрик.
+    High    // Ожидающий вызывающий (flush()).
+};
+
+class IoExecutor;
+
+/*
+    Задача фонового ввода-вывода (MetricsWriter, Logger): накапливает данные в своих очередях
+    и переносит их в файл в service(), которую вызывает IoExecutor.
+*/
+class IoTask
+{
+public:
+    virtual ~IoTask() = default;
+
+protected:
+    // Обрабатывает все накопившиеся данные одной пачкой и возвращает момент, когда задачу нужно
+    // обслужить снова без wake() (time_point::max() — только по wake()).
+    // Для одной задачи никогда не вызывается параллельно.
+    virtual std::chrono::steady_clock::time_point service(std::chrono::steady_clock::time_point now) = 0;
+
+private:
+    friend class IoExecutor;
+
+    IoPriority priority_ = IoPriority::Normal;         // Приоритет обслуживания по времени.
+    bool running_ = false;                             // service() выполняется.
+    bool pending_ = false;                             // Был wake() после начала последнего service().
+    IoPriority pending_priority_ = IoPriority::Normal; // Наибольший приоритет wake() с последнего обслуживания.
+    std::uint64_t pending_order_ = 0;                  // Порядок первого wake() среди задач одного приоритета.
+    std::chrono::steady_clock::time_point deadline_ = std::chrono::steady_clock::time_point::max();
+};
+
+/*
+    Общий исполнитель фонового ввода-вывода: вместо отдельного потока на каждый MetricsWriter
+    и журнал их обслуживает фиксированный пул потоков (по умолчанию один).
+
+    Задача обслуживается после wake() или по наступлении возвращенного ею срока; каждое обслуживание
+    забирает все накопленное задачей, поэтому данные, поступившие, пока задача ждала своей очереди,
+    записываются вместе. Из готовых задач первой обслуживается задача с наибольшим приоритетом
+    (для одинакового — раньше разбуженная), поэтому flush() не ждет, пока журнал или другие файлы
+    запишут свои данные. Одна задача никогда не обслуживается двумя потоками одновременно.
+    Исключение из service() записывается в журнал и не останавливает поток, обслуживающий остальные задачи.
+*/
+class IoExecutor
+{
+public:
+    // Исполнитель с threads потоками (не меньше одного).
+    explicit IoExecutor(unsigned threads = 1);
+
+    // Останавливает потоки; все задачи должны быть уже отключены (detach()).
+    ~IoExecutor();
+
+    // Общий исполнитель библиотеки. Число потоков задается setSharedThreads() до первого
+    // обращения или переменной окружения METRICS_IO_THREADS.
+    static IoExecutor &shared();
+
+    // Число потоков общего исполнителя; возвращает false, если он уже создан.
+    static bool setSharedThreads(unsigned threads);
+
+    // Подключает задачу: она обслуживается по wake() с приоритетом priority и по своим срокам.
+    void attach(IoTask &task, IoPriority priority);
+
+    // Отключает задачу, дождавшись завершения ее текущего обслуживания.
+    // После возврата service() задачи больше не вызывается.
+    void detach(IoTask &task);
+
+    // Запрашивает обслуживание задачи с ее приоритетом или более высоким.
+    void wake(IoTask &task);
+    void wake(IoTask &task, IoPriority priority);
+
+    // Количество потоков исполнителя.
+    unsigned threads() const { return thread_count_; }
+
+    // Количество выполненных обслуживаний задач.
+    std::uint64_t services() const;
+
+    // Через сколько задача, service() которой бросил исключение, обслуживается снова без wake().
+    static constexpr std::chrono::milliseconds kRetryDelay{1000};
+
+    IoExecutor(const IoExecutor &) = delete;
+    IoExecutor &operator=(const IoExecutor &) = delete;
+
+private:
+    void run();
+
+    // Выбирает готовую задачу или вычисляет момент, до которого ждать (под mutex_).
+    IoTask *next(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point &wait_until);
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_; // Новая готовая задача или более ранний срок.
+    std::condition_variable idle_cv_; // Завершение обслуживания (для detach()).
+    std::vector<IoTask *> tasks_;
+    std::uint64_t order_ = 0;
+    std::uint64_t services_ = 0;
+    bool stopped_ = false;
+    const unsigned thread_count_;
+    std::vector<std::thread> threads_;
+};
@@ -1,15 +1,126 @@
 #pragma once
 
-#include <string>
-#include <fstream>
-#include <mutex>
+#include "binary_log.h"
+#include "io_executor.h"
+#include "timestamp_formatter.h"
+
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <ctime>
-#include <iomanip>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Уровень записи журнала (по возрастанию важности).
+enum class LogLevel : std::uint8_t
+{
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5 // Только как порог: отключает журнал.
+};
+
+// Минимальный уровень, вызовы ниже которого удаляются при компиляции (макросы METRICS_LOG_*).
+// Задается числом: -DMETRICS_LOG_MIN_LEVEL=2 оставляет Info и выше.
+#ifndef METRICS_LOG_MIN_LEVEL
+#define METRICS_LOG_MIN_LEVEL 0
+#endif
+
+constexpr LogLevel kMinLogLevel = static_cast<LogLevel>(METRICS_LOG_MIN_LEVEL);
+
+// Формат файла журнала.
+enum class LogFormat : std::uint8_t
+{
+    Text,  // Готовые строки в metrics.log.
+    Binary // Номер места вызова и байты аргументов в metrics.log.bin (см. binary_log.h).
+};
+
+// Дописывание аргументов Logger::format() без std::stringstream.
+namespace log_format {
+
+inline void appendArg(std::string &out, std::string_view value) { out += value; }
+inline void appendArg(std::string &out, const char *value) { out += value != nullptr ? value : "(null)"; }
+inline void appendArg(std::string &out, char value) { out += value; }
+inline void appendArg(std::string &out, bool value) { out += value ? "true" : "false"; }
+
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T>> appendArg(std::string &out, T value) {
+    // Целые и кратчайшее представление вещественных (как kShortestPrecision)
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, static_cast<std::size_t>(result.ptr - buffer));
+}
+
+// Дописывает остаток формата без подстановок ("{{" и "}}" — литеральные скобки).
+inline void appendFormat(std::string &out, const char *format) {
+    for (; *format != '\0'; ++format) {
+        out += *format;
+        if ((format[0] == '{' && format[1] == '{') || (format[0] == '}' && format[1] == '}')) {
+            ++format;
+        }
+    }
+}
+
+// Копирует формат до очередного "{}", подставляет arg и продолжает с остальными аргументами.
+// Лишние аргументы игнорируются, "{}" без аргумента выводится как есть.
+template <typename T, typename... Rest>
+void appendFormat(std::string &out, const char *format, const T &arg, const Rest &...rest) {
+    for (; *format != '\0'; ++format) {
+        if (format[0] == '{' && format[1] == '}') {
+            appendArg(out, arg);
+            appendFormat(out, format + 2, rest...);
+            return;
+        }
+        out += *format;
+        if ((format[0] == '{' && format[1] == '{') || (format[0] == '}' && format[1] == '}')) {
+            ++format;
+        }
+    }
+}
+
+} // namespace log_format
+
+/*
+    Асинхронный журнал библиотеки (файл metrics.log).
+
+    Вызывающий поток только берет метку времени и перемещает сообщение в ячейку
+    ограниченной lock-free очереди (многие писатели, один читатель; без мьютекса и системных
+    вызовов). Исполнитель ввода-вывода (IoExecutor::shared(), общий с MetricsWriter) раз
+    в kFlushInterval или при заполнении очереди наполовину форматирует накопившиеся записи
+    в один буфер и дописывает его в постоянно открытый файл одним write(2). Журнал обслуживается
+    с низким приоритетом, flush() — с высоким. При переполнении очереди записи отбрасываются, а их количество
+    выводится отдельной строкой, поэтому журнал никогда не блокирует вызывающего.
 
-// Простой класс для логирования ошибок и информационных сообщений
-class Logger {
+    Формат строки: YYYY-MM-DD HH:MM:SS [LEVEL] сообщение
+
+    Записи ниже порога setLevel() (по умолчанию Info, переменная окружения METRICS_LOG_LEVEL)
+    отбрасываются первой же проверкой. format() и макросы METRICS_LOG_* строят сообщение только
+    для записей, которые будут выведены; макросы ниже METRICS_LOG_MIN_LEVEL удаляются при компиляции
+    вместе с вычислением аргументов.
+
+    В режиме LogFormat::Binary (setLogFormat() или METRICS_LOG_FORMAT=binary) макросы METRICS_LOG_*
+    не форматируют сообщение вовсе: в кольцевой буфер потока пишутся номер места вызова, время
+    и байты аргументов, а фоновый поток переносит их в metrics.log.bin без разбора. Текст
+    восстанавливает утилита log_decoder. Сообщения logInfo()/logError() и format() в этом режиме
+    пишутся в тот же файл как записи с одним строковым аргументом.
+*/
+class Logger : private IoTask {
 public:
+    // Емкость очереди записей (степень двойки).
+    static constexpr std::size_t kQueueCapacity = 8192;
+
+    // Как часто фоновый поток записывает накопившиеся записи.
+    static constexpr std::chrono::milliseconds kFlushInterval{20};
+
     // Получение единственного экземпляра логгера (паттерн Singleton)
     static Logger& getInstance() {
         static Logger instance;
@@ -17,34 +128,318 @@ public:
     }
 
     // Запись ошибки в лог-файл
-    void logError(const std::string& message) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::ofstream log_file(log_filename_, std::ios::app);
-        if (log_file.is_open()) {
-            auto now = std::chrono::system_clock::now();
-            auto time = std::chrono::system_clock::to_time_t(now);
-            log_file << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") 
-                     << " [ERROR] " << message << std::endl;
-            log_file.close();
+    void logError(std::string message) { log(LogLevel::Error, std::move(message)); }
+
+    // Запись предупреждения в лог-файл
+    void logWarn(std::string message) { log(LogLevel::Warn, std::move(message)); }
+
+    // Запись информационного сообщения в лог-файл
+    void logInfo(std::string message) { log(LogLevel::Info, std::move(message)); }
+
+    // Запись отладочного сообщения в лог-файл
+    void logDebug(std::string message) { log(LogLevel::Debug, std::move(message)); }
+
+    // Будет ли выведена запись уровня level (проверка без блокировок).
+    bool enabled(LogLevel level) const {
+        return level >= kMinLogLevel && level >= level_.load(std::memory_order_relaxed) && level != LogLevel::Off;
+    }
+
+    // Порог уровня записей, выводимых в журнал.
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+    // Формат файла журнала; переключение не затрагивает записи, уже поставленные в очередь.
+    void setLogFormat(LogFormat format) { format_.store(format, std::memory_order_relaxed); }
+    LogFormat logFormat() const { return format_.load(std::memory_order_relaxed); }
+
+    // Ставит запись в очередь, если уровень не ниже порога; не блокируется.
+    void log(LogLevel level, std::string message) {
+        if (!enabled(level)) {
+            return;
+        }
+        if (logFormat() == LogFormat::Binary) {
+            logDeferred(dynamicSite(level), level, "{}", "", std::string_view(message));
+        } else {
+            enqueue(level, std::move(message));
         }
     }
 
-    // Запись информационного сообщения в лог-файл
-    void logInfo(const std::string& message) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::ofstream log_file(log_filename_, std::ios::app);
-        if (log_file.is_open()) {
-            auto now = std::chrono::system_clock::now();
-            auto time = std::chrono::system_clock::to_time_t(now);
-            log_file << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") 
-                     << " [INFO] " << message << std::endl;
-            log_file.close();
+    // Строит сообщение из формата с подстановками "{}" только если запись будет выведена:
+    //   logger.format(LogLevel::Info, "CPU usage simulated: {}", load);
+    template <typename... Args>
+    void format(LogLevel level, const char *format, const Args &...args) {
+        if (!enabled(level)) {
+            return;
+        }
+        std::string message;
+        message.reserve(std::strlen(format) + 16 * sizeof...(Args));
+        log_format::appendFormat(message, format, args...);
+        if (logFormat() == LogFormat::Binary) {
+            logDeferred(dynamicSite(level), level, "{}", "", std::string_view(message));
+        } else {
+            enqueue(level, std::move(message));
+        }
+    }
+
+    // format() для места вызова со статическим форматом: в двоичном режиме сообщение не строится.
+    // site — номер места вызова (0 — еще не зарегистрировано), его хранит вызывающий.
+    template <typename... Args>
+    void formatAt(std::atomic<std::uint32_t> &site, LogLevel level, const char *format, const Args &...args) {
+        if (logFormat() == LogFormat::Binary) {
+            logDeferred(site, level, format, "", args...);
+        } else {
+            this->format(level, format, args...);
+        }
+    }
+
+    // formatAt() для места вызова с ограничением частоты (METRICS_LOG_EVERY_N, METRICS_LOG_RATE_LIMITED):
+    // если с предыдущей записи подавлено suppressed сообщений, к записи дописывается их число.
+    // sites — номера места вызова без дописанного числа и с ним.
+    template <typename... Args>
+    void formatSuppressed(std::atomic<std::uint32_t> (&sites)[2], LogLevel level, std::uint64_t suppressed,
+                          const char *format, const Args &...args) {
+        static constexpr const char *kSuffix = " (suppressed {} messages)";
+        if (suppressed == 0) {
+            formatAt(sites[0], level, format, args...);
+        } else if (logFormat() == LogFormat::Binary) {
+            logDeferred(sites[1], level, format, kSuffix, args..., suppressed);
+        } else if (enabled(level)) {
+            std::string message;
+            log_format::appendFormat(message, format, args...);
+            log_format::appendFormat(message, kSuffix, suppressed);
+            enqueue(level, std::move(message));
         }
     }
 
+    // Дожидается записи в файл всех ранее поставленных в очередь записей.
+    void flush();
+
+    // Количество записей, отброшенных из-за переполнения очереди.
+    std::uint64_t droppedRecords() const { return dropped_total_.load(std::memory_order_relaxed); }
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
 private:
+    // Ячейка очереди (алгоритм ограниченной очереди Д. Вьюкова).
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence{0}; // Номер позиции, для которой ячейка свободна (pos) или заполнена (pos + 1).
+        std::chrono::system_clock::time_point time; // Время записи.
+        LogLevel level = LogLevel::Info;
+        std::string message;                  // Перемещается из вызывающего; освобождается фоновым потоком.
+    };
+
+    // Место вызова двоичного журнала.
+    struct Site
+    {
+        LogLevel level;
+        std::string types;  // Коды типов аргументов (binary_log::typeCode).
+        std::string format;
+    };
+
+    // Кольцевой буфер двоичного журнала текущего потока (создается при первой записи).
+    inline static thread_local binary_log::StagingBuffer *staging_ = nullptr;
+
     // Приватный конструктор для реализации Singleton
-    Logger() : log_filename_("metrics.log") {}
+    Logger();
+    ~Logger();
+
+    void enqueue(LogLevel level, std::string message);
+
+    // Пишет запись двоичного журнала в буфер текущего потока; не блокируется.
+    // Формат места вызова — format и suffix (регистрируется при первом вызове).
+    template <typename... Args>
+    void logDeferred(std::atomic<std::uint32_t> &site, LogLevel level, const char *format, const char *suffix,
+                     const Args &...args) {
+        static_assert(sizeof...(Args) < 256, "Too many binary log arguments");
+        std::uint32_t id = site.load(std::memory_order_acquire);
+        if (id == 0) {
+            static constexpr char kTypes[] = {binary_log::typeCode<Args>()..., '\0'};
+            id = registerSite(level, std::string(format) + suffix, kTypes);
+            site.store(id, std::memory_order_release);
+        }
+        std::uint64_t time = binary_log::ticks();
+        std::size_t size = binary_log::kRecordHeader + (std::size_t{0} + ... + binary_log::argSize(args));
+        binary_log::StagingBuffer *buffer = staging_ != nullptr ? staging_ : createStagingBuffer();
+        char *out = size <= binary_log::StagingBuffer::kCapacity / 2 ? buffer->reserve(size) : nullptr;
+        if (out == nullptr) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            dropped_total_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto length = static_cast<std::uint32_t>(size - 4);
+        std::memcpy(out, &length, sizeof(length));
+        std::memcpy(out + 4, &id, sizeof(id));
+        std::memcpy(out + 8, &time, sizeof(time));
+        out += binary_log::kRecordHeader;
+        (binary_log::putArg(out, args), ...);
+        buffer->commit(size);
+        if (buffer->halfFull() && !wake_requested_.load(std::memory_order_relaxed) &&
+            !wake_requested_.exchange(true, std::memory_order_relaxed)) {
+            executor_->wake(*this);
+        }
+    }
+
+    std::atomic<std::uint32_t> &dynamicSite(LogLevel level) { return dynamic_sites_[static_cast<std::size_t>(level)]; }
+    std::uint32_t registerSite(LogLevel level, std::string format, const char *types);
+    binary_log::StagingBuffer *createStagingBuffer();
+
+    // Обслуживание исполнителем: переносит записи в файлы и отвечает на запросы flush().
+    std::chrono::steady_clock::time_point service(std::chrono::steady_clock::time_point now) override;
+
+    // Переносит записи из очереди в буфер и пишет его в файл.
+    void drain();
+    void writeBuffer();
+
+    // Переносит записи из буферов потоков в metrics.log.bin.
+    void drainBinary();
+    void writeBinary(const std::string &data);
+
     std::string log_filename_;
-    std::mutex mutex_;
-};
\ No newline at end of file
+    int fd_ = -1;
+    std::atomic<LogLevel> level_{LogLevel::Info};
+    std::atomic<LogFormat> format_{LogFormat::Text};
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(64) std::size_t dequeue_pos_ = 0;            // Только фоновый поток.
+    std::atomic<std::size_t> written_pos_{0};           // Позиция, до которой записи уже в файле.
+    std::atomic<std::uint64_t> dropped_{0};             // Отброшенные записи, еще не выведенные в журнал.
+    std::atomic<std::uint64_t> dropped_total_{0};
+
+    IoExecutor *executor_;             // Исполнитель, переносящий записи в файл.
+    std::mutex mutex_;                 // Только для запросов flush().
+    std::condition_variable flushed_cv_;
+    std::atomic<bool> wake_requested_{false};
+    bool stopped_ = false;
+    std::uint64_t flush_requested_ = 0; // Номер последнего запроса flush().
+    std::uint64_t flush_done_ = 0;      // Номер запроса, для которого записи уже в файле.
+
+    // Двоичный журнал
+    std::string binary_filename_;
+    int binary_fd_ = -1;
+    std::mutex sites_mutex_;                                   // Защищает sites_ и staging_buffers_.
+    std::vector<Site> sites_;                                  // Место вызова с номером id — sites_[id - 1].
+    std::vector<std::shared_ptr<binary_log::StagingBuffer>> staging_buffers_;
+    std::atomic<std::uint32_t> dynamic_sites_[static_cast<std::size_t>(LogLevel::Off) + 1] = {};
+    std::size_t written_sites_ = 0;                           // Места вызова, уже записанные в файл.
+    std::uint64_t start_ticks_ = 0;                           // binary_log::ticks() при создании.
+    std::int64_t start_ns_ = 0;                               // Реальное время при создании (нс от эпохи).
+    std::string binary_records_;                              // Записи, собранные фоновым потоком.
+    std::string binary_buffer_;                               // Места вызова и записи для одного write(2).
+
+    std::string buffer_;            // Буфер фонового потока.
+    TimestampFormatter timestamps_; // Форматирование меток времени (только фоновый поток).
+};
+
+/*
+    Ограничители частоты записей одного места вызова в одном потоке (макросы METRICS_LOG_EVERY_N
+    и METRICS_LOG_RATE_LIMITED хранят их в thread_local), поэтому проверка не требует блокировок
+    и атомарных операций. Число подавленных сообщений выводится вместе со следующей записью.
+*/
+
+// Пропускает первое и затем каждое n-е сообщение.
+class LogSampler
+{
+public:
+    // true — сообщение выводится; suppressed — сколько сообщений пропущено с предыдущего.
+    bool allow(std::uint64_t n, std::uint64_t &suppressed) {
+        if (started_ && skipped_ + 1 < n) {
+            ++skipped_;
+            return false;
+        }
+        started_ = true;
+        suppressed = skipped_;
+        skipped_ = 0;
+        return true;
+    }
+
+private:
+    bool started_ = false;
+    std::uint64_t skipped_ = 0;
+};
+
+// Маркерная корзина: не более per_second сообщений в секунду, всплеск до burst сообщений.
+class LogRateLimiter
+{
+public:
+    // true — сообщение выводится; suppressed — сколько сообщений подавлено с предыдущего.
+    bool allow(double per_second, double burst, std::uint64_t &suppressed) {
+        return allow(per_second, burst, std::chrono::steady_clock::now(), suppressed);
+    }
+
+    // То же для момента time (например, Clock::steadyNow() виртуальных часов в тестах).
+    bool allow(double per_second, double burst, std::chrono::steady_clock::time_point time, std::uint64_t &suppressed) {
+        std::int64_t now = time.time_since_epoch().count();
+        if (last_ == 0) {
+            tokens_ = burst;
+        } else {
+            using Period = std::chrono::steady_clock::period;
+            tokens_ += static_cast<double>(now - last_) * Period::num / Period::den * per_second;
+            if (tokens_ > burst) {
+                tokens_ = burst;
+            }
+        }
+        last_ = now;
+        if (tokens_ < 1.0) {
+            ++suppressed_;
+            return false;
+        }
+        tokens_ -= 1.0;
+        suppressed = suppressed_;
+        suppressed_ = 0;
+        return true;
+    }
+
+private:
+    double tokens_ = 0.0;
+    std::int64_t last_ = 0; // Время последней проверки (такты steady_clock, 0 — не было).
+    std::uint64_t suppressed_ = 0;
+};
+
+// Запись с форматом и аргументами, которые вычисляются только если запись будет выведена.
+// Вызовы ниже METRICS_LOG_MIN_LEVEL удаляются при компиляции.
+#define METRICS_LOG(level, ...)                                                                                          \
+    do {                                                                                                               \
+        if constexpr ((level) >= kMinLogLevel) {                                                                       \
+            Logger &metrics_logger_ = Logger::getInstance();                                                           \
+            if (metrics_logger_.enabled(level)) {                                                                      \
+                static std::atomic<std::uint32_t> metrics_log_site_{0};                                                \
+                metrics_logger_.formatAt(metrics_log_site_, (level), __VA_ARGS__);                                     \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#define METRICS_LOG_TRACE(...) METRICS_LOG(LogLevel::Trace, __VA_ARGS__)
+#define METRICS_LOG_DEBUG(...) METRICS_LOG(LogLevel::Debug, __VA_ARGS__)
+#define METRICS_LOG_INFO(...) METRICS_LOG(LogLevel::Info, __VA_ARGS__)
+#define METRICS_LOG_WARN(...) METRICS_LOG(LogLevel::Warn, __VA_ARGS__)
+#define METRICS_LOG_ERROR(...) METRICS_LOG(LogLevel::Error, __VA_ARGS__)
+
+// METRICS_LOG с ограничителем limiter (тип) и аргументами его allow().
+#define METRICS_LOG_LIMITED_(level, limiter, limit_args, ...)                                                          \
+    do {                                                                                                               \
+        if constexpr ((level) >= kMinLogLevel) {                                                                       \
+            Logger &metrics_logger_ = Logger::getInstance();                                                           \
+            if (metrics_logger_.enabled(level)) {                                                                      \
+                static thread_local limiter metrics_log_limiter_;                                                      \
+                std::uint64_t metrics_log_suppressed_ = 0;                                                             \
+                if (metrics_log_limiter_.allow(METRICS_LOG_UNPAREN_ limit_args, metrics_log_suppressed_)) {            \
+                    static std::atomic<std::uint32_t> metrics_log_sites_[2] = {};                                      \
+                    metrics_logger_.formatSuppressed(metrics_log_sites_, (level), metrics_log_suppressed_,             \
+                                                     __VA_ARGS__);                                                     \
+                }                                                                                                      \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#define METRICS_LOG_UNPAREN_(...) __VA_ARGS__
+
+// Первое и затем каждое n-е сообщение места вызова (в каждом потоке):
+//   METRICS_LOG_EVERY_N(LogLevel::Warn, 100, "Queue is full: {}", size);
+#define METRICS_LOG_EVERY_N(level, n, ...) METRICS_LOG_LIMITED_(level, LogSampler, (n), __VA_ARGS__)
+
+// Не более per_second сообщений места вызова в секунду (в каждом потоке), всплеск до burst:
+//   METRICS_LOG_RATE_LIMITED(LogLevel::Error, 1.0, 5, "Write failed: {}", error);
+#define METRICS_LOG_RATE_LIMITED(level, per_second, burst, ...)                                                        \
+    METRICS_LOG_LIMITED_(level, LogRateLimiter, ((per_second), (burst)), __VA_ARGS__)
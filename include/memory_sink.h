@@ -0,0 +1,43 @@
+#pragma once
+
+#include "encoder.h"
+#include "sink.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*
+    Получатель, кодирующий снимки в буфер в памяти, — для тестов, встраивания в другие
+    протоколы и передачи данных без файла.
+
+    Кодирование выполняется синхронно в publish() (под собственным мьютексом), поэтому
+    кодировщик должен быть быстрым; take() забирает накопленные байты.
+*/
+class MemorySink : public Sink
+{
+public:
+    // encoder == nullptr — текстовый формат.
+    explicit MemorySink(std::unique_ptr<Encoder> encoder = nullptr);
+
+    MemorySink(const MemorySink &) = delete;
+    MemorySink &operator=(const MemorySink &) = delete;
+
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
+    std::uint32_t sharedEncodings() const override { return encoder_->sharedEncodings(); }
+
+    // Возвращает закодированные с прошлого вызова данные (вместе с незакрытым блоком кодировщика)
+    // и очищает буфер. Следующий снимок начнет новый поток: кодировщик снова вызовет begin().
+    std::string take();
+
+    // Количество снимков, закодированных с момента создания.
+    std::uint64_t snapshots() const;
+
+private:
+    std::unique_ptr<Encoder> encoder_;
+    mutable std::mutex mutex_;
+    std::string buffer_;
+    bool started_ = false;
+    std::uint64_t snapshots_ = 0;
+};
@@ -1,6 +1,16 @@
 #pragma once
 
 #include "logger.h"
+#include "io_executor.h"
+#include "clock.h"
+#include "file_backends.h"
+#include "segment_archiver.h"
+#include "snapshot.h"
+#include "sink.h"
+#include "encoder.h"
+#include "binary_format.h"
+#include "timestamp_formatter.h"
+#include "value_format.h"
 
 #include <string>
 #include <memory>
@@ -8,6 +18,7 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 #include <thread>
 #include <fstream>
 #include <sstream>
@@ -17,6 +28,10 @@
 #include <iostream>
 #include <stdexcept>
 #include <ctime>
+#include <cstddef>
+#include <cstdint>
+
+class ProcessMetrics;
 
 /*
     Базовый абстрактный класс для всех метрик,
@@ -39,6 +54,12 @@ public:
     // Чисто виртуальная функция для сброса значения метрики.
     // Используется для инициализации значения метрики перед новым сбором.
     virtual void reset() = 0;
+
+    // Снимает текущее значение метрики в sample и сбрасывает метрику.
+    // Реализация по умолчанию сохраняет значение в текстовом виде (getValueAsString()) и вызывает reset();
+    // встроенные метрики переопределяют ее, чтобы передать типизированное значение и не потерять
+    // обновления между чтением и сбросом.
+    virtual void collect(MetricSample &sample);
 };
 
 /*
@@ -48,7 +69,9 @@ class Gauge : public Metric
 {
 public:
     // Конструктор, инициализирующий имя метрики и начальное значение 0.0.
-    Gauge(const std::string &name);
+    // precision — число знаков после запятой при выводе или kShortestPrecision для
+    // кратчайшего представления, однозначно восстанавливающего значение.
+    Gauge(const std::string &name, int precision = 2);
 
     // Обновляет значение метрики новым вещественным числом.
     void update(double value);
@@ -56,14 +79,21 @@ public:
     // Возвращает имя метрики.
     std::string getName() const override;
 
-    // Возвращает текущее значение метрики в виде строки с двумя знаками после запятой.
+    // Возвращает текущее значение метрики в виде строки с заданной точностью.
     std::string getValueAsString() const override;
 
+    // Возвращает точность вывода значения.
+    int getPrecision() const { return precision_; }
+
     // Сбрасывает значение метрики до 0.0.
     void reset() override;
 
+    // Снимает значение как MetricType::Gauge и сбрасывает его до 0.0.
+    void collect(MetricSample &sample) override;
+
 private:
     std::string name_;         // Имя метрики.
+    int precision_;            // Точность вывода значения.
     double value_;             // Текущее значение метрики.
     mutable std::mutex mutex_; // Мьютекс для обеспечения потокобезопасности при доступе к значению.
 };
@@ -89,60 +119,254 @@ public:
     // Сбрасывает значение счетчика до 0.
     void reset() override;
 
+    // Снимает значение как MetricType::Counter и сбрасывает его до 0.
+    void collect(MetricSample &sample) override;
+
 private:
     std::string name_;         // Имя метрики.
     int value_;                // Текущее значение счетчика.
     mutable std::mutex mutex_; // Мьютекс для обеспечения потокобезопасности при доступе к значению.
 };
 
+/*
+    Класс метрики типа Histogram для распределения значений (например, время ответа).
+    Значения раскладываются по корзинам с явными границами; при сборе снимаются
+    количество, сумма и счетчики корзин за интервал.
+*/
+class Histogram : public Metric
+{
+public:
+    // Конструктор, инициализирующий имя метрики и границы корзин.
+    // Границы сортируются; повторяющиеся отбрасываются.
+    Histogram(const std::string &name, std::vector<double> bounds);
+
+    // Учитывает значение в соответствующей корзине.
+    void observe(double value);
+
+    // Возвращает имя метрики.
+    std::string getName() const override;
+
+    // Возвращает текущее значение в виде count=N;sum=S;граница:число;...;+Inf:число.
+    std::string getValueAsString() const override;
+
+    // Возвращает границы корзин.
+    const std::vector<double> &getBounds() const { return *bounds_; }
+
+    // Обнуляет количество, сумму и корзины.
+    void reset() override;
+
+    // Снимает значение как MetricType::Histogram и обнуляет его.
+    void collect(MetricSample &sample) override;
+
+private:
+    std::string name_;                                  // Имя метрики.
+    std::shared_ptr<const std::vector<double>> bounds_; // Границы корзин (разделяются со снимками).
+    std::vector<std::uint64_t> counts_;                 // Количество значений в корзинах.
+    std::uint64_t count_ = 0;                           // Общее количество значений.
+    double sum_ = 0.0;                                  // Сумма значений.
+    mutable std::mutex mutex_;                          // Мьютекс для обеспечения потокобезопасности при доступе к значению.
+};
+
 /*
     Потокобезопасная очередь для передачи данных метрик между потоками.
+    Хранит указатели на неизменяемые снимки, поэтому передача снимка не копирует его.
 */
 class ThreadSafeQueue
 {
 public:
-    // Добавляет данные (вектор пар имя-значение) в очередь.
-    void push(const std::vector<std::pair<std::string, std::string>> &data);
+    using Item = std::shared_ptr<const Snapshot>;
+
+    // Добавляет снимок метрик в очередь.
+    void push(Item data);
 
     // Пытается извлечь данные из очереди без ожидания. Возвращает false, если очередь пуста.
-    bool tryPop(std::vector<std::pair<std::string, std::string>> &data);
+    bool tryPop(Item &data);
 
     // Ожидает, пока в очереди не появятся данные, и извлекает их.
-    void waitAndPop(std::vector<std::pair<std::string, std::string>> &data);
+    void waitAndPop(Item &data);
+
+    // Ожидает данные не дольше указанного момента времени. Возвращает false, если данных нет
+    // (истек таймаут или очередь остановлена и пуста).
+    bool waitAndPopUntil(Item &data, std::chrono::steady_clock::time_point deadline);
+
+    // Возвращает true, если очередь остановлена и в ней не осталось данных.
+    bool isDrained();
+
+    // Возвращает количество элементов в очереди.
+    std::size_t size() const;
 
     // Останавливает очередь, уведомляя все ожидающие потоки.
     void stop();
 
 private:
-    std::queue<std::vector<std::pair<std::string, std::string>>> queue_; // Очередь для хранения данных метрик.
-    std::mutex mutex_;                                                   // Мьютекс для синхронизации доступа к очереди.
-    std::condition_variable cond_var_;                                   // Условная переменная для уведомления потоков о новых данных.
-    std::atomic<bool> stopped_{false};                                   // Флаг, указывающий, что очередь остановлена.
+    std::queue<Item> queue_;           // Очередь для хранения снимков метрик.
+    mutable std::mutex mutex_;         // Мьютекс для синхронизации доступа к очереди.
+    std::condition_variable cond_var_; // Условная переменная для уведомления потоков о новых данных.
+    std::atomic<bool> stopped_{false}; // Флаг, указывающий, что очередь остановлена.
+};
+
+/*
+    Политика буферизации MetricsWriter.
+    По умолчанию каждая строка сразу передается в файл (как и раньше);
+    при ненулевых порогах строки накапливаются в буфере пользовательского пространства
+    и записываются одним системным вызовом.
+*/
+struct WriterOptions
+{
+    std::size_t flush_bytes = 0;                    // Сбрасывать буфер, когда в нем накопилось столько байт (0 — после каждой строки).
+    std::chrono::milliseconds flush_interval{0};    // Сбрасывать буфер не позже, чем через этот интервал после первой строки в нем (0 — не ограничено).
+    std::chrono::milliseconds fsync_interval{0};    // Вызывать fdatasync не чаще этого интервала при наличии новых данных (0 — не вызывать).
+    WriterBackend backend = WriterBackend::Posix;   // Способ передачи данных в файл.
+    std::size_t mmap_extent = 16 * 1024 * 1024;     // Шаг предварительного выделения файла для WriterBackend::Mmap.
+
+    OutputFormat format = OutputFormat::Text;       // Формат файла (если кодировщик не передан в конструктор).
+    bool utc_timestamps = false;                    // Писать метки времени текстового формата в UTC, а не в локальном времени.
+    std::size_t binary_block_rows = 120;            // Максимум строк в блоке двоичного формата. Незаполненный блок
+                                                    // закрывается по flush_interval, при flush() и при ротации.
+
+    std::uint64_t rotate_bytes = 0;                 // Ротировать файл, когда его размер достиг этого значения (0 — не ротировать по размеру).
+    std::chrono::seconds rotate_interval{0};        // Ротировать файл на границах этого периода от начала эпохи (0 — не ротировать по времени).
+    unsigned retention = 0;                         // Сколько закрытых сегментов хранить (0 — без ограничения).
+    bool compress_rotated = false;                  // Сжимать закрытые сегменты gzip в фоновом потоке.
+
+    IoExecutor *executor = nullptr;                 // Исполнитель, выполняющий запись (nullptr — IoExecutor::shared()).
+    IoPriority priority = IoPriority::Normal;       // Приоритет записи среди задач исполнителя (flush() — всегда High).
+
+    Clock *clock = nullptr;                         // Часы меток времени и сроков сброса и ротации (nullptr — Clock::system()).
+                                                    // MetricsCollector с файлом использует те же часы для времени сбора.
+    std::shared_ptr<Histogram> durable_latency;     // Задержка от сбора снимка до передачи его строки в файл (после
+                                                    // fdatasync, если он включен), мс. nullptr — не измерять.
+};
+
+/*
+    Счетчики работы MetricsWriter (для бенчмарков и диагностики).
+*/
+struct WriterStats
+{
+    std::uint64_t lines = 0;       // Количество записанных строк.
+    std::uint64_t bytes = 0;       // Количество записанных байт.
+    std::uint64_t write_calls = 0; // Количество системных вызовов записи (write, pwrite или io_uring_enter).
+    std::uint64_t sync_calls = 0;  // Количество запросов fdatasync.
+    std::uint64_t errors = 0;      // Количество ошибок записи и синхронизации.
+    std::uint64_t rotations = 0;   // Количество выполненных ротаций файла.
+    std::uint64_t stalls = 0;      // Сколько раз файл принял буфер не целиком (все буферы io_uring в работе).
+    std::size_t queued = 0;        // Количество снимков в очереди, еще не переданных в буфер.
 };
 
 /*
      Класс для асинхронной записи метрик в файл.
+     Является получателем снимков (Sink): кодирует их кодировщиком формата (Encoder) в буфер
+     и передает в файл через бэкенд записи (FileBackend). Собственного потока нет: очередь
+     снимков обслуживает исполнитель ввода-вывода (IoExecutor), общий для всех файлов и журнала.
 */
-class MetricsWriter
+class MetricsWriter : public Sink, private IoTask
 {
 public:
-    // Конструктор, принимающий имя файла для записи метрик и запускающий поток записи.
-    MetricsWriter(const std::string &filename);
+    // Конструктор, принимающий имя файла для записи метрик и политику буферизации.
+    // Открывает файл и подключается к исполнителю; при ошибке открытия бросает std::runtime_error.
+    MetricsWriter(const std::string &filename, const WriterOptions &options = WriterOptions());
+
+    // То же с пользовательским кодировщиком вместо встроенного формата options.format.
+    MetricsWriter(const std::string &filename, std::unique_ptr<Encoder> encoder,
+                  const WriterOptions &options = WriterOptions());
+
+    // Деструктор, отключающийся от исполнителя, дописывающий очередь и буфер и освобождающий ресурсы.
+    ~MetricsWriter() override;
 
-    // Деструктор, останавливающий поток записи и освобождающий ресурсы.
-    ~MetricsWriter();
+    // Добавляет снимок в очередь для записи в файл без копирования.
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
 
-    // Добавляет метрики (вектор пар имя-значение) в очередь для записи в файл.
+    // Общие представления снимка, которые использует кодировщик файла.
+    std::uint32_t sharedEncodings() const override { return encoder_->sharedEncodings(); }
+
+    // Добавляет снимок метрик в очередь для записи в файл.
+    void write(Snapshot snapshot);
+
+    // Добавляет метрики (вектор пар имя-значение) в очередь для записи в файл как значения типа Text.
     void write(const std::vector<std::pair<std::string, std::string>> &metrics);
 
+    // Дожидается записи в файл всех ранее переданных метрик (и fdatasync, если он включен).
+    void flush();
+
+    // Возвращает текущие счетчики записи.
+    WriterStats getStats() const;
+
+    // Очередь, записанные байты и ошибки; длительность измеряется для каждой передачи буфера в файл.
+    SinkStats sinkStats() const override;
+
 private:
-    // Метод, выполняемый в отдельном потоке, для чтения метрик из очереди и записи в файл.
-    void run();
+    // Обслуживание исполнителем: извлекает все снимки из очереди, накапливает строки в буфере
+    // и сбрасывает их в файл по порогам размера и времени.
+    std::chrono::steady_clock::time_point service(std::chrono::steady_clock::time_point now) override;
+
+    // Сбрасывает буфер, синхронизирует и ротирует файл по наступившим порогам.
+    void checkThresholds(std::chrono::steady_clock::time_point now);
+
+    // Кодирует снимок в формате файла и добавляет его в буфер.
+    void appendLine(const Snapshot &snapshot);
+
+    // Начинает новый файл или сеанс записи в существующий файл (заголовки формата, см. Encoder::begin).
+    void beginFile();
+
+    // Передает содержимое буфера бэкенду одной операцией дозаписи. Остаток, который бэкенд не принял
+    // без ожидания, остается в буфере: при wait бэкенд дожидается завершения своих записей,
+    // иначе возвращается false, и передача повторяется по retry_deadline_.
+    bool flushBuffer(bool wait = false);
+
+    // Учитывает в durable_latency задержку снимков со временем сбора captures и очищает их.
+    void observeDurable(std::vector<std::chrono::steady_clock::time_point> &captures);
+
+    // Запрашивает fdatasync, если с момента последней синхронизации были записаны данные.
+    // Если бэкенд не может принять запрос без ожидания, при wait дожидается его, иначе возвращает false.
+    bool syncFile(bool wait = false);
+
+    // Включена ли ротация файла.
+    bool rotationEnabled() const;
+
+    // Закрывает текущий файл, атомарно переименовывает его в сегмент и открывает новый файл.
+    // Если переименовать файл или открыть новый не удалось, ошибка учитывается в статистике,
+    // а запись продолжается в прежний файл.
+    void rotate(std::chrono::system_clock::time_point now);
+
+    // Вычисляет момент следующей ротации по времени после now.
+    std::chrono::system_clock::time_point nextRotationTime(std::chrono::system_clock::time_point now) const;
 
     std::string filename_;      // Имя файла для записи метрик.
+    WriterOptions options_;     // Политика буферизации.
+    std::unique_ptr<FileBackend> backend_; // Бэкенд, выполняющий запись в файл.
+    std::string buffer_;        // Буфер строк, еще не переданных в файл.
+    std::unique_ptr<Encoder> encoder_; // Кодировщик формата файла.
+    bool unsynced_ = false;     // Есть ли данные, записанные после последнего fdatasync.
+    std::vector<std::chrono::steady_clock::time_point> buffered_captures_; // Время сбора снимков в буфере (для durable_latency).
+    std::vector<std::chrono::steady_clock::time_point> unsynced_captures_; // То же для записанных, но не синхронизированных.
+    std::chrono::system_clock::time_point next_rotation_; // Момент следующей ротации по времени.
+    std::unique_ptr<SegmentArchiver> archiver_; // Фоновое сжатие и удаление сегментов (если включена ротация).
     ThreadSafeQueue queue_;     // Очередь для асинхронной обработки метрик.
-    std::thread writer_thread_; // Поток, выполняющий запись в файл.
-    std::atomic<bool> running_; // Флаг, указывающий, что поток записи активен.
+    IoExecutor *executor_;      // Исполнитель, обслуживающий очередь.
+    Clock *clock_;              // Часы меток времени и сроков.
+    std::chrono::steady_clock::time_point flush_deadline_ = std::chrono::steady_clock::time_point::max(); // Срок сброса буфера.
+    std::chrono::steady_clock::time_point sync_deadline_ = std::chrono::steady_clock::time_point::max();  // Срок fdatasync.
+    std::chrono::steady_clock::time_point retry_deadline_ = std::chrono::steady_clock::time_point::max(); // Срок повторной передачи остатка буфера.
+
+    // Через сколько повторяется передача, которую бэкенд не принял: поток исполнителя общий, поэтому
+    // освобождения буферов он не ждет, а возвращается к другим задачам.
+    static constexpr std::chrono::milliseconds kStallRetryDelay{1};
+
+    std::mutex flush_mutex_;              // Синхронизация flush() с потоком записи.
+    std::condition_variable flush_cv_;    // Уведомление о выполненных запросах flush().
+    std::uint64_t flush_requested_ = 0;   // Количество запросов flush() (маркеров в очереди).
+    std::uint64_t flush_done_ = 0;        // Количество обработанных запросов flush().
+
+    std::atomic<std::uint64_t> lines_{0};       // Счетчики для getStats().
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> rotations_{0};
+    std::atomic<std::uint64_t> stalls_{0};
+    std::atomic<std::uint64_t> appends_{0};     // Передачи буфера в файл и их суммарная длительность (нс).
+    std::atomic<std::uint64_t> append_ns_{0};
+    mutable std::mutex backend_mutex_;          // Защищает замену backend_ при ротации от getStats().
+    std::uint64_t closed_write_calls_ = 0;      // Счетчики бэкендов, закрытых при ротации.
+    std::uint64_t closed_sync_calls_ = 0;
+    std::uint64_t closed_errors_ = 0;
 };
 
 /*
@@ -151,17 +375,86 @@ private:
 class MetricsCollector
 {
 public:
-    // Конструктор, инициализирующий сборщик с указанным файлом для записи метрик.
-    MetricsCollector(const std::string &filename);
+    // Сборщик без файла: снимки передаются только получателям, подключенным через addSink().
+    // Время сбора снимков берется из часов clock.
+    explicit MetricsCollector(Clock &clock = Clock::system());
+
+    // Конструктор, инициализирующий сборщик с указанным файлом для записи метрик и политикой буферизации.
+    // Файл подключается как первый получатель (MetricsWriter); часы сбора — options.clock.
+    MetricsCollector(const std::string &filename, const WriterOptions &options = WriterOptions());
+
+    ~MetricsCollector();
 
     // Добавляет метрику в список для последующего сбора.
     void addMetric(std::shared_ptr<Metric> metric);
 
-    // Собирает текущие значения всех метрик и отправляет их на запись в файл.
+    // Подключает получателя, которому передается каждый снимок помимо записи в файл.
+    void addSink(std::shared_ptr<Sink> sink);
+
+    // Собирает текущие значения всех метрик и передает один и тот же снимок всем получателям.
     void collectAndWrite();
 
+    // Добавляет собственные метрики библиотеки с префиксом имен prefix: длительность предыдущего
+    // сбора, размер снимка, глубину очередей получателей, среднюю длительность записи в файл,
+    // а также записанные байты, отброшенные снимки и ошибки получателей за интервал.
+    // Значения обновляются в начале каждого collectAndWrite(). Повторный вызов ничего не делает.
+    void enableSelfMetrics(const std::string &prefix = "metrics_");
+
+    // Добавляет метрики ресурсов процесса (ProcessMetrics) с префиксом имен prefix: процессорное время,
+    // резидентную память, страничные отказы, переключения контекста, дескрипторы и потоки.
+    // Показания снимаются один раз в начале каждого collectAndWrite(). Повторный вызов ничего не делает.
+    void enableProcessMetrics(const std::string &prefix = "process_");
+
 private:
+    // Собственные метрики библиотеки (enableSelfMetrics()).
+    struct SelfMetrics
+    {
+        std::shared_ptr<Gauge> collect_duration;     // Длительность предыдущего collectAndWrite(), мс.
+        std::shared_ptr<Gauge> snapshot_samples;     // Число значений в предыдущем снимке.
+        std::shared_ptr<Gauge> queue_depth;          // Снимки в очередях всех получателей.
+        std::shared_ptr<Gauge> write_latency;        // Средняя длительность записи в файл за интервал, мс.
+        std::shared_ptr<Counter> bytes_written;      // Байты, записанные и отправленные получателями за интервал.
+        std::shared_ptr<Counter> dropped_snapshots;  // Снимки, отброшенные получателями за интервал.
+        std::shared_ptr<Counter> writer_errors;      // Ошибки записи и отправки за интервал.
+        SinkStats last;                              // Суммарные счетчики получателей на предыдущем такте.
+        std::atomic<std::uint64_t> collect_ns{0};    // Длительность предыдущего сбора, нс.
+        std::atomic<std::uint64_t> samples{0};       // Размер предыдущего снимка.
+    };
+
+    // Обновляет собственные метрики по предыдущему такту и счетчикам получателей (под mutex_).
+    void updateSelfMetrics(const SinkStats &total);
+
+    Clock *clock_;                                 // Часы времени сбора.
+    std::unique_ptr<SelfMetrics> self_metrics_;    // Собственные метрики или nullptr, если выключены.
+    std::unique_ptr<ProcessMetrics> process_metrics_; // Ресурсы процесса или nullptr, если выключены.
     std::vector<std::shared_ptr<Metric>> metrics_; // Список зарегистрированных метрик.
-    MetricsWriter writer_;                         // Объект для записи метрик в файл.
     std::mutex mutex_;                             // Мьютекс для синхронизации доступа к списку метрик.
+    std::vector<std::shared_ptr<Sink>> sinks_;     // Получатели снимков (включая файл, если он задан).
+    std::mutex sinks_mutex_;                       // Мьютекс списка получателей (не удерживается во время сбора).
+};
+
+/*
+    Периодический сбор: вызывает MetricsCollector::collectAndWrite() с постоянным интервалом
+    по часам clock. Сроки тактов отсчитываются от начала, поэтому длительность сбора не накапливает
+    сдвиг, а такты, пропущенные из-за долгого сбора, не наверстываются.
+    С VirtualClock часы сбора выполняются без ожидания.
+*/
+class CollectionScheduler
+{
+public:
+    CollectionScheduler(MetricsCollector &collector, std::chrono::nanoseconds interval, Clock &clock = Clock::system());
+
+    // Функция, вызываемая перед каждым тактом с его номером (с нуля), например для обновления метрик.
+    void onTick(std::function<void(std::size_t)> callback);
+
+    // Выполняет такты в вызывающем потоке, пока по часам не пройдет duration; первый такт — через interval.
+    // Возвращает количество выполненных тактов.
+    std::size_t runFor(std::chrono::nanoseconds duration);
+
+private:
+    MetricsCollector &collector_;
+    std::chrono::nanoseconds interval_;
+    Clock &clock_;
+    std::function<void(std::size_t)> on_tick_;
+    std::size_t ticks_ = 0; // Номер следующего такта.
 };
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "binary_format.h"
+#include "snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Значение метрики в записанном файле вместе с меткой времени строки.
+*/
+struct MetricPoint
+{
+    std::int64_t timestamp_ms = 0; // Метка времени строки, миллисекунды с начала эпохи.
+    MetricSample sample;           // Значение; для текстовых файлов — MetricType::Text.
+};
+
+/*
+    Параметры MetricsReader.
+*/
+struct ReaderOptions
+{
+    bool utc_timestamps = false;         // Метки времени текстового файла записаны в UTC, а не в локальном времени.
+    std::size_t index_stride = 64 * 1024; // Шаг разреженного индекса текстового файла в байтах.
+    bool use_sidecar = true;             // Хранить индекс текстового файла рядом с ним (<файл>.idx) и дополнять его.
+};
+
+/*
+    Чтение записанных метрик по диапазону времени.
+
+    Файл отображается в память. Для текстового формата строится разреженный индекс
+    (метка времени первой строки после каждых index_stride байт), который сохраняется
+    в <файл>.idx и при следующем открытии дополняется только для дописанного хвоста.
+    Для двоичного формата индексом служат заголовки блоков: при открытии читатель
+    проходит по записям, не раскодируя их. Запрос переходит сразу к нужному месту
+    и раскодирует только блоки или строки, пересекающиеся с диапазоном.
+    Поддерживаются текстовый, двоичный и табличные (Csv/Tsv) форматы, в том числе внутри файла
+    WriterBackend::Mmap. Для Csv/Tsv колонка метрики определяется по ближайшей предшествующей
+    строке заголовка, которая ищется обратным просмотром от начальной точки запроса.
+*/
+class MetricsReader
+{
+public:
+    // Формат открытого файла.
+    enum class Format
+    {
+        Text,
+        Binary,
+        Csv,
+        Tsv
+    };
+
+    // Открывает и индексирует файл; при ошибке бросает std::runtime_error.
+    explicit MetricsReader(const std::string &filename, const ReaderOptions &options = ReaderOptions());
+    ~MetricsReader();
+
+    MetricsReader(const MetricsReader &) = delete;
+    MetricsReader &operator=(const MetricsReader &) = delete;
+
+    // Возвращает значения метрики name в строках с меткой времени из [from_ms, to_ms].
+    std::vector<MetricPoint> query(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const;
+
+    // Формат файла.
+    Format format() const { return format_; }
+
+    // Количество записей индекса (точек текстового индекса или блоков двоичного файла).
+    std::size_t indexSize() const;
+
+    // Сколько байт данных было прочитано последним запросом (для оценки эффективности индекса).
+    std::size_t lastScannedBytes() const { return last_scanned_; }
+
+    // Разбирает метку времени вида YYYY-MM-DD HH:MM:SS[.mmm]; возвращает false при ошибке формата.
+    static bool parseTimestamp(const char *text, std::size_t size, bool utc, std::int64_t &timestamp_ms);
+
+private:
+    // Точка разреженного индекса текстового файла.
+    struct TextIndexEntry
+    {
+        std::int64_t timestamp_ms; // Метка времени строки.
+        std::uint64_t offset;      // Смещение начала строки от начала данных.
+    };
+
+    // Блок двоичного файла.
+    struct BlockIndexEntry
+    {
+        std::int64_t first_ts;   // Метка времени первой строки.
+        std::int64_t last_ts;    // Метка времени последней строки.
+        std::uint64_t offset;    // Смещение тела блока от начала данных.
+        std::uint64_t length;    // Длина тела блока.
+        std::size_t dictionary;  // Номер словаря, действующего для блока.
+    };
+
+    void buildTextIndex();
+    bool loadSidecar(std::uint64_t &indexed_length);
+    void saveSidecar(std::uint64_t indexed_length) const;
+    void buildBinaryIndex();
+    // Смещение строки заголовка Csv/Tsv, действующей для строки по смещению position, или npos.
+    std::size_t findHeader(std::size_t position, char delimiter) const;
+    std::vector<MetricPoint> queryText(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const;
+    std::vector<MetricPoint> queryBinary(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const;
+
+    std::string filename_;
+    ReaderOptions options_;
+    Format format_ = Format::Text;
+    char *map_ = nullptr;         // Отображение всего файла.
+    std::size_t map_size_ = 0;
+    const char *data_ = nullptr;  // Начало данных (после заголовка mmap-файла).
+    std::size_t size_ = 0;        // Длина данных.
+    std::uint64_t inode_ = 0;     // Идентификатор файла для проверки индекса.
+
+    std::vector<TextIndexEntry> text_index_;
+    std::vector<BlockIndexEntry> block_index_;
+    std::vector<std::vector<BinaryColumn>> dictionaries_;
+    mutable std::size_t last_scanned_ = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "encoder.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    Параметры OtlpEncoder.
+*/
+struct OtlpOptions
+{
+    std::string service_name = "unknown_service"; // Атрибут ресурса service.name.
+    std::vector<std::pair<std::string, std::string>> resource_attributes; // Дополнительные атрибуты ресурса.
+    std::string scope_name = "metrics_library";  // Имя InstrumentationScope.
+    std::string scope_version;                   // Версия InstrumentationScope (пусто — не передается).
+};
+
+/*
+    Кодировщик снимков в OTLP (OpenTelemetry Protocol) без зависимостей от protobuf:
+    каждый снимок — одно сообщение opentelemetry.proto.collector.metrics.v1.ExportMetricsServiceRequest
+    с одним ResourceMetrics и одним ScopeMetrics, перед которым записана его длина (varint),
+    как в parseDelimitedFrom/writeDelimitedTo protobuf. Поток кадров пишется в файл (MetricsWriter)
+    или в Unix-сокет локального коллектора (UnixSocketSink).
+
+    Соответствие типов:
+      Gauge     — Gauge, NumberDataPoint.as_double;
+      Counter   — Sum (AGGREGATION_TEMPORALITY_DELTA, is_monotonic), NumberDataPoint.as_int;
+      Histogram — Histogram (DELTA) с явными границами корзин;
+      Text      — Gauge, если значение является числом, иначе не передается.
+    Значения Counter и Histogram в библиотеке сбрасываются при каждом сборе, поэтому интервал
+    точки — от предыдущего снимка (для первого — от создания кодировщика) до текущего.
+
+    Ресурс и scope кодируются один раз в конструкторе. Размеры вложенных сообщений вычисляются
+    первым проходом по снимку в переиспользуемый массив, после чего сообщение пишется одним
+    проходом в зарезервированный буфер: кодирование не выделяет память на метрику.
+*/
+class OtlpEncoder : public Encoder
+{
+public:
+    explicit OtlpEncoder(const OtlpOptions &options = OtlpOptions());
+
+    void begin(std::string &out, bool new_file) override;
+    void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) override;
+
+private:
+    // Размеры сообщений одной метрики, вычисленные первым проходом.
+    struct Layout
+    {
+        bool skip = false;         // Метрика не передается (нечисловой Text).
+        double value = 0.0;        // Числовое значение Text.
+        std::size_t point = 0;     // Размер точки (NumberDataPoint или HistogramDataPoint).
+        std::size_t data = 0;      // Размер Gauge, Sum или Histogram.
+        std::size_t metric = 0;    // Размер Metric.
+    };
+
+    void measure(const MetricSample &sample, Layout &layout) const;
+    void writeMetric(const MetricSample &sample, const Layout &layout, std::uint64_t time_ns, std::string &out) const;
+
+    std::string resource_; // Поле ResourceMetrics.resource (тег, длина, Resource).
+    std::string scope_;    // Поле ScopeMetrics.scope (тег, длина, InstrumentationScope).
+    std::uint64_t start_ns_ = 0; // Начало интервала следующего снимка.
+    std::vector<Layout> layouts_;
+};
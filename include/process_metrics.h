@@ -0,0 +1,91 @@
+#pragma once
+
+#include "metrics_library.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+/*
+    Показания ресурсов процесса на момент ProcessMetrics::update().
+*/
+struct ProcessStats
+{
+    std::uint64_t cpu_user_us = 0;            // Процессорное время в режиме пользователя с запуска, мкс.
+    std::uint64_t cpu_system_us = 0;          // Процессорное время в режиме ядра с запуска, мкс.
+    std::uint64_t rss_bytes = 0;              // Резидентная память.
+    std::uint64_t minor_faults = 0;           // Страничные отказы без чтения с диска с запуска.
+    std::uint64_t major_faults = 0;           // Страничные отказы с чтением с диска с запуска.
+    std::uint64_t voluntary_switches = 0;     // Добровольные переключения контекста (ожидание) с запуска.
+    std::uint64_t involuntary_switches = 0;   // Вытеснения планировщиком с запуска.
+    std::uint64_t open_fds = 0;               // Открытые файловые дескрипторы.
+    std::uint64_t threads = 0;                // Потоки процесса.
+};
+
+/*
+    Ресурсы текущего процесса как набор метрик с префиксом имен prefix:
+      - cpu_usage (Gauge, %) — процессорное время за интервал относительно его длительности
+        (100 — одно ядро целиком);
+      - cpu_time_ms (Counter) — процессорное время (пользователь и ядро) за интервал;
+      - rss_bytes, open_fds, threads (Gauge) — резидентная память, дескрипторы и потоки;
+      - minor_faults, major_faults, voluntary_switches, involuntary_switches (Counter) —
+        страничные отказы и переключения контекста за интервал.
+
+    update() снимает показания одним pread() заранее открытого /proc/self/stat (потоки и RSS),
+    одним getrusage() (время, отказы, переключения) и fstat() открытого каталога /proc/self/fd,
+    размер которого в Linux 6.2+ равен числу дескрипторов (на старых ядрах каталог перечитывается).
+    Файлы не открываются заново, поэтому обновление стоит единицы микросекунд.
+
+    Интервалы считаются по реальному времени (std::chrono::steady_clock) независимо от часов сборщика:
+    ресурсы расходуются в реальном времени. Класс не потокобезопасен: update() вызывается из одного
+    потока, обычно потока сбора (MetricsCollector::enableProcessMetrics() — один раз за такт).
+*/
+class ProcessMetrics
+{
+public:
+    // Открывает /proc/self/stat и /proc/self/fd и снимает начальные показания.
+    // Бросает std::runtime_error, если /proc недоступен.
+    explicit ProcessMetrics(const std::string &prefix = "process_");
+
+    ~ProcessMetrics();
+
+    ProcessMetrics(const ProcessMetrics &) = delete;
+    ProcessMetrics &operator=(const ProcessMetrics &) = delete;
+
+    // Метрики для MetricsCollector::addMetric().
+    std::vector<std::shared_ptr<Metric>> metrics() const;
+
+    // Снимает показания и обновляет метрики: Counter получают приращение с предыдущего вызова.
+    void update();
+
+    // Показания последнего update() (или конструктора).
+    const ProcessStats &last() const { return last_; }
+
+private:
+    // Читает показания; false, если /proc/self/stat не прочитан (остальные поля заполнены).
+    bool read(ProcessStats &stats);
+
+    // Считает открытые дескрипторы.
+    std::uint64_t countFds();
+
+    int stat_fd_ = -1;                 // Открытый /proc/self/stat.
+    DIR *fd_dir_ = nullptr;            // Открытый каталог /proc/self/fd.
+    bool fd_count_from_size_ = false;  // Размер каталога /proc/self/fd равен числу дескрипторов (Linux 6.2+).
+
+    std::shared_ptr<Gauge> cpu_usage_;
+    std::shared_ptr<Counter> cpu_time_;
+    std::shared_ptr<Gauge> rss_;
+    std::shared_ptr<Gauge> open_fds_;
+    std::shared_ptr<Gauge> threads_;
+    std::shared_ptr<Counter> minor_faults_;
+    std::shared_ptr<Counter> major_faults_;
+    std::shared_ptr<Counter> voluntary_switches_;
+    std::shared_ptr<Counter> involuntary_switches_;
+
+    ProcessStats last_;                                  // Показания предыдущего вызова.
+    std::chrono::steady_clock::time_point last_time_;    // Время предыдущих показаний.
+};
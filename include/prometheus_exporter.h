@@ -0,0 +1,109 @@
+#pragma once
+
+#include "sink.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Параметры PrometheusExporter.
+*/
+struct PrometheusOptions
+{
+    std::string bind_address = "127.0.0.1"; // Адрес IPv4 для прослушивания (по умолчанию только loopback).
+    std::uint16_t port = 9464;              // Порт; 0 — выбрать свободный (см. PrometheusExporter::port()).
+    std::string path = "/metrics";          // Путь, по которому отдаются метрики.
+    std::string prefix;                     // Префикс имен метрик (например, "app_").
+    std::size_t max_connections = 64;       // Максимум одновременных соединений; лишние закрываются сразу.
+};
+
+/*
+    Встроенный HTTP/1.1 сервер, отдающий последний снимок метрик в текстовом формате Prometheus.
+
+    Работает в одном потоке на epoll. publish() только ставит указатель на снимок в очередь и будит поток;
+    поток один раз на снимок формирует полный HTTP-ответ (заголовки и тело) и кэширует его,
+    а каждый запрос GET отправляет готовый буфер. Поэтому опрос не обращается к метрикам
+    и не захватывает MetricsCollector::mutex_.
+
+    Gauge экспортируется как gauge. Counter в библиотеке сбрасывается при каждом сборе,
+    поэтому экспортер накапливает значения и отдает монотонный counter с суффиксом _total.
+    Histogram так же накапливается и отдается как histogram (_bucket с накопительными le, _sum, _count).
+    Значение MetricType::Text, являющееся числом, экспортируется как untyped,
+    остальные — как <name>_info{value="..."} 1. Недопустимые символы имени заменяются на '_'.
+*/
+class PrometheusExporter : public Sink
+{
+public:
+    // Открывает слушающий сокет и запускает поток; при ошибке бросает std::runtime_error.
+    explicit PrometheusExporter(const PrometheusOptions &options = PrometheusOptions());
+    ~PrometheusExporter() override;
+
+    PrometheusExporter(const PrometheusExporter &) = delete;
+    PrometheusExporter &operator=(const PrometheusExporter &) = delete;
+
+    // Сохраняет снимок для следующих ответов. Не блокируется.
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
+
+    // Порт, на котором принимаются соединения.
+    std::uint16_t port() const { return port_; }
+
+    // Количество обслуженных запросов метрик.
+    std::uint64_t scrapes() const { return scrapes_.load(std::memory_order_relaxed); }
+
+private:
+    struct Response;
+    struct Connection;
+
+    // Формирует статический ответ с телом body.
+    static std::shared_ptr<Response> makeResponse(const char *status, const std::string &body, bool close);
+
+    void run();
+    // Учитывает значения Counter снимков и формирует ответ по последнему из них.
+    void render(const std::vector<std::shared_ptr<const Snapshot>> &snapshots);
+    void acceptConnections();
+
+    // Читает доступные данные соединения; возвращает false, если соединение закрыто.
+    bool readRequest(int fd, Connection &connection);
+
+    // Разбирает запросы из входного буфера и отправляет ответы, пока сокет принимает данные.
+    void serve(int fd, Connection &connection);
+
+    // Выбирает ответ для следующего полного запроса; возвращает false, если запрос еще не получен целиком.
+    bool nextRequest(Connection &connection);
+
+    void setWriteInterest(int fd, Connection &connection, bool enabled);
+    // Подписывает соединение на события по его состоянию (чтение, ожидание записи).
+    void updateEvents(int fd, Connection &connection);
+    void closeConnection(int fd);
+
+    PrometheusOptions options_;
+    int listen_fd_ = -1;
+    int event_fd_ = -1;  // Пробуждение потока: новый снимок или остановка.
+    int epoll_fd_ = -1;
+    std::uint16_t port_ = 0;
+
+    std::vector<std::shared_ptr<const Snapshot>> pending_; // Снимки, еще не учтенные потоком сервера.
+    std::mutex pending_mutex_;                              // Защищает только pending_.
+    std::atomic<bool> running_{true};
+    std::atomic<std::uint64_t> scrapes_{0};
+
+    // Состояние потока сервера.
+    std::shared_ptr<Response> response_;                // Кэшированный ответ на запрос метрик.
+    std::shared_ptr<Response> not_found_;               // Ответ 404.
+    std::shared_ptr<Response> bad_request_;             // Ответ 400 (соединение закрывается).
+    std::shared_ptr<Response> not_allowed_;             // Ответ 405 на методы, кроме GET и HEAD.
+    std::string body_;                                  // Буфер для формирования тела ответа.
+    std::map<std::string, std::int64_t> totals_;        // Накопленные значения Counter.
+    std::map<std::string, HistogramValue> histograms_;  // Накопленные значения Histogram.
+    std::vector<std::shared_ptr<const Snapshot>> rendering_; // Снимки, забранные из pending_.
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::thread thread_;
+};
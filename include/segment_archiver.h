@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Фоновая обработка закрытых сегментов файла метрик после ротации:
+    сжатие в gzip и удаление старых сегментов сверх лимита хранения.
+    Работает в отдельном потоке с наименьшим приоритетом CPU и ввода-вывода,
+    поэтому поток записи метрик не платит за сжатие.
+
+    Сегмент — файл вида <base>.YYYYMMDDTHHMMSSZ[-N] (время ротации в UTC),
+    после сжатия — тот же файл с суффиксом .gz.
+*/
+class SegmentArchiver
+{
+public:
+    // base_filename — имя основного файла метрик; retention — сколько сегментов хранить (0 — без ограничения);
+    // compress — сжимать ли сегменты. Несжатые сегменты, оставшиеся от прошлых запусков, ставятся в очередь.
+    SegmentArchiver(const std::string &base_filename, unsigned retention, bool compress);
+
+    // Дожидается обработки всех поставленных в очередь сегментов и останавливает поток.
+    ~SegmentArchiver();
+
+    // Ставит закрытый сегмент в очередь на сжатие и применение лимита хранения.
+    void submit(const std::string &segment);
+
+    // Возвращает свободное имя сегмента для файла base_filename, закрытого в момент time.
+    static std::string segmentName(const std::string &base_filename, std::chrono::system_clock::time_point time);
+
+    // Возвращает существующие сегменты файла base_filename (сжатые и нет), от старых к новым.
+    static std::vector<std::string> listSegments(const std::string &base_filename);
+
+private:
+    void run();
+    void compress(const std::string &segment);
+    void applyRetention();
+
+    std::string base_filename_;
+    unsigned retention_;
+    bool compress_;
+    std::deque<std::string> pending_; // Сегменты, ожидающие обработки.
+    std::mutex mutex_;
+    std::condition_variable cond_var_;
+    bool stopped_ = false;
+    std::thread thread_;
+};
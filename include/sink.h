@@ -0,0 +1,47 @@
+#pragma once
+
+#include "snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+    Общие счетчики получателя для собственных метрик библиотеки (MetricsCollector::enableSelfMetrics).
+    Все значения, кроме queued, накапливаются с момента создания получателя.
+*/
+struct SinkStats
+{
+    std::size_t queued = 0;      // Снимки, ожидающие записи или отправки.
+    std::uint64_t bytes = 0;     // Записанные или отправленные байты.
+    std::uint64_t dropped = 0;   // Снимки, отброшенные получателем.
+    std::uint64_t errors = 0;    // Ошибки записи и отправки.
+    std::uint64_t writes = 0;    // Операции записи, длительность которых измерялась.
+    std::uint64_t write_ns = 0;  // Суммарная длительность этих операций, нс.
+};
+
+/*
+    Получатель снимков метрик (файл, сокет, память, пользовательский), подключаемый к MetricsCollector
+    (см. MetricsCollector::addSink). Файл метрик — тоже получатель (MetricsWriter).
+
+    publish() вызывается в потоке, вызвавшем MetricsCollector::collectAndWrite(), уже после
+    освобождения MetricsCollector::mutex_. Один и тот же снимок передается всем получателям
+    без копирования, поэтому он неизменяем. Реализация не должна блокироваться: долгое кодирование
+    и ввод-вывод выполняются в собственном потоке получателя.
+*/
+class Sink
+{
+public:
+    virtual ~Sink() = default;
+
+    // Передает получателю очередной снимок.
+    virtual void publish(std::shared_ptr<const Snapshot> snapshot) = 0;
+
+    // Биты encodingBit() общих представлений снимка, которые использует получатель.
+    // Представление, нужное нескольким получателям одного сборщика, кодируется один раз.
+    virtual std::uint32_t sharedEncodings() const { return 0; }
+
+    // Счетчики для собственных метрик библиотеки; вызывается раз в такт сбора, поэтому может
+    // брать мьютекс очереди. По умолчанию счетчиков нет.
+    virtual SinkStats sinkStats() const { return SinkStats(); }
+};
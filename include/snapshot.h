@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    Тип значения метрики в снимке. Определяет, как значение форматируется и кодируется.
+*/
+enum class MetricType : std::uint8_t
+{
+    Gauge = 0,   // Вещественное значение (MetricSample::gauge).
+    Counter = 1, // Целое значение за интервал сбора (MetricSample::counter).
+    Text = 2,    // Значение, уже представленное строкой (MetricSample::text), — для пользовательских метрик.
+    Histogram = 3 // Распределение значений за интервал сбора (MetricSample::histogram).
+};
+
+// Значение точности Gauge, при котором выводится кратчайшее представление, однозначно
+// восстанавливающее число (std::to_chars без precision), вместо фиксированного числа знаков.
+constexpr int kShortestPrecision = -1;
+
+/*
+    Значение гистограммы за интервал сбора: bounds.size() + 1 корзин с явными границами.
+    Корзина i содержит значения из (bounds[i - 1], bounds[i]], последняя — больше bounds.back().
+    Счетчики не накопительные (как в OTLP); Prometheus-экспорт суммирует их сам.
+*/
+struct HistogramValue
+{
+    std::shared_ptr<const std::vector<double>> bounds; // Возрастающие границы корзин (общие для всех снимков метрики).
+    std::vector<std::uint64_t> counts;                 // Количество значений в каждой корзине.
+    std::uint64_t count = 0;                           // Общее количество значений.
+    double sum = 0.0;                                  // Сумма значений.
+};
+
+/*
+    Значение одной метрики, снятое при сборе.
+*/
+struct MetricSample
+{
+    std::string name;                     // Имя метрики.
+    MetricType type = MetricType::Text;   // Какое из полей ниже содержит значение.
+    double gauge = 0.0;                   // Значение метрики типа Gauge.
+    int precision = 2;                    // Знаков после запятой для Gauge в текстовом формате или kShortestPrecision.
+    std::int64_t counter = 0;             // Значение метрики типа Counter.
+    std::string text;                     // Значение метрики типа Text.
+    HistogramValue histogram;             // Значение метрики типа Histogram.
+};
+
+/*
+    Представления снимка, которые не зависят от состояния и настроек получателя,
+    поэтому могут быть закодированы один раз и использованы всеми получателями снимка.
+*/
+enum class SharedEncoding : std::uint8_t
+{
+    TextFields = 0, // " \"Name\" value" для каждой метрики (текстовый формат без метки времени).
+    CsvFields,      // ",value" для каждой метрики (строка Csv без метки времени).
+    TsvFields,      // "\tvalue" для каждой метрики (строка Tsv без метки времени).
+    InfluxFields,   // "name=value,..." (поля строки InfluxDB line protocol).
+    Count
+};
+
+// Бит представления encoding в масках Snapshot::shared_encodings и Sink::sharedEncodings().
+constexpr std::uint32_t encodingBit(SharedEncoding encoding) {
+    return 1u << static_cast<unsigned>(encoding);
+}
+
+/*
+    Кэш общих представлений снимка. Каждое представление вычисляется не более одного раза,
+    в том числе при одновременном обращении из потоков разных получателей.
+    При копировании снимка кэш не копируется.
+*/
+class EncodingCache
+{
+public:
+    EncodingCache() = default;
+    EncodingCache(const EncodingCache &) {}
+    EncodingCache &operator=(const EncodingCache &) { return *this; }
+
+    // Возвращает представление encoding, при первом обращении построенное функцией build(std::string &).
+    template <typename Build>
+    const std::string &get(SharedEncoding encoding, Build &&build) const {
+        Slot &slot = slots_[static_cast<std::size_t>(encoding)];
+        std::call_once(slot.once, [&] { build(slot.data); });
+        return slot.data;
+    }
+
+private:
+    struct Slot
+    {
+        std::once_flag once;
+        std::string data;
+    };
+    mutable std::array<Slot, static_cast<std::size_t>(SharedEncoding::Count)> slots_;
+};
+
+/*
+    Снимок всех метрик сборщика за один вызов collectAndWrite().
+
+    Сборщик передает один и тот же неизменяемый снимок (std::shared_ptr<const Snapshot>)
+    файлу и всем получателям без копирования. Общие представления (SharedEncoding), нужные
+    нескольким получателям, кодируются один раз и разделяются между ними.
+*/
+struct Snapshot
+{
+    std::vector<MetricSample> samples; // Значения метрик в порядке их регистрации.
+    std::chrono::system_clock::time_point captured_at{};        // Время сбора значений (пишется в вывод).
+    std::chrono::steady_clock::time_point captured_steady{};    // То же по монотонным часам (для задержек).
+    std::uint32_t shared_encodings = 0; // Биты encodingBit() представлений, нужных нескольким получателям
+                                        // (заполняет MetricsCollector).
+
+    // Задано ли время сбора (MetricsCollector и MetricsWriter::write задают его всегда).
+    bool captured() const { return captured_steady != std::chrono::steady_clock::time_point(); }
+
+    // Время сбора или now для снимка, собранного без времени.
+    std::chrono::system_clock::time_point captureTime(std::chrono::system_clock::time_point now) const {
+        return captured() ? captured_at : now;
+    }
+
+    // Дописывает в out представление encoding, которое строит build(std::string &). Если оно нужно
+    // нескольким получателям, оно кодируется один раз и копируется из кэша, иначе строится сразу в out.
+    template <typename Build>
+    void appendShared(std::string &out, SharedEncoding encoding, Build &&build) const {
+        if ((shared_encodings & encodingBit(encoding)) != 0) {
+            out += cache_.get(encoding, build);
+        } else {
+            build(out);
+        }
+    }
+
+private:
+    EncodingCache cache_;
+};
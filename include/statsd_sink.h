@@ -0,0 +1,113 @@
+#pragma once
+
+#include "sink.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+/*
+    Параметры StatsdSink.
+*/
+struct StatsdOptions
+{
+    std::string host = "127.0.0.1";     // Адрес агента StatsD (имя или IPv4/IPv6).
+    std::uint16_t port = 8125;          // UDP-порт агента.
+    std::string prefix;                 // Префикс имен метрик (например, "app.").
+    std::vector<std::string> tags;      // Теги DogStatsD (вида "env:prod"); пусто — обычный StatsD.
+    std::size_t max_datagram = 1432;    // Максимальный размер датаграммы: MTU 1500 минус заголовки IPv4/UDP с запасом.
+    std::size_t queue_limit = 64;       // Сколько снимков может ждать отправки; более новые отбрасываются.
+};
+
+/*
+    Статистика StatsdSink.
+*/
+struct StatsdStats
+{
+    std::uint64_t snapshots = 0;         // Отправленные снимки.
+    std::uint64_t dropped_snapshots = 0; // Снимки, отброшенные из-за переполнения очереди.
+    std::uint64_t datagrams = 0;         // Отправленные датаграммы.
+    std::uint64_t dropped_datagrams = 0; // Датаграммы, отброшенные из-за EAGAIN или ошибки отправки.
+    std::uint64_t bytes = 0;             // Отправленные байты.
+    std::uint64_t send_calls = 0;        // Вызовы sendmmsg.
+    std::uint64_t oversized_lines = 0;   // Строки длиннее max_datagram (не отправляются).
+};
+
+/*
+    Отправка снимков метрик строками StatsD/DogStatsD по UDP.
+
+    Строки (name:value|g для Gauge, name:value|c для Counter, числовые Text — как gauge)
+    упаковываются в датаграммы не больше max_datagram, разделяясь '\n', и все датаграммы
+    снимка отправляются одним вызовом sendmmsg. Кодирование и отправка выполняются
+    в собственном потоке; publish() только ставит указатель на снимок в ограниченную очередь.
+    Сокет неблокирующий: при EAGAIN оставшиеся датаграммы отбрасываются и учитываются
+    в статистике, поэтому отправка никогда не задерживает сборщик.
+
+    Отрицательный gauge отправляется парой строк name:0|g и name:-X|g в одной датаграмме:
+    значение со знаком StatsD понимает как изменение. NaN и бесконечности не отправляются.
+*/
+class StatsdSink : public Sink
+{
+public:
+    // Разрешает адрес и создает сокет; при ошибке бросает std::runtime_error.
+    explicit StatsdSink(const StatsdOptions &options = StatsdOptions());
+
+    // Отправляет снимки, оставшиеся в очереди, и останавливает поток.
+    ~StatsdSink() override;
+
+    StatsdSink(const StatsdSink &) = delete;
+    StatsdSink &operator=(const StatsdSink &) = delete;
+
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
+
+    // Возвращает счетчики отправки.
+    StatsdStats getStats() const;
+
+    // Очередь, отправленные байты, отброшенные снимки; ошибками считаются отброшенные датаграммы.
+    SinkStats sinkStats() const override;
+
+private:
+    void run();
+
+    // Упаковывает строки снимка в датаграммы packets_.
+    void encode(const Snapshot &snapshot);
+
+    // Отправляет датаграммы packets_ пачками sendmmsg.
+    void send();
+
+    StatsdOptions options_;
+    int fd_ = -1;
+    std::string suffix_tags_;   // "|#tag1,tag2" для DogStatsD или пусто.
+
+    std::deque<std::shared_ptr<const Snapshot>> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_var_;
+    bool stopped_ = false;
+
+    // Буферы потока отправки (переиспользуются между снимками).
+    std::string packets_;                    // Датаграммы подряд.
+    std::vector<std::size_t> boundaries_;    // Концы датаграмм в packets_.
+    std::string line_;                       // Текущая строка.
+    std::vector<struct iovec> iovecs_;
+    std::vector<struct mmsghdr> messages_;
+
+    std::atomic<std::uint64_t> snapshots_{0};
+    std::atomic<std::uint64_t> dropped_snapshots_{0};
+    std::atomic<std::uint64_t> datagrams_{0};
+    std::atomic<std::uint64_t> dropped_datagrams_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> send_calls_{0};
+    std::atomic<std::uint64_t> oversized_lines_{0};
+    int last_error_ = 0;        // Последняя записанная в журнал ошибка отправки (чтобы не повторять ее).
+
+    std::thread thread_;
+};
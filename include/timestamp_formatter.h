@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+    Форматирование меток времени вида YYYY-MM-DD HH:MM:SS.mmm без localtime и put_time на каждый вызов.
+    Строка до секунд рендерится один раз на секунду и кэшируется, для остальных вызовов
+    в той же секунде дописываются только миллисекунды целочисленной арифметикой.
+    Для локального времени смещение от UTC запрашивается через localtime_r не чаще раза
+    в 15 минут (переходы на летнее время происходят на границах 15-минутных интервалов).
+
+    Экземпляр не потокобезопасен: каждый поток записи использует свой форматтер.
+*/
+class TimestampFormatter
+{
+public:
+    // Часовой пояс меток времени.
+    enum class Zone
+    {
+        Local, // Локальное время процесса (TZ).
+        Utc    // Всемирное координированное время.
+    };
+
+    // Длина метки времени YYYY-MM-DD HH:MM:SS.mmm.
+    static constexpr std::size_t kLength = 23;
+
+    // Длина части метки до секунд включительно (YYYY-MM-DD HH:MM:SS).
+    static constexpr std::size_t kSecondsLength = 19;
+
+    explicit TimestampFormatter(Zone zone = Zone::Local);
+
+    // Записывает kLength символов метки времени в out (без завершающего нуля).
+    void format(std::int64_t epoch_ms, char *out);
+
+    // Записывает kLength символов метки времени в out (без завершающего нуля).
+    void format(std::chrono::system_clock::time_point time, char *out);
+
+    // Дописывает метку времени в конец строки.
+    void append(std::chrono::system_clock::time_point time, std::string &out);
+
+    Zone zone() const { return zone_; }
+
+private:
+    // Рендерит YYYY-MM-DD HH:MM:SS. для секунды epoch_seconds в prefix_.
+    void renderSecond(std::int64_t epoch_seconds);
+
+    Zone zone_;
+    std::int64_t cached_second_;      // Секунда, для которой построен prefix_.
+    char prefix_[kSecondsLength + 1]; // YYYY-MM-DD HH:MM:SS.
+    std::int64_t offset_seconds_ = 0; // Смещение локального времени от UTC.
+    std::int64_t offset_window_;      // 15-минутный интервал, для которого вычислено offset_seconds_.
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "encoder.h"
+#include "sink.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+    Параметры UnixSocketSink.
+*/
+struct UnixSocketOptions
+{
+    std::string path = "metrics.sock";                 // Путь потокового Unix-сокета локального агента.
+    std::size_t queue_limit = 1024;                    // Сколько снимков может ждать отправки; более новые отбрасываются.
+    std::chrono::milliseconds reconnect_delay{1000};   // Пауза перед повторным подключением.
+};
+
+/*
+    Статистика UnixSocketSink.
+*/
+struct UnixSocketStats
+{
+    std::uint64_t snapshots = 0;         // Отправленные снимки.
+    std::uint64_t dropped_snapshots = 0; // Снимки, отброшенные из-за переполнения очереди или отсутствия соединения.
+    std::uint64_t bytes = 0;             // Отправленные байты.
+    std::uint64_t connects = 0;          // Успешные подключения.
+    std::uint64_t errors = 0;            // Ошибки подключения и отправки.
+};
+
+/*
+    Передача снимков, закодированных любым кодировщиком (Encoder), в потоковый Unix-сокет
+    локального агента или коллектора (например, кадры OtlpEncoder).
+
+    publish() только ставит указатель на снимок в ограниченную очередь. Поток отправки забирает
+    все накопившиеся снимки, кодирует их в переиспользуемый буфер и отправляет одним send().
+    После каждого подключения кодировщик начинает поток заново (Encoder::begin с new_file),
+    поэтому получатель всегда видит заголовки формата. Пока соединения нет, снимки отбрасываются
+    с учетом в статистике, а подключение повторяется не чаще reconnect_delay.
+*/
+class UnixSocketSink : public Sink
+{
+public:
+    // Подключается к сокету; недоступный сокет не является ошибкой. encoder == nullptr — текстовый формат.
+    explicit UnixSocketSink(const UnixSocketOptions &options, std::unique_ptr<Encoder> encoder = nullptr);
+
+    // Отправляет оставшиеся снимки и останавливает поток.
+    ~UnixSocketSink() override;
+
+    UnixSocketSink(const UnixSocketSink &) = delete;
+    UnixSocketSink &operator=(const UnixSocketSink &) = delete;
+
+    void publish(std::shared_ptr<const Snapshot> snapshot) override;
+    std::uint32_t sharedEncodings() const override { return encoder_->sharedEncodings(); }
+
+    // Дожидается отправки всех ранее переданных снимков.
+    void flush();
+
+    UnixSocketStats getStats() const;
+
+    // Очередь, отправленные байты, отброшенные снимки и ошибки.
+    SinkStats sinkStats() const override;
+
+private:
+    void run();
+    bool connect();
+    bool sendAll(const char *data, std::size_t size);
+
+    UnixSocketOptions options_;
+    std::unique_ptr<Encoder> encoder_;
+    int fd_ = -1;
+    std::chrono::steady_clock::time_point next_connect_;
+
+    std::deque<std::shared_ptr<const Snapshot>> queue_; // nullptr — маркер flush().
+    mutable std::mutex mutex_;
+    std::condition_variable cond_var_;
+    bool stopped_ = false;
+    std::uint64_t flush_requested_ = 0; // Номер последнего запроса flush().
+    std::uint64_t flush_done_ = 0;      // Номер последнего выполненного запроса flush().
+    std::condition_variable flush_cv_;
+
+    // Буферы потока отправки (переиспользуются).
+    std::deque<std::shared_ptr<const Snapshot>> sending_; // Снимки, забранные из queue_.
+    std::string buffer_;
+
+    std::atomic<std::uint64_t> snapshots_{0};
+    std::atomic<std::uint64_t> dropped_snapshots_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> connects_{0};
+    std::atomic<std::uint64_t> errors_{0};
+
+    std::thread thread_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+    Форматирование значений метрик без std::stringstream и временных строк.
+    Числа выводятся std::to_chars во внешний буфер или в конец строки вывода,
+    поэтому при достаточной емкости строки форматирование не выделяет память.
+*/
+
+// Размер буфера, достаточный для formatGauge и formatCounter.
+constexpr std::size_t kMaxValueLength = 64;
+
+// Наибольшая поддерживаемая точность фиксированного формата.
+constexpr int kMaxGaugePrecision = 17;
+
+// Записывает value с precision знаками после запятой (или кратчайшее представление при
+// kShortestPrecision) в out размером не меньше kMaxValueLength. Если число в фиксированном
+// формате не помещается в буфер, выводится кратчайшее представление. Возвращает длину.
+std::size_t formatGauge(double value, int precision, char *out);
+
+// Записывает целое value в out размером не меньше kMaxValueLength. Возвращает длину.
+std::size_t formatCounter(std::int64_t value, char *out);
+
+// Дописывает значение Gauge в конец out.
+void appendGauge(std::string &out, double value, int precision);
+
+// Дописывает значение Counter в конец out.
+void appendCounter(std::string &out, std::int64_t value);
+
+// Дописывает значение гистограммы без пробелов и запятых: count=N;sum=S;граница:число;...;+Inf:число.
+void appendHistogram(std::string &out, const HistogramValue &histogram);
+
+// Дописывает значение sample в текстовом виде в зависимости от его типа.
+void appendValue(std::string &out, const MetricSample &sample);
+
+// Дописывает поле строки Csv (delimiter ',') или Tsv (delimiter '\t').
+// Csv: поле с разделителем, кавычкой или переводом строки заключается в кавычки, кавычки удваиваются (RFC 4180).
+// Tsv: табуляция, перевод строки, возврат каретки и обратная косая черта экранируются как \t, \n, \r, \\.
+void appendDelimitedField(std::string &out, const std::string &field, char delimiter);
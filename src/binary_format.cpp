@@ -0,0 +1,630 @@
+#include "binary_format.h"
+#include "value_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Запись битового потока старшими битами вперед
+class BitWriter
+{
+public:
+    explicit BitWriter(std::string &out) : out_(out) {}
+
+    void write(std::uint64_t value, unsigned bits) {
+        while (bits > 0) {
+            if (used_ == 0) {
+                out_.push_back('\0');
+            }
+            unsigned free = 8 - used_;
+            unsigned take = std::min(free, bits);
+            unsigned chunk = static_cast<unsigned>((value >> (bits - take)) & ((1u << take) - 1));
+            out_.back() = static_cast<char>(static_cast<unsigned char>(out_.back()) | (chunk << (free - take)));
+            used_ = (used_ + take) % 8;
+            bits -= take;
+        }
+    }
+
+    void writeVarint(std::uint64_t value) {
+        while (value >= 0x80) {
+            write((value & 0x7F) | 0x80, 8);
+            value >>= 7;
+        }
+        write(value, 8);
+    }
+
+private:
+    std::string &out_;
+    unsigned used_ = 0; // Занятые биты в последнем байте.
+};
+
+// Чтение битового потока, записанного BitWriter
+class BitReader
+{
+public:
+    BitReader(const unsigned char *data, std::size_t size) : data_(data), bits_(size * 8) {}
+
+    bool read(unsigned bits, std::uint64_t &value) {
+        if (position_ + bits > bits_) {
+            return false;
+        }
+        value = 0;
+        while (bits > 0) {
+            unsigned used = position_ % 8;
+            unsigned take = std::min(8 - used, bits);
+            unsigned byte = data_[position_ / 8];
+            value = (value << take) | ((byte >> (8 - used - take)) & ((1u << take) - 1));
+            position_ += take;
+            bits -= take;
+        }
+        return true;
+    }
+
+    bool readBit(bool &bit) {
+        std::uint64_t value;
+        if (!read(1, value)) {
+            return false;
+        }
+        bit = value != 0;
+        return true;
+    }
+
+    bool readVarint(std::uint64_t &value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            std::uint64_t byte;
+            if (!read(8, byte)) {
+                return false;
+            }
+            value |= (byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const unsigned char *data_;
+    std::size_t bits_;
+    std::size_t position_ = 0;
+};
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::uint64_t doubleBits(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(std::uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Расширяет знак числа из bits бит
+std::int64_t signExtend(std::uint64_t value, unsigned bits) {
+    std::uint64_t sign = std::uint64_t(1) << (bits - 1);
+    return static_cast<std::int64_t>((value ^ sign) - sign);
+}
+
+void appendVarint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void appendInt64(std::string &out, std::int64_t value) {
+    std::uint64_t bits = static_cast<std::uint64_t>(value);
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(bits >> (i * 8)));
+    }
+}
+
+std::int64_t readInt64(const char *data) {
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (i * 8);
+    }
+    return static_cast<std::int64_t>(bits);
+}
+
+// Delta-of-delta меток времени: 0 | 10+7 бит | 110+9 бит | 1110+12 бит | 1111+64 бита
+void encodeTimestamps(const std::vector<std::int64_t> &timestamps, BitWriter &bits) {
+    std::int64_t prev_delta = 0;
+    for (std::size_t i = 1; i < timestamps.size(); ++i) {
+        std::int64_t delta = timestamps[i] - timestamps[i - 1];
+        std::int64_t dod = delta - prev_delta;
+        prev_delta = delta;
+        if (dod == 0) {
+            bits.write(0, 1);
+        } else if (dod >= -64 && dod <= 63) {
+            bits.write(0b10, 2);
+            bits.write(static_cast<std::uint64_t>(dod) & 0x7F, 7);
+        } else if (dod >= -256 && dod <= 255) {
+            bits.write(0b110, 3);
+            bits.write(static_cast<std::uint64_t>(dod) & 0x1FF, 9);
+        } else if (dod >= -2048 && dod <= 2047) {
+            bits.write(0b1110, 4);
+            bits.write(static_cast<std::uint64_t>(dod) & 0xFFF, 12);
+        } else {
+            bits.write(0b1111, 4);
+            bits.write(static_cast<std::uint64_t>(dod), 64);
+        }
+    }
+}
+
+bool decodeTimestamps(BitReader &bits, std::uint64_t rows, std::int64_t first_ts, std::vector<std::int64_t> &out) {
+    out.clear();
+    if (rows == 0) {
+        return true;
+    }
+    out.push_back(first_ts);
+    std::int64_t prev_delta = 0;
+    for (std::uint64_t i = 1; i < rows; ++i) {
+        unsigned prefix = 0;
+        bool bit = true;
+        while (prefix < 4) {
+            if (!bits.readBit(bit)) {
+                return false;
+            }
+            if (!bit) {
+                break;
+            }
+            ++prefix;
+        }
+        static const unsigned kWidths[] = {0, 7, 9, 12, 64};
+        std::int64_t dod = 0;
+        if (prefix > 0) {
+            std::uint64_t value;
+            if (!bits.read(kWidths[prefix], value)) {
+                return false;
+            }
+            dod = signExtend(value, kWidths[prefix]);
+        }
+        prev_delta += dod;
+        out.push_back(out.back() + prev_delta);
+    }
+    return true;
+}
+
+// Степени 10 для масштабирования Gauge с фиксированной точностью (все представимы в double точно)
+constexpr double kPowersOf10[kMaxGaugePrecision + 1] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,
+                                                        1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17};
+
+// Можно ли хранить значения целыми value × 10^precision: по модулю до 2^53 целые точны в double
+bool scalable(const std::vector<double> &values, int precision) {
+    if (precision < 0 || precision > kMaxGaugePrecision) {
+        return false;
+    }
+    const double limit = 9007199254740992.0;
+    return std::all_of(values.begin(), values.end(), [scale = kPowersOf10[precision], limit](double value) {
+        return std::isfinite(value) && std::fabs(value * scale) < limit;
+    });
+}
+
+// Значения с фиксированной точностью: целые value × 10^precision, delta-of-delta в zigzag varint.
+// Ряд, меняющийся на постоянный шаг, занимает по байту на значение
+void encodeScaledGauges(const std::vector<double> &values, int precision, BitWriter &bits) {
+    const double scale = kPowersOf10[precision];
+    std::int64_t prev = 0;
+    std::int64_t prev_delta = 0;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        std::int64_t current = std::llround(values[i] * scale);
+        std::int64_t delta = current - prev;
+        bits.writeVarint(zigzag(i == 0 ? current : delta - prev_delta));
+        prev_delta = i == 0 ? 0 : delta;
+        prev = current;
+    }
+}
+
+bool decodeScaledGauges(BitReader &bits, std::uint64_t rows, int precision, std::vector<double> &out) {
+    const double scale = kPowersOf10[precision];
+    std::int64_t value = 0;
+    std::int64_t delta = 0;
+    for (std::uint64_t i = 0; i < rows; ++i) {
+        std::uint64_t encoded;
+        if (!bits.readVarint(encoded)) {
+            return false;
+        }
+        if (i == 0) {
+            value = unzigzag(encoded);
+        } else {
+            delta += unzigzag(encoded);
+            value += delta;
+        }
+        out.push_back(static_cast<double>(value) / scale);
+    }
+    return true;
+}
+
+// XOR-сжатие Gorilla для вещественных значений
+void encodeXorGauges(const std::vector<double> &values, BitWriter &bits) {
+    if (values.empty()) {
+        return;
+    }
+    std::uint64_t prev = doubleBits(values[0]);
+    bits.write(prev, 64);
+    int prev_leading = -1;
+    int prev_trailing = 0;
+    for (std::size_t i = 1; i < values.size(); ++i) {
+        std::uint64_t current = doubleBits(values[i]);
+        std::uint64_t x = current ^ prev;
+        prev = current;
+        if (x == 0) {
+            bits.write(0, 1);
+            continue;
+        }
+        int leading = std::min(__builtin_clzll(x), 31);
+        int trailing = __builtin_ctzll(x);
+        if (prev_leading >= 0 && leading >= prev_leading && trailing >= prev_trailing) {
+            // Значащие биты помещаются в окно предыдущего значения
+            bits.write(0b10, 2);
+            bits.write(x >> prev_trailing, static_cast<unsigned>(64 - prev_leading - prev_trailing));
+            continue;
+        }
+        int meaningful = 64 - leading - trailing;
+        bits.write(0b11, 2);
+        bits.write(static_cast<std::uint64_t>(leading), 5);
+        bits.write(static_cast<std::uint64_t>(meaningful - 1), 6);
+        bits.write(x >> trailing, static_cast<unsigned>(meaningful));
+        prev_leading = leading;
+        prev_trailing = trailing;
+    }
+}
+
+bool decodeXorGauges(BitReader &bits, std::uint64_t rows, std::vector<double> &out) {
+    if (rows == 0) {
+        return true;
+    }
+    std::uint64_t prev;
+    if (!bits.read(64, prev)) {
+        return false;
+    }
+    out.push_back(bitsDouble(prev));
+    int leading = 0;
+    int trailing = 0;
+    for (std::uint64_t i = 1; i < rows; ++i) {
+        bool changed;
+        if (!bits.readBit(changed)) {
+            return false;
+        }
+        if (changed) {
+            bool new_window;
+            if (!bits.readBit(new_window)) {
+                return false;
+            }
+            if (new_window) {
+                std::uint64_t lead, length;
+                if (!bits.read(5, lead) || !bits.read(6, length)) {
+                    return false;
+                }
+                leading = static_cast<int>(lead);
+                trailing = 64 - leading - static_cast<int>(length + 1);
+                if (trailing < 0) {
+                    return false;
+                }
+            }
+            std::uint64_t meaningful;
+            if (!bits.read(static_cast<unsigned>(64 - leading - trailing), meaningful)) {
+                return false;
+            }
+            prev ^= meaningful << trailing;
+        }
+        out.push_back(bitsDouble(prev));
+    }
+    return true;
+}
+
+// Колонка Gauge: режим (0 — XOR, p + 1 — целые с точностью p) и значения
+void encodeGauges(const std::vector<double> &values, int precision, BitWriter &bits) {
+    if (scalable(values, precision)) {
+        bits.writeVarint(static_cast<std::uint64_t>(precision) + 1);
+        encodeScaledGauges(values, precision, bits);
+    } else {
+        bits.writeVarint(0);
+        encodeXorGauges(values, bits);
+    }
+}
+
+bool decodeGauges(BitReader &bits, std::uint64_t rows, std::vector<double> &out, int &precision) {
+    out.clear();
+    std::uint64_t mode;
+    if (!bits.readVarint(mode) || mode > static_cast<std::uint64_t>(kMaxGaugePrecision) + 1) {
+        return false;
+    }
+    precision = static_cast<int>(mode) - 1;
+    return mode == 0 ? decodeXorGauges(bits, rows, out) : decodeScaledGauges(bits, rows, precision, out);
+}
+
+// Тип колонки для значений sample: гистограмма хранится текстом (appendHistogram)
+MetricType columnType(MetricType type) {
+    return type == MetricType::Histogram ? MetricType::Text : type;
+}
+
+} // namespace
+
+// ================= BinaryEncoder =================
+BinaryEncoder::BinaryEncoder(std::size_t block_rows) : block_rows_(std::max<std::size_t>(block_rows, 1)) {}
+
+void BinaryEncoder::begin(std::string &out, bool new_file) {
+    if (new_file) {
+        out.append(kBinaryMagic, sizeof(kBinaryMagic));
+    }
+    dictionary_written_ = false;
+}
+
+bool BinaryEncoder::matchesDictionary(const Snapshot &snapshot) const {
+    if (snapshot.samples.size() != columns_.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+        if (columnType(snapshot.samples[i].type) != columns_[i].type || snapshot.samples[i].name != columns_[i].name) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BinaryEncoder::writeDictionary(std::string &out) {
+    out.push_back(kBinaryDictionaryTag);
+    appendVarint(out, columns_.size());
+    for (const auto &column : columns_) {
+        appendVarint(out, column.name.size());
+        out += column.name;
+        out.push_back(static_cast<char>(column.type));
+    }
+    dictionary_written_ = true;
+}
+
+void BinaryEncoder::add(const Snapshot &snapshot, std::int64_t timestamp_ms, std::string &out) {
+    if (!dictionary_written_ || !matchesDictionary(snapshot)) {
+        finishBlock(out);
+        columns_.clear();
+        columns_.resize(snapshot.samples.size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            columns_[i].name = snapshot.samples[i].name;
+            columns_[i].type = columnType(snapshot.samples[i].type);
+        }
+        writeDictionary(out);
+    }
+
+    timestamps_.push_back(timestamp_ms);
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+        const MetricSample &sample = snapshot.samples[i];
+        switch (sample.type) {
+        case MetricType::Gauge:
+            // Точность в блоке одна на колонку; если она меняется, значения хранятся XOR
+            if (columns_[i].gauges.empty()) {
+                columns_[i].precision = sample.precision;
+            } else if (columns_[i].precision != sample.precision) {
+                columns_[i].precision = kShortestPrecision;
+            }
+            columns_[i].gauges.push_back(sample.gauge);
+            break;
+        case MetricType::Counter:
+            columns_[i].counters.push_back(sample.counter);
+            break;
+        case MetricType::Text:
+            columns_[i].texts.push_back(sample.text);
+            break;
+        case MetricType::Histogram:
+            columns_[i].texts.emplace_back();
+            appendHistogram(columns_[i].texts.back(), sample.histogram);
+            break;
+        }
+    }
+    if (timestamps_.size() >= block_rows_) {
+        finishBlock(out);
+    }
+}
+
+void BinaryEncoder::encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) {
+    add(snapshot, std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count(), out);
+}
+
+void BinaryEncoder::finishBlock(std::string &out) {
+    if (timestamps_.empty()) {
+        return;
+    }
+    block_.clear();
+    appendVarint(block_, timestamps_.size());
+    appendInt64(block_, timestamps_.front());
+    appendInt64(block_, timestamps_.back());
+
+    BitWriter bits(block_);
+    encodeTimestamps(timestamps_, bits);
+    for (auto &column : columns_) {
+        switch (column.type) {
+        case MetricType::Gauge:
+            encodeGauges(column.gauges, column.precision, bits);
+            break;
+        case MetricType::Counter: {
+            std::int64_t prev = 0;
+            for (std::int64_t value : column.counters) {
+                bits.writeVarint(zigzag(value - prev));
+                prev = value;
+            }
+            break;
+        }
+        case MetricType::Text:
+        case MetricType::Histogram:
+            for (const auto &text : column.texts) {
+                bits.writeVarint(text.size());
+                for (char c : text) {
+                    bits.write(static_cast<unsigned char>(c), 8);
+                }
+            }
+            break;
+        }
+        column.gauges.clear();
+        column.counters.clear();
+        column.texts.clear();
+    }
+    timestamps_.clear();
+
+    out.push_back(kBinaryBlockTag);
+    appendVarint(out, block_.size());
+    out += block_;
+}
+
+// ================= BinaryDecoder =================
+BinaryDecoder::BinaryDecoder(const char *data, std::size_t size) : data_(data), size_(size) {
+    if (hasMagic(data_, size_)) {
+        offset_ = sizeof(kBinaryMagic);
+    }
+}
+
+bool BinaryDecoder::hasMagic(const char *data, std::size_t size) {
+    return size >= sizeof(kBinaryMagic) && std::memcmp(data, kBinaryMagic, sizeof(kBinaryMagic)) == 0;
+}
+
+bool BinaryDecoder::readVarint(const char *data, std::size_t size, std::size_t &offset, std::uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && offset < size; shift += 7) {
+        auto byte = static_cast<unsigned char>(data[offset++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryDecoder::readDictionary(const char *data, std::size_t size, std::size_t &offset,
+                                   std::vector<BinaryColumn> &dictionary) {
+    std::uint64_t count;
+    if (!readVarint(data, size, offset, count) || count > size) {
+        return false;
+    }
+    dictionary.clear();
+    dictionary.resize(count);
+    for (auto &column : dictionary) {
+        std::uint64_t length;
+        if (!readVarint(data, size, offset, length) || length + 1 > size - offset) {
+            return false;
+        }
+        column.name.assign(data + offset, length);
+        offset += length;
+        auto type = static_cast<std::uint8_t>(data[offset++]);
+        if (type > static_cast<std::uint8_t>(MetricType::Text)) {
+            return false;
+        }
+        column.type = static_cast<MetricType>(type);
+    }
+    return true;
+}
+
+bool BinaryDecoder::readBlockHeader(const char *payload, std::size_t size, std::uint64_t &rows,
+                                    std::int64_t &first_ts, std::int64_t &last_ts) {
+    std::size_t offset = 0;
+    if (!readVarint(payload, size, offset, rows) || size - offset < 16) {
+        return false;
+    }
+    first_ts = readInt64(payload + offset);
+    last_ts = readInt64(payload + offset + 8);
+    return true;
+}
+
+bool BinaryDecoder::decodeBlock(const char *payload, std::size_t size, const std::vector<BinaryColumn> &dictionary,
+                                BinaryBlock &block) {
+    std::uint64_t rows;
+    std::int64_t first_ts, last_ts;
+    if (!readBlockHeader(payload, size, rows, first_ts, last_ts)) {
+        return false;
+    }
+    std::size_t offset = 0;
+    readVarint(payload, size, offset, rows);
+    offset += 16;
+    if (rows > size * 8) {
+        return false;
+    }
+
+    BitReader bits(reinterpret_cast<const unsigned char *>(payload + offset), size - offset);
+    if (!decodeTimestamps(bits, rows, first_ts, block.timestamps)) {
+        return false;
+    }
+    block.columns.resize(dictionary.size());
+    for (std::size_t i = 0; i < dictionary.size(); ++i) {
+        BinaryColumn &column = block.columns[i];
+        column.name = dictionary[i].name;
+        column.type = dictionary[i].type;
+        column.gauges.clear();
+        column.counters.clear();
+        column.texts.clear();
+        switch (column.type) {
+        case MetricType::Gauge:
+            if (!decodeGauges(bits, rows, column.gauges, column.precision)) {
+                return false;
+            }
+            break;
+        case MetricType::Counter: {
+            std::int64_t prev = 0;
+            for (std::uint64_t row = 0; row < rows; ++row) {
+                std::uint64_t value;
+                if (!bits.readVarint(value)) {
+                    return false;
+                }
+                prev += unzigzag(value);
+                column.counters.push_back(prev);
+            }
+            break;
+        }
+        case MetricType::Text:
+        case MetricType::Histogram:
+            for (std::uint64_t row = 0; row < rows; ++row) {
+                std::uint64_t length;
+                if (!bits.readVarint(length) || length > size) {
+                    return false;
+                }
+                std::string text(length, '\0');
+                for (auto &c : text) {
+                    std::uint64_t byte;
+                    if (!bits.read(8, byte)) {
+                        return false;
+                    }
+                    c = static_cast<char>(byte);
+                }
+                column.texts.push_back(std::move(text));
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool BinaryDecoder::next(BinaryBlock &block) {
+    while (offset_ < size_ && !error_) {
+        char tag = data_[offset_];
+        std::size_t offset = offset_ + 1;
+        if (tag == kBinaryDictionaryTag) {
+            if (!readDictionary(data_, size_, offset, dictionary_)) {
+                error_ = true;
+                return false;
+            }
+            offset_ = offset;
+            continue;
+        }
+        std::uint64_t length;
+        if (tag != kBinaryBlockTag || !readVarint(data_, size_, offset, length) || length > size_ - offset ||
+            !decodeBlock(data_ + offset, length, dictionary_, block)) {
+            error_ = true;
+            return false;
+        }
+        offset_ = offset + length;
+        return true;
+    }
+    return false;
+}
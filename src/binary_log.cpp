@@ -0,0 +1,197 @@
+#include "binary_log.h"
+#include "logger.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace binary_log {
+
+namespace {
+
+// Место вызова, прочитанное из записи 'D'
+struct DecodedSite
+{
+    bool defined = false;
+    LogLevel level = LogLevel::Info;
+    std::string types;
+    std::string format;
+};
+
+const char *levelTag(std::uint8_t level) {
+    static const char *const kTags[] = {" [TRACE] ", " [DEBUG] ", " [INFO] ", " [WARN] ", " [ERROR] ", " [ERROR] "};
+    return level < sizeof(kTags) / sizeof(kTags[0]) ? kTags[level] : " [ERROR] ";
+}
+
+// Последовательное чтение полей записи с проверкой границ
+class FieldReader
+{
+public:
+    explicit FieldReader(const std::string &data) : data_(data) {}
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string_view readString() {
+        auto length = read<std::uint32_t>();
+        return std::string_view(take(length), length);
+    }
+
+private:
+    const char *take(std::size_t size) {
+        if (data_.size() - pos_ < size) {
+            throw std::runtime_error("Binary log record is truncated");
+        }
+        const char *data = data_.data() + pos_;
+        pos_ += size;
+        return data;
+    }
+
+    const std::string &data_;
+    std::size_t pos_ = 0;
+};
+
+// Читает ровно size байт
+void readExact(std::istream &in, std::string &buffer, std::size_t size) {
+    buffer.resize(size);
+    in.read(&buffer[0], static_cast<std::streamsize>(size));
+    if (static_cast<std::size_t>(in.gcount()) != size) {
+        throw std::runtime_error("Binary log is truncated");
+    }
+}
+
+// Подставляет аргументы записи в формат так же, как log_format::appendFormat
+void appendMessage(const DecodedSite &site, FieldReader &fields, std::string &out) {
+    const char *format = site.format.c_str();
+    std::size_t arg = 0;
+    for (; *format != '\0'; ++format) {
+        if (format[0] == '{' && format[1] == '}' && arg < site.types.size()) {
+            switch (site.types[arg++]) {
+            case 'b':
+                log_format::appendArg(out, fields.read<char>() != 0);
+                break;
+            case 'c':
+                log_format::appendArg(out, fields.read<char>());
+                break;
+            case 'i':
+                log_format::appendArg(out, fields.read<std::int64_t>());
+                break;
+            case 'u':
+                log_format::appendArg(out, fields.read<std::uint64_t>());
+                break;
+            case 'd':
+                log_format::appendArg(out, fields.read<double>());
+                break;
+            case 's':
+                log_format::appendArg(out, fields.readString());
+                break;
+            default:
+                throw std::runtime_error("Unknown binary log argument type");
+            }
+            ++format;
+            continue;
+        }
+        out += *format;
+        if ((format[0] == '{' && format[1] == '{') || (format[0] == '}' && format[1] == '}')) {
+            ++format;
+        }
+    }
+}
+
+} // namespace
+
+std::size_t decodeBinaryLog(std::istream &in, std::ostream &out) {
+    std::vector<DecodedSite> sites;
+    TimestampFormatter timestamps;
+    char timestamp[TimestampFormatter::kLength];
+    std::string buffer;
+    std::string line;
+    std::size_t lines = 0;
+    bool session = false;
+
+    auto beginLine = [&](std::uint64_t time_ns, const char *tag) {
+        auto time = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(time_ns)));
+        timestamps.format(time, timestamp);
+        line.assign(timestamp, TimestampFormatter::kSecondsLength);
+        line += tag;
+    };
+
+    char tag;
+    while (in.get(tag)) {
+        if (tag != kSessionTag && !session) {
+            throw std::runtime_error("Binary log does not start with a session header");
+        }
+        switch (tag) {
+        case kSessionTag:
+            readExact(in, buffer, sizeof(kMagic));
+            if (std::memcmp(buffer.data(), kMagic, sizeof(kMagic)) != 0) {
+                throw std::runtime_error("Bad binary log signature");
+            }
+            sites.clear();
+            session = true;
+            break;
+        case kSiteTag: {
+            readExact(in, buffer, 4 + 1 + 1);
+            FieldReader header(buffer);
+            auto id = header.read<std::uint32_t>();
+            auto level = header.read<std::uint8_t>();
+            auto count = header.read<std::uint8_t>();
+            if (id == 0) {
+                throw std::runtime_error("Bad binary log call site id");
+            }
+            if (sites.size() < id) {
+                sites.resize(id);
+            }
+            DecodedSite &site = sites[id - 1];
+            site.defined = true;
+            site.level = static_cast<LogLevel>(level);
+            readExact(in, site.types, count);
+            readExact(in, buffer, 4);
+            std::uint32_t length;
+            std::memcpy(&length, buffer.data(), sizeof(length));
+            readExact(in, site.format, length);
+            break;
+        }
+        case kRecordTag: {
+            readExact(in, buffer, 4);
+            std::uint32_t length;
+            std::memcpy(&length, buffer.data(), sizeof(length));
+            readExact(in, buffer, length);
+            FieldReader fields(buffer);
+            auto id = fields.read<std::uint32_t>();
+            auto time = fields.read<std::uint64_t>();
+            if (id == 0 || id > sites.size() || !sites[id - 1].defined) {
+                throw std::runtime_error("Binary log record refers to an unknown call site " + std::to_string(id));
+            }
+            const DecodedSite &site = sites[id - 1];
+            beginLine(time, levelTag(static_cast<std::uint8_t>(site.level)));
+            appendMessage(site, fields, line);
+            line += '\n';
+            out << line;
+            ++lines;
+            break;
+        }
+        case kDroppedTag: {
+            readExact(in, buffer, 16);
+            FieldReader fields(buffer);
+            auto time = fields.read<std::uint64_t>();
+            auto count = fields.read<std::uint64_t>();
+            beginLine(time, levelTag(static_cast<std::uint8_t>(LogLevel::Error)));
+            line += "Logger: " + std::to_string(count) + " records dropped (queue is full)\n";
+            out << line;
+            ++lines;
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown binary log record type");
+        }
+    }
+    return lines;
+}
+
+} // namespace binary_log
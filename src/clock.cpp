@@ -0,0 +1,54 @@
+#include "clock.h"
+
+#include <thread>
+
+namespace {
+
+class SystemClock : public Clock
+{
+public:
+    std::chrono::system_clock::time_point now() const override { return std::chrono::system_clock::now(); }
+
+    std::chrono::steady_clock::time_point steadyNow() const override { return std::chrono::steady_clock::now(); }
+
+    void sleepUntil(std::chrono::steady_clock::time_point deadline) override { std::this_thread::sleep_until(deadline); }
+};
+
+} // namespace
+
+// ================= Clock =================
+Clock &Clock::system() {
+    static SystemClock instance;
+    return instance;
+}
+
+// ================= VirtualClock =================
+VirtualClock::VirtualClock(std::chrono::system_clock::time_point start)
+    : now_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()) {}
+
+std::chrono::system_clock::time_point VirtualClock::now() const {
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::nanoseconds(now_ns_.load(std::memory_order_acquire))));
+}
+
+std::chrono::steady_clock::time_point VirtualClock::steadyNow() const {
+    return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::nanoseconds(now_ns_.load(std::memory_order_acquire))));
+}
+
+void VirtualClock::sleepUntil(std::chrono::steady_clock::time_point deadline) {
+    auto target = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    // Несколько спящих потоков сдвигают часы до наибольшего из своих сроков
+    std::int64_t current = now_ns_.load(std::memory_order_relaxed);
+    while (current < target &&
+           !now_ns_.compare_exchange_weak(current, target, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+    }
+}
+
+std::chrono::steady_clock::time_point VirtualClock::wakeTime(std::chrono::steady_clock::time_point /*deadline*/) const {
+    return std::chrono::steady_clock::time_point::max();
+}
+
+void VirtualClock::advance(std::chrono::nanoseconds duration) {
+    now_ns_.fetch_add(duration.count(), std::memory_order_acq_rel);
+}
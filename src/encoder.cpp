@@ -0,0 +1,89 @@
+#include "encoder.h"
+#include "binary_format.h"
+#include "value_format.h"
+
+// ================= TextEncoder =================
+TextEncoder::TextEncoder(TimestampFormatter::Zone zone) : timestamps_(zone) {}
+
+void TextEncoder::begin(std::string & /*out*/, bool /*new_file*/) {}
+
+void TextEncoder::encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) {
+    timestamps_.append(time, out);
+    snapshot.appendShared(out, SharedEncoding::TextFields, [&snapshot](std::string &fields) {
+        for (const auto &sample : snapshot.samples) {
+            fields += " \"";
+            fields += sample.name;
+            fields += "\" ";
+            appendValue(fields, sample);
+        }
+    });
+    out += '\n';
+}
+
+// ================= DelimitedEncoder =================
+DelimitedEncoder::DelimitedEncoder(char delimiter, TimestampFormatter::Zone zone)
+    : delimiter_(delimiter), timestamps_(zone) {}
+
+// Заголовок повторяется в начале каждого файла и сеанса записи
+void DelimitedEncoder::begin(std::string & /*out*/, bool /*new_file*/) {
+    header_.clear();
+}
+
+void DelimitedEncoder::encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) {
+    bool same_header = header_.size() == snapshot.samples.size();
+    for (std::size_t i = 0; same_header && i < header_.size(); ++i) {
+        same_header = header_[i] == snapshot.samples[i].name;
+    }
+    if (!same_header) {
+        header_.resize(snapshot.samples.size());
+        out += "timestamp";
+        for (std::size_t i = 0; i < snapshot.samples.size(); ++i) {
+            header_[i] = snapshot.samples[i].name;
+            out += delimiter_;
+            appendDelimitedField(out, header_[i], delimiter_);
+        }
+        out += '\n';
+    }
+
+    timestamps_.append(time, out);
+    const char delimiter = delimiter_;
+    auto build = [&snapshot, delimiter](std::string &fields) {
+        for (const auto &sample : snapshot.samples) {
+            fields += delimiter;
+            if (sample.type == MetricType::Text) {
+                appendDelimitedField(fields, sample.text, delimiter);
+            } else {
+                appendValue(fields, sample);
+            }
+        }
+    };
+    if (delimiter == ',' || delimiter == '\t') {
+        snapshot.appendShared(out, delimiter == ',' ? SharedEncoding::CsvFields : SharedEncoding::TsvFields, build);
+    } else {
+        // Поля с другим разделителем не совпадают с общими представлениями Csv/Tsv
+        build(out);
+    }
+    out += '\n';
+}
+
+std::uint32_t DelimitedEncoder::sharedEncodings() const {
+    if (delimiter_ == ',') {
+        return encodingBit(SharedEncoding::CsvFields);
+    }
+    return delimiter_ == '\t' ? encodingBit(SharedEncoding::TsvFields) : 0;
+}
+
+std::unique_ptr<Encoder> makeEncoder(OutputFormat format, bool utc_timestamps, std::size_t binary_block_rows) {
+    auto zone = utc_timestamps ? TimestampFormatter::Zone::Utc : TimestampFormatter::Zone::Local;
+    switch (format) {
+    case OutputFormat::Binary:
+        return std::make_unique<BinaryEncoder>(binary_block_rows);
+    case OutputFormat::Csv:
+        return std::make_unique<DelimitedEncoder>(',', zone);
+    case OutputFormat::Tsv:
+        return std::make_unique<DelimitedEncoder>('\t', zone);
+    case OutputFormat::Text:
+        break;
+    }
+    return std::make_unique<TextEncoder>(zone);
+}
@@ -0,0 +1,532 @@
+#include "file_backends.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// user_data для операций fdatasync (для записей это индекс буфера)
+constexpr std::uint64_t kSyncTag = ~std::uint64_t(0);
+
+int openForAppend(const std::string &filename, int flags) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file: " + filename + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+} // namespace
+
+// ================= PosixFileBackend =================
+PosixFileBackend::PosixFileBackend(const std::string &filename)
+    : filename_(filename), fd_(openForAppend(filename, O_APPEND)) {
+    off_t end = ::lseek(fd_, 0, SEEK_END);
+    size_ = end > 0 ? static_cast<std::uint64_t>(end) : 0;
+}
+
+PosixFileBackend::~PosixFileBackend() {
+    ::close(fd_);
+}
+
+std::size_t PosixFileBackend::append(const char *data, std::size_t size) {
+    const std::size_t accepted = size;
+    while (size > 0) {
+        ssize_t written = ::write(fd_, data, size);
+        write_calls_.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().logError("MetricsWriter: write to " + filename_ + " failed: " + std::strerror(errno));
+            break;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        size_ += static_cast<std::uint64_t>(written);
+    }
+    return accepted;
+}
+
+bool PosixFileBackend::sync() {
+    sync_calls_.fetch_add(1, std::memory_order_relaxed);
+    if (::fdatasync(fd_) != 0) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        Logger::getInstance().logError("MetricsWriter: fdatasync of " + filename_ + " failed: " + std::strerror(errno));
+    }
+    return true;
+}
+
+// ================= UringFileBackend =================
+UringFileBackend::UringFileBackend(const std::string &filename, std::size_t buffer_size, unsigned buffer_count)
+    : filename_(filename), fd_(openForAppend(filename, 0)), buffer_size_(buffer_size) {
+    off_t end = ::lseek(fd_, 0, SEEK_END);
+    file_offset_ = end > 0 ? static_cast<std::uint64_t>(end) : 0;
+
+    buffer_count = std::max(1u, buffer_count);
+    unsigned entries = 1;
+    while (entries < buffer_count * 2) {
+        entries <<= 1;
+    }
+    if (!setupRing(entries)) {
+        Logger::getInstance().logInfo("MetricsWriter: io_uring is unavailable (" + std::string(std::strerror(errno)) +
+                                      "), falling back to pwrite for " + filename_);
+        return;
+    }
+
+    arena_size_ = buffer_size_ * buffer_count;
+    arena_ = static_cast<char *>(std::aligned_alloc(4096, arena_size_));
+    slots_.resize(buffer_count);
+    std::vector<iovec> iovecs(buffer_count);
+    for (unsigned i = 0; i < buffer_count; ++i) {
+        slots_[i].data = arena_ + i * buffer_size_;
+        iovecs[i].iov_base = slots_[i].data;
+        iovecs[i].iov_len = buffer_size_;
+    }
+    if (arena_ == nullptr ||
+        ::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, iovecs.data(), buffer_count) < 0) {
+        Logger::getInstance().logInfo("MetricsWriter: io_uring buffer registration failed (" +
+                                      std::string(std::strerror(errno)) + "), falling back to pwrite for " + filename_);
+        teardownRing();
+    }
+}
+
+UringFileBackend::~UringFileBackend() {
+    drain();
+    teardownRing();
+    ::close(fd_);
+}
+
+bool UringFileBackend::setupRing(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+        return false;
+    }
+    ring_fd_ = ring_fd;
+    sq_entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        teardownRing();
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            teardownRing();
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        teardownRing();
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ring_);
+    char *cq = static_cast<char *>(cq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+}
+
+void UringFileBackend::teardownRing() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_ != nullptr) {
+        ::munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    std::free(arena_);
+    arena_ = nullptr;
+    slots_.clear();
+}
+
+void UringFileBackend::pwriteAll(const char *data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd_, data, size, static_cast<off_t>(file_offset_));
+        write_calls_.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().logError("MetricsWriter: pwrite to " + filename_ + " failed: " + std::strerror(errno));
+            return;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        file_offset_ += static_cast<std::uint64_t>(written);
+    }
+}
+
+// Кладет SQE в кольцо отправки; в ядро он уйдет при следующем submitPending()
+void UringFileBackend::pushSqe(std::uint8_t opcode, std::uint8_t flags, std::uint64_t user_data, unsigned slot_index) {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->flags = flags;
+    sqe->fd = fd_;
+    sqe->user_data = user_data;
+    if (opcode == IORING_OP_WRITE_FIXED) {
+        const Slot &slot = slots_[slot_index];
+        sqe->off = slot.offset;
+        sqe->addr = reinterpret_cast<std::uint64_t>(slot.data);
+        sqe->len = static_cast<std::uint32_t>(slot.length);
+        sqe->buf_index = static_cast<std::uint16_t>(slot_index);
+    } else {
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    }
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+    ++inflight_;
+}
+
+void UringFileBackend::submitWrite(unsigned slot_index) {
+    pushSqe(IORING_OP_WRITE_FIXED, 0, slot_index, slot_index);
+}
+
+// Отправляет подготовленные SQE без ожидания завершения
+void UringFileBackend::submitPending() {
+    unsigned busy_retries = 0;
+    while (ring_fd_ >= 0 && to_submit_ > 0) {
+        long submitted = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit_, 0, 0, nullptr, 0);
+        write_calls_.fetch_add(1, std::memory_order_relaxed);
+        if (submitted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EBUSY) && ++busy_retries <= kMaxBusyRetries) {
+                // Ядру не хватает ресурсов или переполнено кольцо завершений: дождемся хотя бы одного
+                if (!reapCompletions(1)) {
+                    return;
+                }
+                continue;
+            }
+            abandonRing(errno);
+            return;
+        }
+        busy_retries = 0;
+        to_submit_ -= static_cast<unsigned>(submitted);
+    }
+}
+
+// Обрабатывает завершенные операции; при min_complete > 0 ждет, пока завершится хотя бы столько.
+// Возвращает false, если ожидание завершилось ошибкой без готовых завершений: кольцо уже
+// закрыто abandonRing(), и вызывающий должен прекратить ожидание
+bool UringFileBackend::reapCompletions(unsigned min_complete) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (min_complete > 0 && head == tail) {
+        long ret = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit_, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret > 0) {
+            to_submit_ -= std::min(to_submit_, static_cast<unsigned>(ret));
+        }
+        tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (ret < 0 && errno != EINTR && head == tail) {
+            abandonRing(errno);
+            return false;
+        }
+    }
+    while (head != tail) {
+        const io_uring_cqe &cqe = static_cast<const io_uring_cqe *>(cqes_)[head & *cq_mask_];
+        ++head;
+        --inflight_;
+        if (cqe.user_data == kSyncTag) {
+            if (cqe.res < 0) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+                Logger::getInstance().logError("MetricsWriter: fdatasync of " + filename_ + " failed: " + std::strerror(-cqe.res));
+            }
+            continue;
+        }
+
+        Slot &slot = slots_[cqe.user_data];
+        if (cqe.res < 0) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().logError("MetricsWriter: io_uring write to " + filename_ + " failed: " + std::strerror(-cqe.res));
+            slot.busy = false;
+            continue;
+        }
+        std::size_t done = static_cast<std::size_t>(cqe.res);
+        if (done < slot.length) {
+            // Частичная запись: досылаем остаток из того же буфера
+            slot.offset += done;
+            slot.length -= done;
+            std::memmove(slot.data, slot.data + done, slot.length);
+            submitWrite(static_cast<unsigned>(cqe.user_data));
+            continue;
+        }
+        slot.busy = false;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Кольцо больше не принимает и не завершает операции (EBADF, ENOMEM, EFAULT и т.п.): вместо бесконечного
+// ожидания незавершенные и неотправленные операции считаются потерянными, а запись продолжается через pwrite
+void UringFileBackend::abandonRing(int err) {
+    errors_.fetch_add(std::max(inflight_, 1u), std::memory_order_relaxed);
+    Logger::getInstance().logError("MetricsWriter: io_uring_enter failed: " + std::string(std::strerror(err)) + ", " +
+                                   std::to_string(inflight_) + " operations lost, falling back to pwrite for " + filename_);
+    inflight_ = 0;
+    to_submit_ = 0;
+    teardownRing();
+}
+
+// Поток записи общий для всех писателей и логгера, поэтому освобождения буфера он не ждет
+int UringFileBackend::acquireSlot() {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i].busy) {
+                return static_cast<int>(i);
+            }
+        }
+        // Все буферы в работе: отправляем подготовленное и забираем уже готовые завершения
+        submitPending();
+        if (ring_fd_ < 0) {
+            return -1;
+        }
+        reapCompletions(0);
+    }
+    return -1;
+}
+
+std::size_t UringFileBackend::append(const char *data, std::size_t size) {
+    std::size_t accepted = 0;
+    while (ring_fd_ >= 0 && accepted < size) {
+        int index = acquireSlot();
+        if (index < 0) {
+            if (ring_fd_ >= 0) {
+                ++stalls_;
+            }
+            break;
+        }
+        std::size_t chunk = std::min(size - accepted, buffer_size_);
+        Slot &slot = slots_[index];
+        std::memcpy(slot.data, data + accepted, chunk);
+        slot.length = chunk;
+        slot.offset = file_offset_;
+        slot.busy = true;
+        file_offset_ += chunk;
+        submitWrite(static_cast<unsigned>(index));
+        accepted += chunk;
+    }
+    if (ring_fd_ < 0) {
+        // Кольцо недоступно или закрыто после ошибки: остаток пишется синхронно
+        pwriteAll(data + accepted, size - accepted);
+        return size;
+    }
+    submitPending();
+    return accepted;
+}
+
+bool UringFileBackend::sync() {
+    if (ring_fd_ >= 0 && inflight_ + 1 >= sq_entries_) {
+        reapCompletions(0);
+        if (ring_fd_ >= 0 && inflight_ + 1 >= sq_entries_) {
+            return false;
+        }
+    }
+    sync_calls_.fetch_add(1, std::memory_order_relaxed);
+    if (ring_fd_ < 0) {
+        if (::fdatasync(fd_) != 0) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().logError("MetricsWriter: fdatasync of " + filename_ + " failed: " + std::strerror(errno));
+        }
+        return true;
+    }
+    // IOSQE_IO_DRAIN: синхронизация начнется только после завершения всех ранее отправленных записей
+    pushSqe(IORING_OP_FSYNC, IOSQE_IO_DRAIN, kSyncTag, 0);
+    submitPending();
+    return true;
+}
+
+void UringFileBackend::drain() {
+    if (ring_fd_ < 0) {
+        return;
+    }
+    submitPending();
+    while (ring_fd_ >= 0 && inflight_ > 0 && reapCompletions(1)) {
+    }
+}
+
+// ================= MmapFileBackend =================
+MmapFileBackend::MmapFileBackend(const std::string &filename, std::size_t extent_size)
+    : filename_(filename), extent_size_(std::max<std::size_t>(extent_size, 4096)) {
+    fd_ = ::open(filename_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Error opening file: " + filename_ + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        int err = errno;
+        ::close(fd_);
+        throw std::runtime_error("Error reading file size: " + filename_ + ": " + std::strerror(err));
+    }
+
+    std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    bool fresh = size == 0;
+    if (!fresh && size < sizeof(MmapFileHeader)) {
+        ::close(fd_);
+        throw std::runtime_error("Not an mmap metrics file: " + filename_);
+    }
+    try {
+        if (fresh) {
+            grow(sizeof(MmapFileHeader));
+            MmapFileHeader *h = header();
+            std::memcpy(h->magic, MmapFileHeader::kMagic, sizeof(h->magic));
+            h->version = MmapFileHeader::kVersion;
+            h->header_size = sizeof(MmapFileHeader);
+        } else {
+            map_ = static_cast<char *>(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+            if (map_ == MAP_FAILED) {
+                map_ = nullptr;
+                throw std::runtime_error("Error mapping file: " + filename_ + ": " + std::strerror(errno));
+            }
+            mapped_size_ = size;
+            const MmapFileHeader *h = header();
+            if (std::memcmp(h->magic, MmapFileHeader::kMagic, sizeof(h->magic)) != 0 ||
+                h->header_size != sizeof(MmapFileHeader) || h->header_size + h->committed > size) {
+                throw std::runtime_error("Not an mmap metrics file: " + filename_);
+            }
+        }
+    } catch (...) {
+        if (map_ != nullptr) {
+            ::munmap(map_, mapped_size_);
+        }
+        ::close(fd_);
+        throw;
+    }
+    synced_ = committed();
+}
+
+MmapFileBackend::~MmapFileBackend() {
+    std::uint64_t length = sizeof(MmapFileHeader) + committed();
+    ::munmap(map_, mapped_size_);
+    if (::ftruncate(fd_, static_cast<off_t>(length)) != 0) {
+        Logger::getInstance().logError("MetricsWriter: truncating " + filename_ + " failed: " + std::strerror(errno));
+    }
+    ::close(fd_);
+}
+
+std::uint64_t MmapFileBackend::committed() const {
+    return __atomic_load_n(&header()->committed, __ATOMIC_ACQUIRE);
+}
+
+void MmapFileBackend::grow(std::uint64_t required) {
+    std::uint64_t new_size = (required + extent_size_ - 1) / extent_size_ * extent_size_;
+    write_calls_.fetch_add(1, std::memory_order_relaxed);
+    int rc = ::fallocate(fd_, 0, static_cast<off_t>(mapped_size_), static_cast<off_t>(new_size - mapped_size_));
+    if (rc != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+        // Файловая система не умеет выделять место заранее: достаточно увеличить размер
+        rc = ::ftruncate(fd_, static_cast<off_t>(new_size));
+    }
+    if (rc != 0) {
+        throw std::runtime_error("Error preallocating file: " + filename_ + ": " + std::strerror(errno));
+    }
+
+    void *map = map_ == nullptr
+        ? ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0)
+        : ::mremap(map_, mapped_size_, new_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Error mapping file: " + filename_ + ": " + std::strerror(errno));
+    }
+    map_ = static_cast<char *>(map);
+    mapped_size_ = new_size;
+}
+
+std::size_t MmapFileBackend::append(const char *data, std::size_t size) {
+    std::uint64_t length = committed();
+    std::uint64_t end = sizeof(MmapFileHeader) + length + size;
+    if (end > mapped_size_) {
+        try {
+            grow(end);
+        } catch (const std::exception &e) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().logError("MetricsWriter: " + std::string(e.what()));
+            return size;
+        }
+    }
+    std::memcpy(map_ + sizeof(MmapFileHeader) + length, data, size);
+    __atomic_store_n(&header()->committed, length + size, __ATOMIC_RELEASE);
+    return size;
+}
+
+bool MmapFileBackend::sync() {
+    sync_calls_.fetch_add(1, std::memory_order_relaxed);
+    // Синхронизируем страницы от последней синхронизированной позиции до конца данных и заголовок
+    std::uint64_t end = sizeof(MmapFileHeader) + committed();
+    std::uint64_t begin = (sizeof(MmapFileHeader) + synced_) & ~std::uint64_t(4095);
+    if (::msync(map_ + begin, end - begin, MS_SYNC) != 0 || ::msync(map_, sizeof(MmapFileHeader), MS_SYNC) != 0) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        Logger::getInstance().logError("MetricsWriter: msync of " + filename_ + " failed: " + std::strerror(errno));
+        return true;
+    }
+    synced_ = end - sizeof(MmapFileHeader);
+    return true;
+}
+
+// ================= Фабрика =================
+std::unique_ptr<FileBackend> makeFileBackend(WriterBackend backend, const std::string &filename,
+                                             std::size_t buffer_size, std::size_t extent_size) {
+    switch (backend) {
+    case WriterBackend::Mmap:
+        return std::make_unique<MmapFileBackend>(filename, extent_size);
+    case WriterBackend::IoUring: {
+        // Размер зарегистрированного буфера: не меньше 64 КБ, кратен странице
+        std::size_t size = std::max<std::size_t>(buffer_size, 64 * 1024);
+        size = (size + 4095) & ~std::size_t(4095);
+        return std::make_unique<UringFileBackend>(filename, size);
+    }
+    case WriterBackend::Posix:
+    default:
+        return std::make_unique<PosixFileBackend>(filename);
+    }
+}
@@ -0,0 +1,353 @@
+#include "influx_sink.h"
+#include "logger.h"
+#include "value_format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Дописывает имя измерения, ключ или значение тега либо ключ поля, экранируя символы из special
+void appendEscaped(std::string &out, const std::string &text, const char *special) {
+    for (char c : text) {
+        if (std::strchr(special, c) != nullptr) {
+            out += '\\';
+        }
+        out += c;
+    }
+}
+
+} // namespace
+
+// ================= InfluxSink =================
+InfluxSink::InfluxSink(const InfluxOptions &options) : options_(options) {
+    options_.batch_lines = std::max<std::size_t>(options_.batch_lines, 1);
+    options_.queue_limit = std::max<std::size_t>(options_.queue_limit, 1);
+
+    appendEscaped(prefix_, options_.measurement, ", ");
+    for (const auto &tag : options_.tags) {
+        prefix_ += ',';
+        appendEscaped(prefix_, tag.first, ",= ");
+        prefix_ += '=';
+        appendEscaped(prefix_, tag.second, ",= ");
+    }
+    prefix_ += ' ';
+
+    if (options_.target == InfluxTarget::File) {
+        fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Error opening file: " + options_.path + ": " + std::strerror(errno));
+        }
+    } else {
+        connect();
+    }
+
+    if (options_.gzip) {
+        // windowBits 15 + 16 — формат gzip вместо zlib
+        if (::deflateInit2(&zstream_, options_.gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+            throw std::runtime_error("InfluxSink: deflateInit2 failed");
+        }
+        zstream_ready_ = true;
+    }
+    batch_.reserve(256 * 1024);
+    thread_ = std::thread(&InfluxSink::run, this);
+}
+
+InfluxSink::~InfluxSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_var_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (zstream_ready_) {
+        ::deflateEnd(&zstream_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void InfluxSink::publish(std::shared_ptr<const Snapshot> snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    auto now = snapshot->captureTime(std::chrono::system_clock::now()).time_since_epoch();
+    Entry entry;
+    entry.snapshot = std::move(snapshot);
+    entry.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= options_.queue_limit) {
+            dropped_points_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue_.push_back(std::move(entry));
+    }
+    cond_var_.notify_one();
+}
+
+void InfluxSink::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::uint64_t request = ++flush_requested_;
+    queue_.push_back(Entry());
+    cond_var_.notify_one();
+    flush_cv_.wait(lock, [this, request] { return flush_done_ >= request; });
+}
+
+InfluxStats InfluxSink::getStats() const {
+    InfluxStats stats;
+    stats.points = points_.load(std::memory_order_relaxed);
+    stats.dropped_points = dropped_points_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SinkStats InfluxSink::sinkStats() const {
+    SinkStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queued = queue_.size();
+    }
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_points_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Основной цикл: кодирует снимки в пакет и пишет его по размеру, по времени, при flush() и при остановке
+void InfluxSink::run() {
+    using Clock = std::chrono::steady_clock;
+    auto batch_deadline = Clock::time_point::max();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (queue_.empty() && !stopped_) {
+            if (batch_lines_ > 0) {
+                cond_var_.wait_until(lock, batch_deadline);
+            } else {
+                cond_var_.wait(lock);
+            }
+        }
+        if (queue_.empty()) {
+            if (stopped_) {
+                break;
+            }
+            if (batch_lines_ > 0 && Clock::now() >= batch_deadline) {
+                lock.unlock();
+                writeBatch();
+                lock.lock();
+            }
+            continue;
+        }
+
+        Entry entry = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        if (!entry.snapshot) {
+            writeBatch();
+            lock.lock();
+            ++flush_done_;
+            flush_cv_.notify_all();
+            continue;
+        }
+        if (batch_lines_ == 0) {
+            batch_deadline = Clock::now() + options_.batch_interval;
+        }
+        encode(entry);
+        if (batch_lines_ >= options_.batch_lines || Clock::now() >= batch_deadline) {
+            writeBatch();
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    writeBatch();
+}
+
+// Кодирует снимок одной строкой: поля — метрики снимка
+void InfluxSink::encode(const Entry &entry) {
+    std::size_t line_start = batch_.size();
+    batch_ += prefix_;
+    std::size_t fields_start = batch_.size();
+    const Snapshot &snapshot = *entry.snapshot;
+    snapshot.appendShared(batch_, SharedEncoding::InfluxFields, [&snapshot](std::string &fields) {
+        std::size_t start = fields.size();
+        for (const auto &sample : snapshot.samples) {
+            // Значения NaN и бесконечности line protocol не поддерживает
+            if (sample.type == MetricType::Gauge && !std::isfinite(sample.gauge)) {
+                continue;
+            }
+            if (fields.size() > start) {
+                fields += ',';
+            }
+            appendEscaped(fields, sample.name, ",= ");
+            fields += '=';
+            switch (sample.type) {
+            case MetricType::Gauge:
+                appendGauge(fields, sample.gauge, kShortestPrecision);
+                break;
+            case MetricType::Counter:
+                appendCounter(fields, sample.counter);
+                fields += 'i';
+                break;
+            case MetricType::Text:
+                fields += '"';
+                appendEscaped(fields, sample.text, "\"\\");
+                fields += '"';
+                break;
+            case MetricType::Histogram:
+                // Корзины в line protocol не передаются: только количество и сумма
+                fields.pop_back();
+                fields += "_count=";
+                appendCounter(fields, static_cast<std::int64_t>(sample.histogram.count));
+                fields += "i,";
+                appendEscaped(fields, sample.name, ",= ");
+                fields += "_sum=";
+                appendGauge(fields, sample.histogram.sum, kShortestPrecision);
+                break;
+            }
+        }
+    });
+    if (batch_.size() == fields_start) {
+        // Точка без полей недопустима
+        batch_.resize(line_start);
+        return;
+    }
+    batch_ += ' ';
+    appendCounter(batch_, entry.timestamp_ns);
+    batch_ += '\n';
+    ++batch_lines_;
+    points_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InfluxSink::writeBatch() {
+    if (batch_lines_ == 0) {
+        return;
+    }
+    const char *data = batch_.data();
+    std::size_t size = batch_.size();
+    if (zstream_ready_) {
+        ::deflateReset(&zstream_);
+        compressed_.resize(::deflateBound(&zstream_, static_cast<uLong>(batch_.size())));
+        zstream_.next_in = reinterpret_cast<Bytef *>(batch_.data());
+        zstream_.avail_in = static_cast<uInt>(batch_.size());
+        zstream_.next_out = reinterpret_cast<Bytef *>(&compressed_[0]);
+        zstream_.avail_out = static_cast<uInt>(compressed_.size());
+        if (::deflate(&zstream_, Z_FINISH) != Z_STREAM_END) {
+            Logger::getInstance().logError("InfluxSink: gzip compression failed");
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            dropped_points_.fetch_add(batch_lines_, std::memory_order_relaxed);
+            batch_.clear();
+            batch_lines_ = 0;
+            return;
+        }
+        data = compressed_.data();
+        size = compressed_.size() - zstream_.avail_out;
+    }
+
+    if ((fd_ >= 0 || connect()) && writeAll(data, size)) {
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        raw_bytes_.fetch_add(batch_.size(), std::memory_order_relaxed);
+        bytes_.fetch_add(size, std::memory_order_relaxed);
+    } else {
+        dropped_points_.fetch_add(batch_lines_, std::memory_order_relaxed);
+    }
+    batch_.clear();
+    batch_lines_ = 0;
+}
+
+// Подключает сокет; повторные попытки — не чаще reconnect_delay
+bool InfluxSink::connect() {
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_connect_) {
+        return false;
+    }
+    next_connect_ = now + options_.reconnect_delay;
+
+    int err = 0;
+    if (options_.target == InfluxTarget::Unix) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options_.path.size() >= sizeof(address.sun_path)) {
+            Logger::getInstance().logError("InfluxSink: socket path is too long: " + options_.path);
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::memcpy(address.sun_path, options_.path.c_str(), options_.path.size() + 1);
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ >= 0 && ::connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            err = errno;
+            ::close(fd_);
+            fd_ = -1;
+        }
+    } else {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses = nullptr;
+        int rc = ::getaddrinfo(options_.host.c_str(), std::to_string(options_.port).c_str(), &hints, &addresses);
+        if (rc != 0) {
+            Logger::getInstance().logError("InfluxSink: cannot resolve " + options_.host + ": " + ::gai_strerror(rc));
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        for (addrinfo *address = addresses; address != nullptr && fd_ < 0; address = address->ai_next) {
+            fd_ = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+            if (fd_ >= 0 && ::connect(fd_, address->ai_addr, address->ai_addrlen) != 0) {
+                err = errno;
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+        ::freeaddrinfo(addresses);
+    }
+    if (fd_ < 0) {
+        // Подключение повторяется на каждом пакете, пока получатель недоступен
+        METRICS_LOG_RATE_LIMITED(LogLevel::Error, 1.0, 5, "InfluxSink: cannot connect to {}: {}",
+                                 options_.target == InfluxTarget::Unix ? options_.path
+                                                                       : options_.host + ":" + std::to_string(options_.port),
+                                 std::strerror(err != 0 ? err : errno));
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool InfluxSink::writeAll(const char *data, std::size_t size) {
+    const bool socket = options_.target != InfluxTarget::File;
+    while (size > 0) {
+        ssize_t written = socket ? ::send(fd_, data, size, MSG_NOSIGNAL) : ::write(fd_, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            Logger::getInstance().logError("InfluxSink: write failed: " + std::string(std::strerror(errno)));
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            if (socket) {
+                // Соединение разорвано: при следующем пакете подключение будет повторено
+                ::close(fd_);
+                fd_ = -1;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
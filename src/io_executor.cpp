@@ -0,0 +1,166 @@
+#include "io_executor.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+namespace {
+
+std::mutex shared_mutex;
+unsigned shared_threads = 0; // 0 — из METRICS_IO_THREADS или один поток
+bool shared_created = false;
+
+// Число потоков общего исполнителя при его создании
+unsigned sharedThreads() {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    shared_created = true;
+    const char *env_threads = std::getenv("METRICS_IO_THREADS");
+    if (shared_threads == 0 && env_threads != nullptr) {
+        return static_cast<unsigned>(std::strtoul(env_threads, nullptr, 10));
+    }
+    return shared_threads;
+}
+
+} // namespace
+
+// ================= IoExecutor =================
+IoExecutor::IoExecutor(unsigned threads) : thread_count_(std::max(threads, 1u)) {
+    threads_.reserve(thread_count_);
+    for (unsigned i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back(&IoExecutor::run, this);
+    }
+}
+
+IoExecutor::~IoExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+IoExecutor &IoExecutor::shared() {
+    static IoExecutor instance(sharedThreads());
+    return instance;
+}
+
+bool IoExecutor::setSharedThreads(unsigned threads) {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    if (shared_created) {
+        return false;
+    }
+    shared_threads = threads;
+    return true;
+}
+
+void IoExecutor::attach(IoTask &task, IoPriority priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task.priority_ = priority;
+    task.running_ = false;
+    task.pending_ = false;
+    task.deadline_ = std::chrono::steady_clock::time_point::max();
+    tasks_.push_back(&task);
+}
+
+void IoExecutor::detach(IoTask &task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [&task] { return !task.running_; });
+    tasks_.erase(std::remove(tasks_.begin(), tasks_.end(), &task), tasks_.end());
+}
+
+void IoExecutor::wake(IoTask &task) {
+    wake(task, task.priority_);
+}
+
+void IoExecutor::wake(IoTask &task, IoPriority priority) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (task.pending_) {
+            task.pending_priority_ = std::max(task.pending_priority_, priority);
+            return;
+        }
+        task.pending_ = true;
+        task.pending_priority_ = std::max(task.priority_, priority);
+        task.pending_order_ = order_++;
+        if (task.running_) {
+            // Задачу возьмет следующий свободный поток после завершения текущего обслуживания
+            return;
+        }
+    }
+    work_cv_.notify_one();
+}
+
+std::uint64_t IoExecutor::services() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return services_;
+}
+
+IoTask *IoExecutor::next(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point &wait_until) {
+    IoTask *best = nullptr;
+    IoPriority best_priority = IoPriority::Low;
+    std::uint64_t best_order = 0;
+    wait_until = std::chrono::steady_clock::time_point::max();
+    for (IoTask *task : tasks_) {
+        if (task->running_) {
+            continue;
+        }
+        if (!task->pending_ && task->deadline_ > now) {
+            wait_until = std::min(wait_until, task->deadline_);
+            continue;
+        }
+        // Задачи по сроку идут после разбуженных того же приоритета
+        IoPriority priority = task->pending_ ? task->pending_priority_ : task->priority_;
+        std::uint64_t order = task->pending_ ? task->pending_order_ : UINT64_MAX;
+        if (best == nullptr || priority > best_priority || (priority == best_priority && order < best_order)) {
+            best = task;
+            best_priority = priority;
+            best_order = order;
+        }
+    }
+    return best;
+}
+
+void IoExecutor::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point wait_until;
+        IoTask *task = next(now, wait_until);
+        if (task == nullptr) {
+            if (wait_until == std::chrono::steady_clock::time_point::max()) {
+                work_cv_.wait(lock);
+            } else {
+                work_cv_.wait_until(lock, wait_until);
+            }
+            continue;
+        }
+
+        task->running_ = true;
+        task->pending_ = false;
+        lock.unlock();
+        std::chrono::steady_clock::time_point deadline;
+        try {
+            deadline = task->service(now);
+        } catch (const std::exception &e) {
+            Logger::getInstance().logError(std::string("IoExecutor: task service failed: ") + e.what());
+            deadline = now + kRetryDelay;
+        } catch (...) {
+            Logger::getInstance().logError("IoExecutor: task service failed with an unknown exception");
+            deadline = now + kRetryDelay;
+        }
+        lock.lock();
+        task->running_ = false;
+        task->deadline_ = deadline;
+        ++services_;
+        idle_cv_.notify_all();
+        if (task->pending_ || thread_count_ > 1) {
+            // Задачу разбудили во время обслуживания или ее срок может быть раньше, чем ждут другие потоки
+            work_cv_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#include "binary_log.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Выводит справку по использованию утилиты
+void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " FILE [OUTPUT]\n"
+              << "  FILE   - binary log written with METRICS_LOG_FORMAT=binary (metrics.log.bin)\n"
+              << "  OUTPUT - text log in the metrics.log format (default: standard output)\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    std::ofstream file;
+    if (argc == 3) {
+        file.open(argv[2], std::ios::app);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open " << argv[2] << "\n";
+            return 1;
+        }
+    }
+    std::ostream &out = argc == 3 ? file : std::cout;
+    try {
+        std::size_t lines = binary_log::decodeBinaryLog(in, out);
+        out.flush();
+        std::cerr << lines << " records decoded\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
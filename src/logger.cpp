@@ -0,0 +1,379 @@
+#include "logger.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+
+namespace {
+
+// Размер буфера, при котором фоновый поток пишет его, не дожидаясь конца очереди
+constexpr std::size_t kWriteChunk = 64 * 1024;
+
+// Владеет буфером двоичного журнала потока; при завершении потока отдает его фоновому потоку
+class StagingHolder
+{
+public:
+    explicit StagingHolder(std::shared_ptr<binary_log::StagingBuffer> buffer) : buffer_(std::move(buffer)) {}
+    ~StagingHolder() { buffer_->retired.store(true, std::memory_order_release); }
+
+private:
+    std::shared_ptr<binary_log::StagingBuffer> buffer_;
+};
+
+template <typename T>
+void appendRaw(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Пишет буфер целиком; при ошибке возвращает false
+bool writeAll(int fd, const char *data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+const char *levelTag(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:
+        return " [TRACE] ";
+    case LogLevel::Debug:
+        return " [DEBUG] ";
+    case LogLevel::Info:
+        return " [INFO] ";
+    case LogLevel::Warn:
+        return " [WARN] ";
+    case LogLevel::Error:
+    case LogLevel::Off:
+        return " [ERROR] ";
+    }
+    return " ";
+}
+
+// Разбирает имя уровня (trace, debug, info, warn, error, off); при ошибке возвращает false
+bool parseLevel(const char *name, LogLevel &level) {
+    static const struct
+    {
+        const char *name;
+        LogLevel level;
+    } kLevels[] = {{"trace", LogLevel::Trace}, {"debug", LogLevel::Debug}, {"info", LogLevel::Info},
+                   {"warn", LogLevel::Warn},   {"error", LogLevel::Error}, {"off", LogLevel::Off}};
+    for (const auto &entry : kLevels) {
+        if (::strcasecmp(name, entry.name) == 0) {
+            level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// ================= Logger =================
+Logger::Logger()
+    : log_filename_("metrics.log"), slots_(new Slot[kQueueCapacity]), binary_filename_("metrics.log.bin"),
+      start_ticks_(binary_log::ticks()),
+      start_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count()) {
+    static_assert((kQueueCapacity & (kQueueCapacity - 1)) == 0, "kQueueCapacity must be a power of two");
+    for (std::size_t i = 0; i < kQueueCapacity; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    LogLevel level;
+    const char *env_level = std::getenv("METRICS_LOG_LEVEL");
+    if (env_level != nullptr && parseLevel(env_level, level)) {
+        level_.store(level, std::memory_order_relaxed);
+    }
+    const char *env_format = std::getenv("METRICS_LOG_FORMAT");
+    if (env_format != nullptr && ::strcasecmp(env_format, "binary") == 0) {
+        format_.store(LogFormat::Binary, std::memory_order_relaxed);
+    }
+    fd_ = ::open(log_filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    buffer_.reserve(kWriteChunk + 4096);
+    executor_ = &IoExecutor::shared();
+    executor_->attach(*this, IoPriority::Low);
+    // Первое обслуживание назначает периодический перенос записей
+    executor_->wake(*this);
+}
+
+Logger::~Logger() {
+    executor_->detach(*this);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    flushed_cv_.notify_all();
+    drain();
+    drainBinary();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (binary_fd_ >= 0) {
+        ::close(binary_fd_);
+    }
+}
+
+void Logger::enqueue(LogLevel level, std::string message) {
+    auto now = std::chrono::system_clock::now();
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &slots_[pos & (kQueueCapacity - 1)];
+        std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Очередь заполнена: запись отбрасывается, фоновый поток сообщит о потере
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            dropped_total_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->time = now;
+    slot->level = level;
+    slot->message = std::move(message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Очередь заполнена наполовину — будим фоновый поток, не дожидаясь kFlushInterval
+    if (pos >= written_pos_.load(std::memory_order_relaxed) + kQueueCapacity / 2 &&
+        !wake_requested_.exchange(true, std::memory_order_relaxed)) {
+        executor_->wake(*this);
+    }
+}
+
+std::uint32_t Logger::registerSite(LogLevel level, std::string format, const char *types) {
+    std::lock_guard<std::mutex> lock(sites_mutex_);
+    sites_.push_back(Site{level, types, std::move(format)});
+    return static_cast<std::uint32_t>(sites_.size());
+}
+
+binary_log::StagingBuffer *Logger::createStagingBuffer() {
+    auto buffer = std::make_shared<binary_log::StagingBuffer>();
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex_);
+        staging_buffers_.push_back(buffer);
+    }
+    static thread_local StagingHolder holder(buffer);
+    staging_ = buffer.get();
+    return staging_;
+}
+
+void Logger::flush() {
+    std::uint64_t request;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        request = ++flush_requested_;
+    }
+    executor_->wake(*this, IoPriority::High);
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushed_cv_.wait(lock, [this, request] { return flush_done_ >= request || stopped_; });
+}
+
+std::chrono::steady_clock::time_point Logger::service(std::chrono::steady_clock::time_point now) {
+    std::uint64_t request;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        request = flush_requested_;
+    }
+    wake_requested_.store(false, std::memory_order_relaxed);
+    drain();
+    drainBinary();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_done_ = request;
+    }
+    flushed_cv_.notify_all();
+    return now + kFlushInterval;
+}
+
+void Logger::drain() {
+    char timestamp[TimestampFormatter::kLength];
+    while (true) {
+        Slot &slot = slots_[dequeue_pos_ & (kQueueCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+            break;
+        }
+        timestamps_.format(slot.time, timestamp);
+        buffer_.append(timestamp, TimestampFormatter::kSecondsLength);
+        buffer_ += levelTag(slot.level);
+        buffer_ += slot.message;
+        buffer_ += '\n';
+        // Память сообщения освобождается здесь, а не в вызывающем потоке
+        std::string().swap(slot.message);
+        slot.sequence.store(dequeue_pos_ + kQueueCapacity, std::memory_order_release);
+        ++dequeue_pos_;
+        if (buffer_.size() >= kWriteChunk) {
+            writeBuffer();
+        }
+    }
+
+    // В двоичном режиме о потерях сообщает drainBinary()
+    std::uint64_t dropped =
+        logFormat() == LogFormat::Text ? dropped_.exchange(0, std::memory_order_relaxed) : 0;
+    if (dropped > 0) {
+        timestamps_.format(std::chrono::system_clock::now(), timestamp);
+        buffer_.append(timestamp, TimestampFormatter::kSecondsLength);
+        buffer_ += levelTag(LogLevel::Error);
+        buffer_ += "Logger: " + std::to_string(dropped) + " records dropped (queue is full)\n";
+    }
+    writeBuffer();
+    written_pos_.store(dequeue_pos_, std::memory_order_release);
+}
+
+void Logger::writeBuffer() {
+    if (buffer_.empty()) {
+        return;
+    }
+    if (fd_ < 0) {
+        fd_ = ::open(log_filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    if (fd_ >= 0) {
+        // Сообщить об ошибке журнала некуда: буфер отбрасывается
+        writeAll(fd_, buffer_.data(), buffer_.size());
+    }
+    buffer_.clear();
+}
+
+void Logger::drainBinary() {
+    // Опубликованные записи каждого буфера на момент начала прохода
+    struct Source
+    {
+        binary_log::StagingBuffer *buffer;
+        std::size_t pos;    // Начало очередной записи.
+        std::size_t end;
+        std::uint64_t time; // Такты очередной записи.
+    };
+    std::vector<Source> sources;
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex_);
+        for (auto it = staging_buffers_.begin(); it != staging_buffers_.end();) {
+            binary_log::StagingBuffer &buffer = **it;
+            // retired читается до head: записи завершившегося потока уже опубликованы
+            bool retired = buffer.retired.load(std::memory_order_acquire);
+            std::size_t end = buffer.head();
+            if (retired && buffer.tail() == end) {
+                it = staging_buffers_.erase(it);
+                continue;
+            }
+            if (buffer.tail() != end) {
+                sources.push_back(Source{&buffer, buffer.tail(), end, 0});
+            }
+            ++it;
+        }
+    }
+
+    // Перевод тактов в реальное время: частота оценивается от момента создания журнала,
+    // отсчет ведется от текущего момента, поэтому ошибка оценки мала для свежих записей
+    std::uint64_t now_ticks = binary_log::ticks();
+    std::int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    double ns_per_tick = now_ticks > start_ticks_ && now_ns > start_ns_
+                             ? static_cast<double>(now_ns - start_ns_) / static_cast<double>(now_ticks - start_ticks_)
+                             : 1.0;
+
+    auto readTime = [](Source &source) {
+        source.pos = source.buffer->recordAt(source.pos);
+        std::memcpy(&source.time, source.buffer->data(source.pos) + 8, sizeof(source.time));
+    };
+
+    // Слияние по времени: записи каждого потока уже упорядочены
+    std::string &records = binary_records_;
+    for (Source &source : sources) {
+        readTime(source);
+    }
+    while (!sources.empty()) {
+        std::size_t next = 0;
+        for (std::size_t i = 1; i < sources.size(); ++i) {
+            if (sources[i].time < sources[next].time) {
+                next = i;
+            }
+        }
+        Source &source = sources[next];
+        const char *record = source.buffer->data(source.pos);
+        std::uint32_t length;
+        std::memcpy(&length, record, sizeof(length));
+        records += binary_log::kRecordTag;
+        std::size_t offset = records.size();
+        records.append(record, 4 + length);
+        auto age = static_cast<double>(static_cast<std::int64_t>(now_ticks - source.time)) * ns_per_tick;
+        auto time_ns = static_cast<std::uint64_t>(now_ns - static_cast<std::int64_t>(age));
+        std::memcpy(&records[offset + 8], &time_ns, sizeof(time_ns));
+
+        source.pos += 4 + length;
+        if (source.pos == source.end) {
+            source.buffer->release(source.end);
+            sources.erase(sources.begin() + static_cast<std::ptrdiff_t>(next));
+        } else {
+            readTime(source);
+        }
+        if (records.size() >= kWriteChunk) {
+            writeBinary(records);
+            records.clear();
+        }
+    }
+
+    std::uint64_t dropped =
+        logFormat() == LogFormat::Binary ? dropped_.exchange(0, std::memory_order_relaxed) : 0;
+    if (dropped > 0) {
+        records += binary_log::kDroppedTag;
+        appendRaw(records, static_cast<std::uint64_t>(now_ns));
+        appendRaw(records, dropped);
+    }
+    if (!records.empty()) {
+        writeBinary(records);
+        records.clear();
+    }
+}
+
+void Logger::writeBinary(const std::string &data) {
+    binary_buffer_.clear();
+    if (binary_fd_ < 0) {
+        binary_fd_ = ::open(binary_filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (binary_fd_ < 0) {
+            return;
+        }
+        binary_buffer_ += binary_log::kSessionTag;
+        binary_buffer_.append(binary_log::kMagic, sizeof(binary_log::kMagic));
+        written_sites_ = 0;
+    }
+
+    // Места вызова, зарегистрированные до публикации записей, пишутся перед ними
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex_);
+        for (; written_sites_ < sites_.size(); ++written_sites_) {
+            const Site &site = sites_[written_sites_];
+            binary_buffer_ += binary_log::kSiteTag;
+            appendRaw(binary_buffer_, static_cast<std::uint32_t>(written_sites_ + 1));
+            appendRaw(binary_buffer_, static_cast<std::uint8_t>(site.level));
+            appendRaw(binary_buffer_, static_cast<std::uint8_t>(site.types.size()));
+            binary_buffer_ += site.types;
+            appendRaw(binary_buffer_, static_cast<std::uint32_t>(site.format.size()));
+            binary_buffer_ += site.format;
+        }
+    }
+    if (binary_buffer_.empty()) {
+        writeAll(binary_fd_, data.data(), data.size());
+    } else {
+        binary_buffer_ += data;
+        writeAll(binary_fd_, binary_buffer_.data(), binary_buffer_.size());
+    }
+}
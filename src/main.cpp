@@ -1,115 +1,98 @@
 #include "metrics_library.h"
 #include <thread>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <random>
 #include <iostream>
 #include <vector>
 
-// Функция для имитации утилизации CPU (Gauge)
-void simulateCpuUsage(std::shared_ptr<Gauge> cpuMetric, int durationSeconds) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 8.0); // Имитация загрузки до 8 ядер
-
-    for (int i = 0; i < durationSeconds; ++i) {
-        try {
-            double cpuLoad = dis(gen);
-            cpuMetric->update(cpuLoad);
-            Logger::getInstance().logInfo("CPU usage simulated: " + std::to_string(cpuLoad));
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        } catch (const std::exception& e) {
-            Logger::getInstance().logError("Error in simulateCpuUsage: " + std::string(e.what()));
-        }
-    }
-}
-
-// Функция для имитации использования памяти (Gauge)
-void simulateMemoryUsage(std::shared_ptr<Gauge> memoryMetric, int durationSeconds) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 16.0); // Имитация использования памяти в ГБ
-
-    for (int i = 0; i < durationSeconds; ++i) {
-        try {
-            double memoryLoad = dis(gen);
-            memoryMetric->update(memoryLoad);
-            Logger::getInstance().logInfo("Memory usage simulated: " + std::to_string(memoryLoad));
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        } catch (const std::exception& e) {
-            Logger::getInstance().logError("Error in simulateMemoryUsage: " + std::string(e.what()));
-        }
-    }
+// Генератор случайных значений для имитации нагрузки
+std::mt19937 &generator() {
+    thread_local std::mt19937 gen(std::random_device{}());
+    return gen;
 }
 
-// Функция для имитации HTTP-запросов (Counter)
-void simulateHttpRequests(std::shared_ptr<Counter> httpMetric, int durationSeconds) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+// Имитация HTTP-запросов (Counter)
+void simulateHttpRequests(Counter &httpMetric) {
     std::uniform_int_distribution<> dis(0, 150); // Случайное количество запросов
-
-    for (int i = 0; i < durationSeconds; ++i) {
-        try {
-            int requests = dis(gen);
-            httpMetric->increment(requests);
-            Logger::getInstance().logInfo("HTTP requests simulated: " + std::to_string(requests));
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        } catch (const std::exception& e) {
-            Logger::getInstance().logError("Error in simulateHttpRequests: " + std::string(e.what()));
-        }
-    }
+    int requests = dis(generator());
+    httpMetric.increment(requests);
+    METRICS_LOG_INFO("HTTP requests simulated: {}", requests);
 }
 
-// Функция для имитации ошибок сервера (Counter)
-void simulateServerErrors(std::shared_ptr<Counter> errorMetric, int durationSeconds) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+// Имитация ошибок сервера (Counter)
+void simulateServerErrors(Counter &errorMetric) {
     std::uniform_int_distribution<> dis(0, 5); // Случайное количество ошибок
+    int errors = dis(generator());
+    errorMetric.increment(errors);
+    METRICS_LOG_INFO("Server errors simulated: {}", errors);
+}
 
+// Выполняет шаг имитации раз в секунду в отдельном потоке
+template <typename Step>
+void runSimulation(const char *name, Step step, int durationSeconds) {
     for (int i = 0; i < durationSeconds; ++i) {
         try {
-            int errors = dis(gen);
-            errorMetric->increment(errors);
-            Logger::getInstance().logInfo("Server errors simulated: " + std::to_string(errors));
+            step();
             std::this_thread::sleep_for(std::chrono::seconds(1));
         } catch (const std::exception& e) {
-            Logger::getInstance().logError("Error in simulateServerErrors: " + std::string(e.what()));
+            METRICS_LOG_ERROR("Error in {}: {}", name, e.what());
         }
     }
 }
 
-int main() {
+/*
+    Запуск: ./main                — шесть секунд сбора в реальном времени, имитация в отдельных потоках;
+            ./main --virtual [N]  — N секунд сбора (по умолчанию час) на виртуальных часах без ожидания,
+                                    имитация выполняется перед каждым тактом.
+*/
+int main(int argc, char *argv[]) {
     try {
+        const bool virtual_time = argc > 1 && std::strcmp(argv[1], "--virtual") == 0;
+        // Длительность симуляции в секундах
+        const int duration = virtual_time ? (argc > 2 ? std::atoi(argv[2]) : 3600) : 6;
+        VirtualClock virtual_clock;
+        Clock &clock = virtual_time ? static_cast<Clock &>(virtual_clock) : Clock::system();
+
         // Инициализация сборщика метрик
-        MetricsCollector collector("metrics_output.txt");
-        Logger::getInstance().logInfo("MetricsCollector initialized with file: metrics_output.txt");
+        WriterOptions options;
+        options.clock = &clock;
+        MetricsCollector collector("metrics_output.txt", options);
+        METRICS_LOG_INFO("MetricsCollector initialized with file: metrics_output.txt");
+
+        // Ресурсы процесса (процессор, память, отказы страниц, переключения, дескрипторы, потоки)
+        // снимаются в начале каждого такта сбора
+        collector.enableProcessMetrics();
 
         // Создание метрик
-        auto cpuMetric = std::make_shared<Gauge>("CPU_usage");
-        auto memoryMetric = std::make_shared<Gauge>("Memory_usage_GB");
         auto httpMetric = std::make_shared<Counter>("HTTP_requests_RPS");
         auto errorMetric = std::make_shared<Counter>("Server_errors");
 
         // Добавление метрик в сборщик
-        collector.addMetric(cpuMetric);
-        collector.addMetric(memoryMetric);
         collector.addMetric(httpMetric);
         collector.addMetric(errorMetric);
-        Logger::getInstance().logInfo("All metrics added to collector");
+        METRICS_LOG_INFO("All metrics added to collector");
 
-        // Запуск симуляции в отдельных потоках
-        const int duration = 6; // Длительность симуляции в секундах
+        CollectionScheduler scheduler(collector, std::chrono::seconds(1), clock);
         std::vector<std::thread> threads;
-        threads.emplace_back(simulateCpuUsage, cpuMetric, duration);
-        threads.emplace_back(simulateMemoryUsage, memoryMetric, duration);
-        threads.emplace_back(simulateHttpRequests, httpMetric, duration);
-        threads.emplace_back(simulateServerErrors, errorMetric, duration);
+        if (virtual_time) {
+            // На виртуальных часах имитация выполняется в потоке сбора перед каждым тактом
+            scheduler.onTick([&](std::size_t) {
+                simulateHttpRequests(*httpMetric);
+                simulateServerErrors(*errorMetric);
+            });
+        } else {
+            // Запуск симуляции в отдельных потоках
+            threads.emplace_back([&] { runSimulation("simulateHttpRequests", [&] { simulateHttpRequests(*httpMetric); }, duration); });
+            threads.emplace_back([&] { runSimulation("simulateServerErrors", [&] { simulateServerErrors(*errorMetric); }, duration); });
+            scheduler.onTick([](std::size_t tick) {
+                std::cout << "Collecting metrics at second " << tick + 1 << std::endl;
+            });
+        }
 
         // Сбор и запись метрик каждую секунду
-        for (int i = 0; i < duration; ++i) {
-            collector.collectAndWrite();
-            std::cout << "Metrics collected and written at second " << i + 1 << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
+        std::size_t ticks = scheduler.runFor(std::chrono::seconds(duration));
 
         // Ожидание завершения всех потоков
         for (auto& thread : threads) {
@@ -120,13 +103,13 @@ int main() {
 
         // Финальный сбор метрик
         collector.collectAndWrite();
-        Logger::getInstance().logInfo("Final metrics collection completed");
-        std::cout << "Metrics collection completed, output written to metrics_output.txt" << std::endl;
+        METRICS_LOG_INFO("Final metrics collection completed");
+        std::cout << ticks + 1 << " collections completed, output written to metrics_output.txt" << std::endl;
 
         return 0;
     } catch (const std::exception& e) {
-        Logger::getInstance().logError("Main execution failed: " + std::string(e.what()));
+        METRICS_LOG_ERROR("Main execution failed: {}", e.what());
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+}
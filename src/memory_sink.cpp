@@ -0,0 +1,38 @@
+#include "memory_sink.h"
+
+#include <chrono>
+#include <utility>
+
+// ================= MemorySink =================
+MemorySink::MemorySink(std::unique_ptr<Encoder> encoder)
+    : encoder_(encoder ? std::move(encoder) : makeEncoder(OutputFormat::Text)) {}
+
+void MemorySink::publish(std::shared_ptr<const Snapshot> snapshot) {
+    if (!snapshot || snapshot->samples.empty()) {
+        return;
+    }
+    auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+        encoder_->begin(buffer_, true);
+        started_ = true;
+    }
+    encoder_->encode(*snapshot, snapshot->captureTime(now), buffer_);
+    ++snapshots_;
+}
+
+std::string MemorySink::take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_) {
+        encoder_->finish(buffer_);
+        started_ = false;
+    }
+    std::string data;
+    data.swap(buffer_);
+    return data;
+}
+
+std::uint64_t MemorySink::snapshots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshots_;
+}
@@ -3,19 +3,6 @@
 #include <chrono>
 #include <random>
 
-// Пример функции, имитирующей сбор данных об утилизации CPU
-void simulateCpuUsage(std::shared_ptr<Gauge> cpuMetric, int durationSeconds) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 4.0); // Имитация загрузки до 4 ядер
-
-    for (int i = 0; i < durationSeconds; ++i) {
-        double cpuLoad = dis(gen); // Генерация случайной загрузки CPU
-        cpuMetric->update(cpuLoad);
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-}
-
 // Пример функции, имитирующей подсчёт HTTP-запросов
 void simulateHttpRequests(std::shared_ptr<Counter> httpMetric, int durationSeconds) {
     std::random_device rd;
@@ -33,16 +20,16 @@ int main() {
     // Создание сборщика метрик с файлом для записи
     MetricsCollector collector("metrics_output.txt");
 
+    // Ресурсы процесса: загрузка CPU, память и другие показания снимаются при каждом сборе
+    collector.enableProcessMetrics();
+
     // Создание метрик
-    auto cpuMetric = std::make_shared<Gauge>("CPU");
     auto httpMetric = std::make_shared<Counter>("HTTP_requests_RPS");
 
     // Добавление метрик в сборщик
-    collector.addMetric(cpuMetric);
     collector.addMetric(httpMetric);
 
-    // Запуск имитации в отдельных потоках
-    std::thread cpuThread(simulateCpuUsage, cpuMetric, 5);
+    // Запуск имитации в отдельном потоке
     std::thread httpThread(simulateHttpRequests, httpMetric, 5);
 
     // Сбор и запись метрик каждую секунду
@@ -51,13 +38,12 @@ int main() {
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
-    // Ожидание завершения потоков
-    cpuThread.join();
+    // Ожидание завершения потока
     httpThread.join();
 
     // Финальный сбор метрик
     collector.collectAndWrite();
 
-    Logger::getInstance().logInfo("Example completed, metrics written to metrics_output.txt");
+    METRICS_LOG_INFO("Example completed, metrics written to metrics_output.txt");
     return 0;
 }
\ No newline at end of file
@@ -1,13 +1,25 @@
 #include "metrics_library.h"
+#include "process_metrics.h"
 #include <utility>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <limits>
 #include <stdexcept>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// ================= Metric =================
+void Metric::collect(MetricSample &sample) {
+    sample.name = getName();
+    sample.type = MetricType::Text;
+    sample.text = getValueAsString();
+    reset();
+}
 
 // ================= Gauge =================
-Gauge::Gauge(const std::string &name) : name_(name), value_(0.0) {}
+Gauge::Gauge(const std::string &name, int precision) : name_(name), precision_(precision), value_(0.0) {}
 
 void Gauge::update(double value) {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -19,10 +31,9 @@ std::string Gauge::getName() const {
 }
 
 std::string Gauge::getValueAsString() const {
+    char buffer[kMaxValueLength];
     std::lock_guard<std::mutex> lock(mutex_);
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(2) << value_;
-    return ss.str();
+    return std::string(buffer, formatGauge(value_, precision_, buffer));
 }
 
 void Gauge::reset() {
@@ -30,6 +41,15 @@ void Gauge::reset() {
     value_ = 0.0;
 }
 
+void Gauge::collect(MetricSample &sample) {
+    sample.name = name_;
+    sample.type = MetricType::Gauge;
+    sample.precision = precision_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample.gauge = value_;
+    value_ = 0.0;
+}
+
 // ================= Counter =================
 Counter::Counter(const std::string &name) : name_(name), value_(0) {}
 
@@ -43,8 +63,9 @@ std::string Counter::getName() const {
 }
 
 std::string Counter::getValueAsString() const {
+    char buffer[kMaxValueLength];
     std::lock_guard<std::mutex> lock(mutex_);
-    return std::to_string(value_);
+    return std::string(buffer, formatCounter(value_, buffer));
 }
 
 void Counter::reset() {
@@ -52,16 +73,80 @@ void Counter::reset() {
     value_ = 0;
 }
 
+void Counter::collect(MetricSample &sample) {
+    sample.name = name_;
+    sample.type = MetricType::Counter;
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample.counter = value_;
+    value_ = 0;
+}
+
+// ================= Histogram =================
+Histogram::Histogram(const std::string &name, std::vector<double> bounds) : name_(name) {
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    counts_.assign(bounds.size() + 1, 0);
+    bounds_ = std::make_shared<const std::vector<double>>(std::move(bounds));
+}
+
+void Histogram::observe(double value) {
+    // Корзина i содержит значения из (bounds[i - 1], bounds[i]]
+    auto bucket = std::lower_bound(bounds_->begin(), bounds_->end(), value) - bounds_->begin();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++counts_[static_cast<std::size_t>(bucket)];
+    ++count_;
+    sum_ += value;
+}
+
+std::string Histogram::getName() const {
+    return name_;
+}
+
+std::string Histogram::getValueAsString() const {
+    HistogramValue value;
+    value.bounds = bounds_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        value.counts = counts_;
+        value.count = count_;
+        value.sum = sum_;
+    }
+    std::string result;
+    appendHistogram(result, value);
+    return result;
+}
+
+void Histogram::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0.0;
+}
+
+void Histogram::collect(MetricSample &sample) {
+    sample.name = name_;
+    sample.type = MetricType::Histogram;
+    sample.histogram.bounds = bounds_;
+    sample.histogram.counts.resize(counts_.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::copy(counts_.begin(), counts_.end(), sample.histogram.counts.begin());
+    std::fill(counts_.begin(), counts_.end(), 0);
+    sample.histogram.count = count_;
+    sample.histogram.sum = sum_;
+    count_ = 0;
+    sum_ = 0.0;
+}
+
 // ================= ThreadSafeQueue =================
-// Добавляет набор метрик в очередь и уведомляет ожидающий поток
-void ThreadSafeQueue::push(const std::vector<std::pair<std::string, std::string>> &data) {
+// Добавляет снимок в очередь и уведомляет ожидающий поток
+void ThreadSafeQueue::push(Item data) {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(data);
+    queue_.push(std::move(data));
     cond_var_.notify_one();
 }
 
 // Пытается извлечь элемент из очереди без ожидания; возвращает true, если удалось
-bool ThreadSafeQueue::tryPop(std::vector<std::pair<std::string, std::string>> &data) {
+bool ThreadSafeQueue::tryPop(Item &data) {
     std::unique_lock<std::mutex> lock(mutex_);
     if (queue_.empty()) {
         return false;
@@ -72,7 +157,7 @@ bool ThreadSafeQueue::tryPop(std::vector<std::pair<std::string, std::string>> &d
 }
 
 // Ожидает появления данных в очереди и извлекает их; если очередь остановлена и пуста — возвращает управление
-void ThreadSafeQueue::waitAndPop(std::vector<std::pair<std::string, std::string>> &data) {
+void ThreadSafeQueue::waitAndPop(Item &data) {
     std::unique_lock<std::mutex> lock(mutex_);
     cond_var_.wait(lock, [this]{ return !queue_.empty() || stopped_; });
     if (queue_.empty() && stopped_) {
@@ -82,6 +167,28 @@ void ThreadSafeQueue::waitAndPop(std::vector<std::pair<std::string, std::string>
     queue_.pop();
 }
 
+// Ожидает данные не дольше deadline; возвращает true, если элемент извлечен
+bool ThreadSafeQueue::waitAndPopUntil(Item &data, std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_var_.wait_until(lock, deadline, [this]{ return !queue_.empty() || stopped_; });
+    if (queue_.empty()) {
+        return false;
+    }
+    data = std::move(queue_.front());
+    queue_.pop();
+    return true;
+}
+
+bool ThreadSafeQueue::isDrained() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stopped_ && queue_.empty();
+}
+
+std::size_t ThreadSafeQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
 // Останавливает очередь и пробуждает все ожидающие потоки
 void ThreadSafeQueue::stop() {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -90,57 +197,307 @@ void ThreadSafeQueue::stop() {
 }
 
 // ================= MetricsWriter =================
-MetricsWriter::MetricsWriter(const std::string &filename)
-    : filename_(filename), running_(true) {
-    writer_thread_ = std::thread(&MetricsWriter::run, this);
+MetricsWriter::MetricsWriter(const std::string &filename, const WriterOptions &options)
+    : MetricsWriter(filename, makeEncoder(options.format, options.utc_timestamps, options.binary_block_rows), options) {}
+
+MetricsWriter::MetricsWriter(const std::string &filename, std::unique_ptr<Encoder> encoder, const WriterOptions &options)
+    : filename_(filename), options_(options),
+      backend_(makeFileBackend(options.backend, filename, options.flush_bytes, options.mmap_extent)),
+      encoder_(std::move(encoder)),
+      executor_(options.executor != nullptr ? options.executor : &IoExecutor::shared()),
+      clock_(options.clock != nullptr ? options.clock : &Clock::system()) {
+    buffer_.reserve(options_.flush_bytes + 4096);
+    beginFile();
+    if (rotationEnabled()) {
+        archiver_ = std::make_unique<SegmentArchiver>(filename_, options_.retention, options_.compress_rotated);
+        next_rotation_ = nextRotationTime(clock_->now());
+    }
+    executor_->attach(*this, options_.priority);
 }
 
 MetricsWriter::~MetricsWriter() {
-    running_ = false;
-    queue_.stop();
-    if (writer_thread_.joinable()) {
-        writer_thread_.join();
+    executor_->detach(*this);
+    // Исполнитель больше не обращается к объекту: остаток очереди дописывается здесь
+    service(clock_->steadyNow());
+    encoder_->finish(buffer_);
+    flushBuffer(true);
+    if (options_.fsync_interval.count() > 0) {
+        syncFile(true);
     }
 }
 
-// Передает набор метрик в очередь на запись
+// Передает снимок в очередь на запись.
+// Пустой указатель в очереди служит маркером запроса flush(), поэтому пустые снимки не передаются.
+void MetricsWriter::publish(std::shared_ptr<const Snapshot> snapshot) {
+    if (!snapshot || snapshot->samples.empty()) {
+        return;
+    }
+    queue_.push(std::move(snapshot));
+    executor_->wake(*this);
+}
+
+void MetricsWriter::write(Snapshot snapshot) {
+    if (!snapshot.captured()) {
+        snapshot.captured_at = clock_->now();
+        snapshot.captured_steady = clock_->steadyNow();
+    }
+    publish(std::make_shared<const Snapshot>(std::move(snapshot)));
+}
+
 void MetricsWriter::write(const std::vector<std::pair<std::string, std::string>> &metrics) {
-    queue_.push(metrics);
+    Snapshot snapshot;
+    snapshot.samples.reserve(metrics.size());
+    for (const auto &[name, value] : metrics) {
+        MetricSample sample;
+        sample.name = name;
+        sample.text = value;
+        snapshot.samples.push_back(std::move(sample));
+    }
+    write(std::move(snapshot));
+}
+
+void MetricsWriter::flush() {
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    std::uint64_t ticket = ++flush_requested_;
+    queue_.push(nullptr);
+    executor_->wake(*this, IoPriority::High);
+    flush_cv_.wait(lock, [this, ticket]{ return flush_done_ >= ticket; });
+}
+
+WriterStats MetricsWriter::getStats() const {
+    WriterStats stats;
+    stats.lines = lines_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.rotations = rotations_.load(std::memory_order_relaxed);
+    stats.stalls = stalls_.load(std::memory_order_relaxed);
+    stats.queued = queue_.size();
+    std::lock_guard<std::mutex> lock(backend_mutex_);
+    stats.write_calls = closed_write_calls_ + backend_->writeCalls();
+    stats.sync_calls = closed_sync_calls_ + backend_->syncCalls();
+    stats.errors = closed_errors_ + backend_->errors();
+    return stats;
 }
 
-// Основной цикл записи: извлекает метрики из очереди и сохраняет их в файл с временной меткой
-void MetricsWriter::run() {
-    std::ofstream file(filename_, std::ios::app);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file: " + filename_);
+SinkStats MetricsWriter::sinkStats() const {
+    WriterStats writer = getStats();
+    SinkStats stats;
+    stats.queued = writer.queued;
+    stats.bytes = writer.bytes;
+    stats.errors = writer.errors;
+    stats.writes = appends_.load(std::memory_order_relaxed);
+    stats.write_ns = append_ns_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MetricsWriter::beginFile() {
+    encoder_->begin(buffer_, backend_->dataSize() == 0 && buffer_.empty());
+}
+
+void MetricsWriter::appendLine(const Snapshot &snapshot) {
+    lines_.fetch_add(1, std::memory_order_relaxed);
+    if (options_.durable_latency && snapshot.captured()) {
+        buffered_captures_.push_back(snapshot.captured_steady);
     }
-    while (running_) {
-        std::vector<std::pair<std::string, std::string>> metrics;
-        queue_.waitAndPop(metrics);
-        if (metrics.empty() && queue_.tryPop(metrics)) {
-            continue;
+    encoder_->encode(snapshot, snapshot.captureTime(clock_->now()), buffer_);
+}
+
+bool MetricsWriter::flushBuffer(bool wait) {
+    if (buffer_.empty()) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::size_t written = backend_->append(buffer_.data(), buffer_.size());
+    while (wait && written < buffer_.size()) {
+        backend_->drain();
+        written += backend_->append(buffer_.data() + written, buffer_.size() - written);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    appends_.fetch_add(1, std::memory_order_relaxed);
+    append_ns_.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    bytes_.fetch_add(written, std::memory_order_relaxed);
+    unsynced_ = unsynced_ || written > 0;
+    if (written < buffer_.size()) {
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        buffer_.erase(0, written);
+        return false;
+    }
+    buffer_.clear();
+    // Пока кодировщик держит незакрытый блок, его строк еще нет в файле: задержка учитывается при записи блока
+    if (!buffered_captures_.empty() && !encoder_->hasPending()) {
+        if (options_.fsync_interval.count() > 0) {
+            unsynced_captures_.insert(unsynced_captures_.end(), buffered_captures_.begin(), buffered_captures_.end());
+            buffered_captures_.clear();
+        } else {
+            observeDurable(buffered_captures_);
         }
-        if (!metrics.empty()) {
-            auto now = std::chrono::system_clock::now();
-            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-            auto timer = std::chrono::system_clock::to_time_t(now);
-            std::stringstream ss;
-            ss << std::put_time(std::localtime(&timer), "%Y-%m-%d %H:%M:%S");
-            ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-            file << ss.str();
-            for (const auto &[name, value] : metrics) {
-                file << " \"" << name << "\" " << value;
+    }
+    return true;
+}
+
+void MetricsWriter::observeDurable(std::vector<std::chrono::steady_clock::time_point> &captures) {
+    auto now = clock_->steadyNow();
+    for (auto captured : captures) {
+        options_.durable_latency->observe(std::chrono::duration<double, std::milli>(now - captured).count());
+    }
+    captures.clear();
+}
+
+bool MetricsWriter::syncFile(bool wait) {
+    if (!unsynced_) {
+        return true;
+    }
+    while (!backend_->sync()) {
+        if (!wait) {
+            return false;
+        }
+        backend_->drain();
+    }
+    unsynced_ = false;
+    if (!unsynced_captures_.empty()) {
+        observeDurable(unsynced_captures_);
+    }
+    return true;
+}
+
+bool MetricsWriter::rotationEnabled() const {
+    return options_.rotate_bytes > 0 || options_.rotate_interval.count() > 0;
+}
+
+std::chrono::system_clock::time_point MetricsWriter::nextRotationTime(std::chrono::system_clock::time_point now) const {
+    if (options_.rotate_interval.count() <= 0) {
+        return std::chrono::system_clock::time_point::max();
+    }
+    auto since_epoch = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+    auto periods = since_epoch / options_.rotate_interval;
+    return std::chrono::system_clock::time_point(options_.rotate_interval * (periods + 1));
+}
+
+void MetricsWriter::rotate(std::chrono::system_clock::time_point now) {
+    // Все данные периода должны попасть в закрываемый файл, поэтому здесь запись дожидается бэкенда
+    encoder_->finish(buffer_);
+    flushBuffer(true);
+    if (options_.fsync_interval.count() > 0) {
+        syncFile(true);
+    }
+    next_rotation_ = nextRotationTime(now);
+    if (backend_->dataSize() == 0) {
+        return;
+    }
+    backend_->drain();
+
+    // Открытый файл продолжает писаться и после переименования, поэтому при любой ошибке
+    // запись остается в прежнем бэкенде, а ротация повторится на следующей границе
+    std::string segment = SegmentArchiver::segmentName(filename_, now);
+    if (std::rename(filename_.c_str(), segment.c_str()) != 0) {
+        std::lock_guard<std::mutex> lock(backend_mutex_);
+        ++closed_errors_;
+        Logger::getInstance().logError("MetricsWriter: rotating " + filename_ + " failed: " + std::strerror(errno));
+        return;
+    }
+    std::unique_ptr<FileBackend> next;
+    try {
+        next = makeFileBackend(options_.backend, filename_, options_.flush_bytes, options_.mmap_extent);
+    } catch (const std::exception &e) {
+        std::lock_guard<std::mutex> lock(backend_mutex_);
+        ++closed_errors_;
+        Logger::getInstance().logError("MetricsWriter: reopening " + filename_ + " after rotation failed: " + e.what());
+        if (std::rename(segment.c_str(), filename_.c_str()) != 0) {
+            Logger::getInstance().logError("MetricsWriter: restoring " + filename_ + " failed, writing to " + segment +
+                                           ": " + std::strerror(errno));
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(backend_mutex_);
+        closed_write_calls_ += backend_->writeCalls();
+        closed_sync_calls_ += backend_->syncCalls();
+        closed_errors_ += backend_->errors();
+        backend_ = std::move(next);
+    }
+    rotations_.fetch_add(1, std::memory_order_relaxed);
+    archiver_->submit(segment);
+    beginFile();
+}
+
+// Извлекает все снимки, накопившиеся в очереди, накапливает строки в буфере
+// и сбрасывает их в файл по достижении порога размера или времени
+// Время берется из часов писателя (WriterOptions::clock), а не от исполнителя
+std::chrono::steady_clock::time_point MetricsWriter::service(std::chrono::steady_clock::time_point /*now*/) {
+    const auto never = std::chrono::steady_clock::time_point::max();
+
+    ThreadSafeQueue::Item snapshot;
+    while (queue_.tryPop(snapshot)) {
+        if (!snapshot) {
+            // Маркер flush(): все, что было в очереди до него, уже в буфере
+            encoder_->finish(buffer_);
+            flushBuffer(true);
+            flush_deadline_ = never;
+            retry_deadline_ = never;
+            if (options_.fsync_interval.count() > 0) {
+                syncFile(true);
+                sync_deadline_ = never;
             }
-            file << '\n';
-            file.flush();
+            backend_->drain();
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            ++flush_done_;
+            flush_cv_.notify_all();
+            continue;
+        }
+        // Граница сегмента определяется временем сбора: снимок попадает в файл своего периода
+        auto captured_at = snapshot->captureTime(clock_->now());
+        if (rotationEnabled() && captured_at >= next_rotation_) {
+            rotate(captured_at);
+            flush_deadline_ = never;
+        }
+        auto now = clock_->steadyNow();
+        if (flush_deadline_ == never && options_.flush_interval.count() > 0) {
+            flush_deadline_ = now + options_.flush_interval;
         }
+        appendLine(*snapshot);
+        checkThresholds(now);
+    }
+    checkThresholds(clock_->steadyNow());
+    return clock_->wakeTime(std::min({flush_deadline_, sync_deadline_, retry_deadline_}));
+}
+
+void MetricsWriter::checkThresholds(std::chrono::steady_clock::time_point now) {
+    const auto never = std::chrono::steady_clock::time_point::max();
+
+    // По размеру сбрасываются только закодированные данные; по времени закрывается и незаполненный блок
+    bool size_due = !buffer_.empty() && buffer_.size() >= options_.flush_bytes;
+    bool time_due = now >= flush_deadline_ && (!buffer_.empty() || encoder_->hasPending());
+    bool retry_due = now >= retry_deadline_;
+    if (time_due) {
+        encoder_->finish(buffer_);
+    }
+    if (size_due || time_due || retry_due) {
+        retry_deadline_ = flushBuffer() ? never : now + kStallRetryDelay;
+        if (!encoder_->hasPending()) {
+            flush_deadline_ = never;
+        }
+        if (options_.fsync_interval.count() > 0 && sync_deadline_ == never) {
+            sync_deadline_ = now + options_.fsync_interval;
+        }
+    }
+    if (now >= sync_deadline_) {
+        sync_deadline_ = syncFile() ? never : now + kStallRetryDelay;
+    }
+    if (options_.rotate_bytes > 0 && backend_->size() + buffer_.size() >= options_.rotate_bytes) {
+        rotate(clock_->now());
+        flush_deadline_ = never;
     }
-    file.close();
 }
 
 // ================= MetricsCollector =================
-MetricsCollector::MetricsCollector(const std::string &filename)
-    : writer_(filename) {}
+MetricsCollector::MetricsCollector(Clock &clock) : clock_(&clock) {}
+
+MetricsCollector::MetricsCollector(const std::string &filename, const WriterOptions &options)
+    : clock_(options.clock != nullptr ? options.clock : &Clock::system()) {
+    sinks_.push_back(std::make_shared<MetricsWriter>(filename, options));
+}
+
+MetricsCollector::~MetricsCollector() = default;
 
 // Добавляет новую метрику в коллекцию для последующего сбора
 void MetricsCollector::addMetric(std::shared_ptr<Metric> metric) {
@@ -148,15 +505,145 @@ void MetricsCollector::addMetric(std::shared_ptr<Metric> metric) {
     metrics_.push_back(metric);
 }
 
-// Собирает значения всех метрик, сбрасывает их и отправляет на запись
+void MetricsCollector::addSink(std::shared_ptr<Sink> sink) {
+    std::lock_guard<std::mutex> lock(sinks_mutex_);
+    sinks_.push_back(std::move(sink));
+}
+
+void MetricsCollector::enableSelfMetrics(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (self_metrics_) {
+        return;
+    }
+    auto self = std::make_unique<SelfMetrics>();
+    self->collect_duration = std::make_shared<Gauge>(prefix + "collect_duration_ms", 3);
+    self->snapshot_samples = std::make_shared<Gauge>(prefix + "snapshot_samples", 0);
+    self->queue_depth = std::make_shared<Gauge>(prefix + "queue_depth", 0);
+    self->write_latency = std::make_shared<Gauge>(prefix + "write_latency_ms", 3);
+    self->bytes_written = std::make_shared<Counter>(prefix + "bytes_written");
+    self->dropped_snapshots = std::make_shared<Counter>(prefix + "dropped_snapshots");
+    self->writer_errors = std::make_shared<Counter>(prefix + "writer_errors");
+    metrics_.insert(metrics_.end(), {self->collect_duration, self->snapshot_samples, self->queue_depth,
+                                     self->write_latency, self->bytes_written, self->dropped_snapshots,
+                                     self->writer_errors});
+    self_metrics_ = std::move(self);
+}
+
+void MetricsCollector::enableProcessMetrics(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (process_metrics_) {
+        return;
+    }
+    process_metrics_ = std::make_unique<ProcessMetrics>(prefix);
+    auto metrics = process_metrics_->metrics();
+    metrics_.insert(metrics_.end(), metrics.begin(), metrics.end());
+}
+
+void MetricsCollector::updateSelfMetrics(const SinkStats &total) {
+    SelfMetrics &self = *self_metrics_;
+    // Счетчики получателей монотонны; приращение за интервал ограничено диапазоном Counter
+    auto delta = [](std::uint64_t now, std::uint64_t last) {
+        return static_cast<int>(std::min<std::uint64_t>(now - last, std::numeric_limits<int>::max()));
+    };
+    self.collect_duration->update(static_cast<double>(self.collect_ns.load(std::memory_order_relaxed)) / 1e6);
+    self.snapshot_samples->update(static_cast<double>(self.samples.load(std::memory_order_relaxed)));
+    self.queue_depth->update(static_cast<double>(total.queued));
+    std::uint64_t writes = total.writes - self.last.writes;
+    self.write_latency->update(writes > 0 ? static_cast<double>(total.write_ns - self.last.write_ns) / writes / 1e6 : 0.0);
+    self.bytes_written->increment(delta(total.bytes, self.last.bytes));
+    self.dropped_snapshots->increment(delta(total.dropped, self.last.dropped));
+    self.writer_errors->increment(delta(total.errors, self.last.errors));
+    self.last = total;
+}
+
+// Собирает значения всех метрик, сбрасывает их и передает один снимок всем получателям
 void MetricsCollector::collectAndWrite() {
-    std::vector<std::pair<std::string, std::string>> snapshot;
+    auto start = clock_->steadyNow();
+    auto captured_at = clock_->now();
+    SinkStats total;
+    bool self_enabled;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        self_enabled = self_metrics_ != nullptr;
+    }
+    if (self_enabled) {
+        std::lock_guard<std::mutex> lock(sinks_mutex_);
+        for (const auto &sink : sinks_) {
+            SinkStats stats = sink->sinkStats();
+            total.queued += stats.queued;
+            total.bytes += stats.bytes;
+            total.dropped += stats.dropped;
+            total.errors += stats.errors;
+            total.writes += stats.writes;
+            total.write_ns += stats.write_ns;
+        }
+    }
+
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->captured_at = captured_at;
+    snapshot->captured_steady = start;
+    SelfMetrics *self = nullptr;
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto &metric : metrics_) {
-            snapshot.emplace_back(metric->getName(), metric->getValueAsString());
-            metric->reset();
+        if (self_enabled) {
+            self = self_metrics_.get();
+            updateSelfMetrics(total);
+        }
+        if (process_metrics_) {
+            process_metrics_->update();
+        }
+        snapshot->samples.resize(metrics_.size());
+        for (std::size_t i = 0; i < metrics_.size(); ++i) {
+            metrics_[i]->collect(snapshot->samples[i]);
+        }
+    }
+    // Получатели не блокируются в publish(), поэтому список удерживается на время передачи
+    std::lock_guard<std::mutex> lock(sinks_mutex_);
+    std::uint32_t used = 0;
+    for (const auto &sink : sinks_) {
+        std::uint32_t encodings = sink->sharedEncodings();
+        snapshot->shared_encodings |= used & encodings;
+        used |= encodings;
+    }
+    for (const auto &sink : sinks_) {
+        sink->publish(snapshot);
+    }
+    if (self != nullptr) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_->steadyNow() - start);
+        self->collect_ns.store(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        self->samples.store(snapshot->samples.size(), std::memory_order_relaxed);
+    }
+}
+
+// ================= CollectionScheduler =================
+CollectionScheduler::CollectionScheduler(MetricsCollector &collector, std::chrono::nanoseconds interval, Clock &clock)
+    : collector_(collector), interval_(interval), clock_(clock) {
+    if (interval_.count() <= 0) {
+        throw std::runtime_error("CollectionScheduler: interval must be positive");
+    }
+}
+
+void CollectionScheduler::onTick(std::function<void(std::size_t)> callback) {
+    on_tick_ = std::move(callback);
+}
+
+std::size_t CollectionScheduler::runFor(std::chrono::nanoseconds duration) {
+    const auto start = clock_.steadyNow();
+    const auto end = start + duration;
+    std::size_t ticks = 0;
+    for (auto next = start + interval_; next <= end; next += interval_) {
+        clock_.sleepUntil(next);
+        if (on_tick_) {
+            on_tick_(ticks_);
+        }
+        collector_.collectAndWrite();
+        ++ticks_;
+        ++ticks;
+        // Сбор занял больше интервала: следующий такт — в ближайший еще не прошедший срок
+        auto now = clock_.steadyNow();
+        while (next + interval_ < now) {
+            next += interval_;
         }
     }
-    writer_.write(snapshot);
+    return ticks;
 }
@@ -0,0 +1,96 @@
+#include "metrics_reader.h"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <string>
+
+// Выводит справку по использованию утилиты
+void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " [--utc] FILE METRIC [FROM [TO]]\n"
+              << "  FROM, TO - milliseconds since epoch or \"YYYY-MM-DD HH:MM:SS[.mmm]\"\n"
+              << "  --utc    - text file timestamps and time arguments are in UTC\n";
+}
+
+// Разбирает границу диапазона: число миллисекунд или метку времени
+bool parseTimeArgument(const std::string &argument, bool utc, std::int64_t &value) {
+    if (!argument.empty() && argument.find_first_not_of("0123456789") == std::string::npos) {
+        // Число вне диапазона int64 - такая же ошибка аргумента, как и неверный формат
+        auto result = std::from_chars(argument.data(), argument.data() + argument.size(), value);
+        return result.ec == std::errc() && result.ptr == argument.data() + argument.size();
+    }
+    return MetricsReader::parseTimestamp(argument.data(), argument.size(), utc, value);
+}
+
+// Форматирует метку времени так же, как она записана в текстовом файле
+std::string formatTimestamp(std::int64_t timestamp_ms, bool utc) {
+    std::time_t seconds = static_cast<std::time_t>(timestamp_ms / 1000);
+    std::tm tm;
+    if (utc) {
+        gmtime_r(&seconds, &tm);
+    } else {
+        localtime_r(&seconds, &tm);
+    }
+    char buffer[32];
+    std::size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%03d", static_cast<int>(timestamp_ms % 1000));
+    return buffer;
+}
+
+int main(int argc, char **argv) {
+    int arg = 1;
+    ReaderOptions options;
+    if (arg < argc && std::strcmp(argv[arg], "--utc") == 0) {
+        options.utc_timestamps = true;
+        ++arg;
+    }
+    if (argc - arg < 2 || argc - arg > 4) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    const std::string filename = argv[arg];
+    const std::string metric = argv[arg + 1];
+    std::int64_t from = std::numeric_limits<std::int64_t>::min();
+    std::int64_t to = std::numeric_limits<std::int64_t>::max();
+    if ((argc - arg > 2 && !parseTimeArgument(argv[arg + 2], options.utc_timestamps, from)) ||
+        (argc - arg > 3 && !parseTimeArgument(argv[arg + 3], options.utc_timestamps, to))) {
+        std::cerr << "Invalid time range\n";
+        return 2;
+    }
+
+    try {
+        MetricsReader reader(filename, options);
+        auto started = std::chrono::steady_clock::now();
+        auto points = reader.query(metric, from, to);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+        for (const auto &point : points) {
+            std::cout << formatTimestamp(point.timestamp_ms, options.utc_timestamps) << ' ';
+            switch (point.sample.type) {
+            case MetricType::Gauge: {
+                char value[32];
+                std::snprintf(value, sizeof(value), "%.15g", point.sample.gauge);
+                std::cout << value;
+                break;
+            }
+            case MetricType::Counter:
+                std::cout << point.sample.counter;
+                break;
+            case MetricType::Text:
+            case MetricType::Histogram:
+                std::cout << point.sample.text;
+                break;
+            }
+            std::cout << '\n';
+        }
+        std::cerr << points.size() << " points, " << reader.lastScannedBytes() << " bytes scanned, "
+                  << reader.indexSize() << " index entries, " << elapsed.count() << " us\n";
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,490 @@
+#include "metrics_reader.h"
+#include "file_backends.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'M', 'T', 'R', 'X', 'I', 'D', 'X', '1'};
+
+// Длина метки времени YYYY-MM-DD HH:MM:SS.mmm в начале строки текстового формата
+constexpr std::size_t kTimestampLength = 23;
+constexpr std::size_t kSecondsLength = 19;
+
+bool parseDigits(const char *text, int count, int &value) {
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Количество дней от 1970-01-01 до указанной даты григорианского календаря
+std::int64_t daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+template <typename T>
+void appendRaw(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readRaw(std::ifstream &in, T &value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+// Ищет значение метрики name в строке текстового формата: ... "name" value ...
+bool findTextValue(const char *line, std::size_t length, const std::string &needle, std::string &value) {
+    const char *end = line + length;
+    const char *found = std::search(line, end, needle.begin(), needle.end());
+    if (found == end) {
+        return false;
+    }
+    const char *begin = found + needle.size();
+    const char *stop = std::find(begin, end, ' ');
+    value.assign(begin, stop);
+    return true;
+}
+
+// Является ли строка заголовком Csv/Tsv: timestamp<разделитель>...
+bool isHeaderLine(const char *line, std::size_t length, char delimiter) {
+    return length > 9 && std::memcmp(line, "timestamp", 9) == 0 && line[9] == delimiter;
+}
+
+// Разбивает строку Csv (кавычки по RFC 4180) или Tsv (экранирование \t, \n, \r, \\) на поля
+void splitDelimited(const char *line, std::size_t length, char delimiter, std::vector<std::string> &fields) {
+    fields.clear();
+    fields.emplace_back();
+    bool quoted = false;
+    for (std::size_t i = 0; i < length; ++i) {
+        char c = line[i];
+        if (delimiter == ',' && c == '"') {
+            if (quoted && i + 1 < length && line[i + 1] == '"') {
+                fields.back() += '"';
+                ++i;
+            } else {
+                quoted = !quoted;
+            }
+        } else if (delimiter == '\t' && c == '\\' && i + 1 < length) {
+            char next = line[++i];
+            fields.back() += next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+        } else if (c == delimiter && !quoted) {
+            fields.emplace_back();
+        } else {
+            fields.back() += c;
+        }
+    }
+}
+
+// Номер колонки метрики name в строке заголовка (0 — метрики в заголовке нет)
+std::size_t headerColumn(const char *line, std::size_t length, char delimiter, const std::string &name,
+                         std::vector<std::string> &fields) {
+    splitDelimited(line, length, delimiter, fields);
+    auto it = std::find(fields.begin() + 1, fields.end(), name);
+    return it == fields.end() ? 0 : static_cast<std::size_t>(it - fields.begin());
+}
+
+} // namespace
+
+// ================= MetricsReader =================
+MetricsReader::MetricsReader(const std::string &filename, const ReaderOptions &options)
+    : filename_(filename), options_(options) {
+    options_.index_stride = std::max<std::size_t>(options_.index_stride, 256);
+    int fd = ::open(filename_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file: " + filename_ + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("Error reading file size: " + filename_ + ": " + std::strerror(err));
+    }
+    inode_ = static_cast<std::uint64_t>(st.st_ino);
+    map_size_ = static_cast<std::size_t>(st.st_size);
+    if (map_size_ > 0) {
+        void *map = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Error mapping file: " + filename_ + ": " + std::strerror(err));
+        }
+        map_ = static_cast<char *>(map);
+        ::madvise(map_, map_size_, MADV_RANDOM);
+    }
+    ::close(fd);
+
+    data_ = map_;
+    size_ = map_size_;
+    if (size_ >= sizeof(MmapFileHeader) && std::memcmp(map_, MmapFileHeader::kMagic, sizeof(MmapFileHeader::kMagic)) == 0) {
+        // Файл WriterBackend::Mmap: данные после заголовка, длина — committed
+        const auto *header = reinterpret_cast<const MmapFileHeader *>(map_);
+        std::uint64_t committed = __atomic_load_n(&header->committed, __ATOMIC_ACQUIRE);
+        data_ = map_ + sizeof(MmapFileHeader);
+        size_ = static_cast<std::size_t>(std::min<std::uint64_t>(committed, map_size_ - sizeof(MmapFileHeader)));
+    }
+
+    if (BinaryDecoder::hasMagic(data_, size_)) {
+        format_ = Format::Binary;
+        buildBinaryIndex();
+    } else {
+        // Файлы Csv/Tsv начинаются со строки заголовка
+        if (isHeaderLine(data_, size_, ',')) {
+            format_ = Format::Csv;
+        } else if (isHeaderLine(data_, size_, '\t')) {
+            format_ = Format::Tsv;
+        } else {
+            format_ = Format::Text;
+        }
+        buildTextIndex();
+    }
+}
+
+MetricsReader::~MetricsReader() {
+    if (map_ != nullptr) {
+        ::munmap(map_, map_size_);
+    }
+}
+
+std::size_t MetricsReader::indexSize() const {
+    return format_ == Format::Binary ? block_index_.size() : text_index_.size();
+}
+
+bool MetricsReader::parseTimestamp(const char *text, std::size_t size, bool utc, std::int64_t &timestamp_ms) {
+    if (size < kSecondsLength || text[4] != '-' || text[7] != '-' || text[10] != ' ' || text[13] != ':' || text[16] != ':') {
+        return false;
+    }
+    int year, month, day, hour, minute, second, millis = 0;
+    if (!parseDigits(text, 4, year) || !parseDigits(text + 5, 2, month) || !parseDigits(text + 8, 2, day) ||
+        !parseDigits(text + 11, 2, hour) || !parseDigits(text + 14, 2, minute) || !parseDigits(text + 17, 2, second)) {
+        return false;
+    }
+    if (size >= kTimestampLength && text[kSecondsLength] == '.' && !parseDigits(text + 20, 3, millis)) {
+        return false;
+    }
+
+    std::int64_t seconds;
+    if (utc) {
+        seconds = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400 +
+                  hour * 3600 + minute * 60 + second;
+    } else {
+        std::tm tm{};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_sec = second;
+        tm.tm_isdst = -1;
+        seconds = static_cast<std::int64_t>(std::mktime(&tm));
+    }
+    timestamp_ms = seconds * 1000 + millis;
+    return true;
+}
+
+// ----- Текстовый формат -----
+
+bool MetricsReader::loadSidecar(std::uint64_t &indexed_length) {
+    std::ifstream in(filename_ + ".idx", std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    char magic[sizeof(kIndexMagic)];
+    std::uint64_t inode, stride, count;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !readRaw(in, inode) || !readRaw(in, stride) || !readRaw(in, indexed_length) || !readRaw(in, count) ||
+        inode != inode_ || stride != options_.index_stride || indexed_length > size_ || count > size_) {
+        return false;
+    }
+    std::vector<TextIndexEntry> entries(count);
+    for (auto &entry : entries) {
+        if (!readRaw(in, entry.timestamp_ms) || !readRaw(in, entry.offset) || entry.offset >= indexed_length) {
+            return false;
+        }
+    }
+    // Файл мог быть перезаписан с тем же inode: последняя точка должна совпадать с данными
+    if (!entries.empty()) {
+        std::int64_t timestamp;
+        const TextIndexEntry &last = entries.back();
+        if (!parseTimestamp(data_ + last.offset, size_ - last.offset, options_.utc_timestamps, timestamp) ||
+            timestamp != last.timestamp_ms) {
+            return false;
+        }
+    }
+    text_index_ = std::move(entries);
+    return true;
+}
+
+// Записывает индекс во временный файл и атомарно заменяет им старый
+void MetricsReader::saveSidecar(std::uint64_t indexed_length) const {
+    std::string content(kIndexMagic, sizeof(kIndexMagic));
+    appendRaw(content, inode_);
+    appendRaw(content, static_cast<std::uint64_t>(options_.index_stride));
+    appendRaw(content, indexed_length);
+    appendRaw(content, static_cast<std::uint64_t>(text_index_.size()));
+    for (const auto &entry : text_index_) {
+        appendRaw(content, entry.timestamp_ms);
+        appendRaw(content, entry.offset);
+    }
+    const std::string path = filename_ + ".idx";
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open() || !out.write(content.data(), static_cast<std::streamsize>(content.size()))) {
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+    }
+}
+
+// Строит или дополняет разреженный индекс: читаются только строки на границах шага индекса
+void MetricsReader::buildTextIndex() {
+    const char *last_newline = size_ > 0 ? static_cast<const char *>(::memrchr(data_, '\n', size_)) : nullptr;
+    std::uint64_t complete = last_newline == nullptr ? 0 : static_cast<std::uint64_t>(last_newline - data_ + 1);
+
+    std::uint64_t indexed_length = 0;
+    if (!options_.use_sidecar || !loadSidecar(indexed_length)) {
+        text_index_.clear();
+        indexed_length = 0;
+    }
+    if (indexed_length == complete) {
+        return;
+    }
+
+    std::uint64_t next = text_index_.empty() ? 0 : text_index_.back().offset + options_.index_stride;
+    while (next < complete) {
+        std::uint64_t line = next;
+        if (line > 0 && data_[line - 1] != '\n') {
+            const void *newline = std::memchr(data_ + line, '\n', complete - line);
+            if (newline == nullptr) {
+                break;
+            }
+            line = static_cast<std::uint64_t>(static_cast<const char *>(newline) - data_ + 1);
+            if (line >= complete) {
+                break;
+            }
+        }
+        std::int64_t timestamp;
+        if (parseTimestamp(data_ + line, complete - line, options_.utc_timestamps, timestamp)) {
+            text_index_.push_back({timestamp, line});
+            next = line + options_.index_stride;
+        } else {
+            next = line + 1;
+        }
+    }
+    if (options_.use_sidecar) {
+        saveSidecar(complete);
+    }
+}
+
+std::size_t MetricsReader::findHeader(std::size_t position, char delimiter) const {
+    std::size_t line = position;
+    while (true) {
+        if (isHeaderLine(data_ + line, size_ - line, delimiter)) {
+            return line;
+        }
+        if (line < 2) {
+            return std::string::npos;
+        }
+        const void *newline = ::memrchr(data_, '\n', line - 1);
+        line = newline == nullptr ? 0 : static_cast<std::size_t>(static_cast<const char *>(newline) - data_ + 1);
+    }
+}
+
+std::vector<MetricPoint> MetricsReader::queryText(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const {
+    std::vector<MetricPoint> points;
+    // Начинаем с последней точки индекса, метка которой меньше from_ms
+    auto it = std::lower_bound(text_index_.begin(), text_index_.end(), from_ms,
+                               [](const TextIndexEntry &entry, std::int64_t value) { return entry.timestamp_ms < value; });
+    std::size_t position = it == text_index_.begin() ? 0 : static_cast<std::size_t>(std::prev(it)->offset);
+    std::size_t start = position;
+
+    const std::string needle = " \"" + name + "\" ";
+    const bool delimited = format_ == Format::Csv || format_ == Format::Tsv;
+    const char delimiter = format_ == Format::Tsv ? '\t' : ',';
+    std::vector<std::string> fields;
+    std::size_t column = 0; // Колонка метрики в действующем заголовке Csv/Tsv (0 — нет)
+    if (delimited) {
+        std::size_t header = findHeader(start, delimiter);
+        if (header != std::string::npos) {
+            const char *end = static_cast<const char *>(std::memchr(data_ + header, '\n', size_ - header));
+            if (end != nullptr) {
+                column = headerColumn(data_ + header, static_cast<std::size_t>(end - data_ - header), delimiter, name, fields);
+            }
+        }
+    }
+    char cached_prefix[kSecondsLength] = {};
+    std::int64_t cached_seconds_ms = 0;
+    std::string value;
+    while (position < size_) {
+        const char *line = data_ + position;
+        const void *newline = std::memchr(line, '\n', size_ - position);
+        if (newline == nullptr) {
+            break;
+        }
+        std::size_t length = static_cast<std::size_t>(static_cast<const char *>(newline) - line);
+        position += length + 1;
+        if (delimited && isHeaderLine(line, length, delimiter)) {
+            column = headerColumn(line, length, delimiter, name, fields);
+            continue;
+        }
+        if (length < kTimestampLength) {
+            continue;
+        }
+
+        // Разбор секундной части метки выполняется один раз на секунду
+        std::int64_t timestamp;
+        int millis;
+        if (std::memcmp(cached_prefix, line, kSecondsLength) == 0 && line[kSecondsLength] == '.' &&
+            parseDigits(line + 20, 3, millis)) {
+            timestamp = cached_seconds_ms + millis;
+        } else if (parseTimestamp(line, length, options_.utc_timestamps, timestamp)) {
+            std::memcpy(cached_prefix, line, kSecondsLength);
+            cached_seconds_ms = timestamp - timestamp % 1000;
+        } else {
+            continue;
+        }
+        if (timestamp > to_ms) {
+            break;
+        }
+        if (timestamp < from_ms) {
+            continue;
+        }
+        if (delimited) {
+            if (column == 0) {
+                continue;
+            }
+            splitDelimited(line + kTimestampLength, length - kTimestampLength, delimiter, fields);
+            if (fields.size() <= column) {
+                continue;
+            }
+            value = fields[column];
+        } else if (!findTextValue(line + kTimestampLength, length - kTimestampLength, needle, value)) {
+            continue;
+        }
+        MetricPoint point;
+        point.timestamp_ms = timestamp;
+        point.sample.name = name;
+        point.sample.type = MetricType::Text;
+        point.sample.text = value;
+        points.push_back(std::move(point));
+    }
+    last_scanned_ = position - start;
+    return points;
+}
+
+// ----- Двоичный формат -----
+
+// Проходит по записям, читая только заголовки блоков
+void MetricsReader::buildBinaryIndex() {
+    std::size_t offset = sizeof(kBinaryMagic);
+    while (offset < size_) {
+        char tag = data_[offset];
+        std::size_t position = offset + 1;
+        if (tag == kBinaryDictionaryTag) {
+            std::vector<BinaryColumn> dictionary;
+            if (!BinaryDecoder::readDictionary(data_, size_, position, dictionary)) {
+                break;
+            }
+            dictionaries_.push_back(std::move(dictionary));
+            offset = position;
+            continue;
+        }
+        std::uint64_t length, rows;
+        BlockIndexEntry entry;
+        if (tag != kBinaryBlockTag || dictionaries_.empty() ||
+            !BinaryDecoder::readVarint(data_, size_, position, length) || length > size_ - position ||
+            !BinaryDecoder::readBlockHeader(data_ + position, length, rows, entry.first_ts, entry.last_ts)) {
+            // Конец записанных данных (в том числе недописанный блок или заполненный нулями хвост)
+            break;
+        }
+        entry.offset = position;
+        entry.length = length;
+        entry.dictionary = dictionaries_.size() - 1;
+        block_index_.push_back(entry);
+        offset = position + length;
+    }
+}
+
+std::vector<MetricPoint> MetricsReader::queryBinary(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const {
+    std::vector<MetricPoint> points;
+    last_scanned_ = 0;
+    auto it = std::lower_bound(block_index_.begin(), block_index_.end(), from_ms,
+                               [](const BlockIndexEntry &entry, std::int64_t value) { return entry.last_ts < value; });
+
+    // Номер колонки метрики в каждом словаре (или -1, если ее там нет)
+    std::vector<long> column_in_dictionary(dictionaries_.size(), -2);
+    BinaryBlock block;
+    for (; it != block_index_.end() && it->first_ts <= to_ms; ++it) {
+        long &column = column_in_dictionary[it->dictionary];
+        if (column == -2) {
+            const auto &dictionary = dictionaries_[it->dictionary];
+            auto found = std::find_if(dictionary.begin(), dictionary.end(),
+                                      [&name](const BinaryColumn &c) { return c.name == name; });
+            column = found == dictionary.end() ? -1 : static_cast<long>(found - dictionary.begin());
+        }
+        if (column < 0) {
+            continue;
+        }
+        last_scanned_ += it->length;
+        if (!BinaryDecoder::decodeBlock(data_ + it->offset, it->length, dictionaries_[it->dictionary], block)) {
+            break;
+        }
+        const BinaryColumn &values = block.columns[static_cast<std::size_t>(column)];
+        for (std::size_t row = 0; row < block.timestamps.size(); ++row) {
+            std::int64_t timestamp = block.timestamps[row];
+            if (timestamp < from_ms || timestamp > to_ms) {
+                continue;
+            }
+            MetricPoint point;
+            point.timestamp_ms = timestamp;
+            point.sample.name = name;
+            point.sample.type = values.type;
+            switch (values.type) {
+            case MetricType::Gauge:
+                point.sample.gauge = values.gauges[row];
+                point.sample.precision = values.precision;
+                break;
+            case MetricType::Counter:
+                point.sample.counter = values.counters[row];
+                break;
+            case MetricType::Text:
+            case MetricType::Histogram:
+                point.sample.text = values.texts[row];
+                break;
+            }
+            points.push_back(std::move(point));
+        }
+    }
+    return points;
+}
+
+std::vector<MetricPoint> MetricsReader::query(const std::string &name, std::int64_t from_ms, std::int64_t to_ms) const {
+    if (format_ == Format::Binary) {
+        return queryBinary(name, from_ms, to_ms);
+    }
+    return queryText(name, from_ms, to_ms);
+}
@@ -0,0 +1,258 @@
+#include "otlp_encoder.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+// Типы полей protobuf
+constexpr unsigned kVarint = 0;
+constexpr unsigned kFixed64 = 1;
+constexpr unsigned kLengthDelimited = 2;
+
+// Номера полей opentelemetry/proto (metrics/v1, common/v1, resource/v1)
+constexpr unsigned kRequestResourceMetrics = 1; // ExportMetricsServiceRequest.resource_metrics
+constexpr unsigned kResourceMetricsResource = 1;
+constexpr unsigned kResourceMetricsScopeMetrics = 2;
+constexpr unsigned kResourceAttributes = 1;
+constexpr unsigned kScopeMetricsScope = 1;
+constexpr unsigned kScopeMetricsMetrics = 2;
+constexpr unsigned kScopeName = 1;
+constexpr unsigned kScopeVersion = 2;
+constexpr unsigned kKeyValueKey = 1;
+constexpr unsigned kKeyValueValue = 2;
+constexpr unsigned kAnyValueString = 1;
+constexpr unsigned kMetricName = 1;
+constexpr unsigned kMetricGauge = 5;
+constexpr unsigned kMetricSum = 7;
+constexpr unsigned kMetricHistogram = 9;
+constexpr unsigned kDataPoints = 1;              // Gauge, Sum и Histogram .data_points
+constexpr unsigned kAggregationTemporality = 2;  // Sum и Histogram .aggregation_temporality
+constexpr unsigned kSumIsMonotonic = 3;
+constexpr unsigned kPointStartTime = 2;
+constexpr unsigned kPointTime = 3;
+constexpr unsigned kNumberAsDouble = 4;
+constexpr unsigned kNumberAsInt = 6;
+constexpr unsigned kHistogramCount = 4;
+constexpr unsigned kHistogramSum = 5;
+constexpr unsigned kHistogramBucketCounts = 6;
+constexpr unsigned kHistogramExplicitBounds = 7;
+
+constexpr std::uint64_t kTemporalityDelta = 1;
+
+// Размер поля fixed64/double с тегом (все номера полей меньше 16, поэтому тег — один байт)
+constexpr std::size_t kFixed64Field = 1 + 8;
+// Размер поля varint со значением меньше 128 с тегом
+constexpr std::size_t kSmallVarintField = 1 + 1;
+
+std::size_t varintSize(std::uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+// Размер поля с длиной (строка или вложенное сообщение) с тегом
+std::size_t lengthFieldSize(std::size_t length) {
+    return 1 + varintSize(length) + length;
+}
+
+void appendVarint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void appendTag(std::string &out, unsigned field, unsigned type) {
+    out.push_back(static_cast<char>(field << 3 | type));
+}
+
+void appendFixed64(std::string &out, std::uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, sizeof(bytes));
+}
+
+void appendDouble(std::string &out, double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendFixed64(out, bits);
+}
+
+void appendFixed64Field(std::string &out, unsigned field, std::uint64_t value) {
+    appendTag(out, field, kFixed64);
+    appendFixed64(out, value);
+}
+
+void appendDoubleField(std::string &out, unsigned field, double value) {
+    appendTag(out, field, kFixed64);
+    appendDouble(out, value);
+}
+
+void appendVarintField(std::string &out, unsigned field, std::uint64_t value) {
+    appendTag(out, field, kVarint);
+    appendVarint(out, value);
+}
+
+// Дописывает тег и длину поля; содержимое дописывает вызывающий
+void appendLengthHeader(std::string &out, unsigned field, std::size_t length) {
+    appendTag(out, field, kLengthDelimited);
+    appendVarint(out, length);
+}
+
+void appendStringField(std::string &out, unsigned field, const std::string &value) {
+    appendLengthHeader(out, field, value.size());
+    out += value;
+}
+
+// KeyValue со строковым значением
+void appendAttribute(std::string &out, unsigned field, const std::string &key, const std::string &value) {
+    std::size_t any_value = lengthFieldSize(value.size());
+    appendLengthHeader(out, field, lengthFieldSize(key.size()) + lengthFieldSize(any_value));
+    appendStringField(out, kKeyValueKey, key);
+    appendLengthHeader(out, kKeyValueValue, any_value);
+    appendStringField(out, kAnyValueString, value);
+}
+
+bool parseNumber(const std::string &text, double &value) {
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+} // namespace
+
+// ================= OtlpEncoder =================
+OtlpEncoder::OtlpEncoder(const OtlpOptions &options) {
+    std::string attributes;
+    appendAttribute(attributes, kResourceAttributes, "service.name", options.service_name);
+    for (const auto &attribute : options.resource_attributes) {
+        appendAttribute(attributes, kResourceAttributes, attribute.first, attribute.second);
+    }
+    appendLengthHeader(resource_, kResourceMetricsResource, attributes.size());
+    resource_ += attributes;
+
+    std::string scope;
+    appendStringField(scope, kScopeName, options.scope_name);
+    if (!options.scope_version.empty()) {
+        appendStringField(scope, kScopeVersion, options.scope_version);
+    }
+    appendLengthHeader(scope_, kScopeMetricsScope, scope.size());
+    scope_ += scope;
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    start_ns_ = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+// Кадры независимы: заголовков у файла или потока нет
+void OtlpEncoder::begin(std::string & /*out*/, bool /*new_file*/) {}
+
+void OtlpEncoder::measure(const MetricSample &sample, Layout &layout) const {
+    layout.skip = false;
+    std::size_t tail = 0; // Поля Sum/Histogram после data_points
+    switch (sample.type) {
+    case MetricType::Gauge:
+        layout.point = 2 * kFixed64Field;
+        break;
+    case MetricType::Counter:
+        layout.point = 3 * kFixed64Field;
+        tail = 2 * kSmallVarintField;
+        break;
+    case MetricType::Text:
+        layout.skip = !parseNumber(sample.text, layout.value);
+        layout.point = 2 * kFixed64Field;
+        break;
+    case MetricType::Histogram: {
+        const HistogramValue &histogram = sample.histogram;
+        layout.point = 4 * kFixed64Field + lengthFieldSize(8 * histogram.counts.size());
+        if (histogram.bounds && !histogram.bounds->empty()) {
+            layout.point += lengthFieldSize(8 * histogram.bounds->size());
+        }
+        tail = kSmallVarintField;
+        break;
+    }
+    }
+    layout.data = lengthFieldSize(layout.point) + tail;
+    layout.metric = lengthFieldSize(sample.name.size()) + lengthFieldSize(layout.data);
+}
+
+void OtlpEncoder::writeMetric(const MetricSample &sample, const Layout &layout, std::uint64_t time_ns,
+                              std::string &out) const {
+    appendLengthHeader(out, kScopeMetricsMetrics, layout.metric);
+    appendStringField(out, kMetricName, sample.name);
+    switch (sample.type) {
+    case MetricType::Gauge:
+    case MetricType::Text:
+        appendLengthHeader(out, kMetricGauge, layout.data);
+        appendLengthHeader(out, kDataPoints, layout.point);
+        appendFixed64Field(out, kPointTime, time_ns);
+        appendDoubleField(out, kNumberAsDouble, sample.type == MetricType::Gauge ? sample.gauge : layout.value);
+        break;
+    case MetricType::Counter:
+        appendLengthHeader(out, kMetricSum, layout.data);
+        appendLengthHeader(out, kDataPoints, layout.point);
+        appendFixed64Field(out, kPointStartTime, start_ns_);
+        appendFixed64Field(out, kPointTime, time_ns);
+        appendFixed64Field(out, kNumberAsInt, static_cast<std::uint64_t>(sample.counter));
+        appendVarintField(out, kAggregationTemporality, kTemporalityDelta);
+        appendVarintField(out, kSumIsMonotonic, 1);
+        break;
+    case MetricType::Histogram: {
+        const HistogramValue &histogram = sample.histogram;
+        appendLengthHeader(out, kMetricHistogram, layout.data);
+        appendLengthHeader(out, kDataPoints, layout.point);
+        appendFixed64Field(out, kPointStartTime, start_ns_);
+        appendFixed64Field(out, kPointTime, time_ns);
+        appendFixed64Field(out, kHistogramCount, histogram.count);
+        appendDoubleField(out, kHistogramSum, histogram.sum);
+        appendLengthHeader(out, kHistogramBucketCounts, 8 * histogram.counts.size());
+        for (std::uint64_t count : histogram.counts) {
+            appendFixed64(out, count);
+        }
+        if (histogram.bounds && !histogram.bounds->empty()) {
+            appendLengthHeader(out, kHistogramExplicitBounds, 8 * histogram.bounds->size());
+            for (double bound : *histogram.bounds) {
+                appendDouble(out, bound);
+            }
+        }
+        appendVarintField(out, kAggregationTemporality, kTemporalityDelta);
+        break;
+    }
+    }
+}
+
+// Длина кадра и ExportMetricsServiceRequest { ResourceMetrics { resource, ScopeMetrics { scope, metrics... } } }
+void OtlpEncoder::encode(const Snapshot &snapshot, std::chrono::system_clock::time_point time, std::string &out) {
+    auto time_ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+
+    layouts_.resize(snapshot.samples.size());
+    std::size_t scope_metrics = scope_.size();
+    for (std::size_t i = 0; i < snapshot.samples.size(); ++i) {
+        measure(snapshot.samples[i], layouts_[i]);
+        if (!layouts_[i].skip) {
+            scope_metrics += lengthFieldSize(layouts_[i].metric);
+        }
+    }
+    std::size_t resource_metrics = resource_.size() + lengthFieldSize(scope_metrics);
+    std::size_t request = lengthFieldSize(resource_metrics);
+
+    out.reserve(out.size() + varintSize(request) + request);
+    appendVarint(out, request);
+    appendLengthHeader(out, kRequestResourceMetrics, resource_metrics);
+    out += resource_;
+    appendLengthHeader(out, kResourceMetricsScopeMetrics, scope_metrics);
+    out += scope_;
+    for (std::size_t i = 0; i < snapshot.samples.size(); ++i) {
+        if (!layouts_[i].skip) {
+            writeMetric(snapshot.samples[i], layouts_[i], time_ns, out);
+        }
+    }
+    start_ns_ = time_ns;
+}
@@ -0,0 +1,163 @@
+#include "process_metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::uint64_t microseconds(const timeval &time) {
+    return static_cast<std::uint64_t>(time.tv_sec) * 1000000 + static_cast<std::uint64_t>(time.tv_usec);
+}
+
+// Приращение монотонного показания, ограниченное диапазоном Counter
+int delta(std::uint64_t now, std::uint64_t last) {
+    return static_cast<int>(std::min<std::uint64_t>(now > last ? now - last : 0, std::numeric_limits<int>::max()));
+}
+
+} // namespace
+
+// ================= ProcessMetrics =================
+ProcessMetrics::ProcessMetrics(const std::string &prefix)
+    : cpu_usage_(std::make_shared<Gauge>(prefix + "cpu_usage", 1)),
+      cpu_time_(std::make_shared<Counter>(prefix + "cpu_time_ms")),
+      rss_(std::make_shared<Gauge>(prefix + "rss_bytes", 0)),
+      open_fds_(std::make_shared<Gauge>(prefix + "open_fds", 0)),
+      threads_(std::make_shared<Gauge>(prefix + "threads", 0)),
+      minor_faults_(std::make_shared<Counter>(prefix + "minor_faults")),
+      major_faults_(std::make_shared<Counter>(prefix + "major_faults")),
+      voluntary_switches_(std::make_shared<Counter>(prefix + "voluntary_switches")),
+      involuntary_switches_(std::make_shared<Counter>(prefix + "involuntary_switches")) {
+    stat_fd_ = ::open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    if (stat_fd_ < 0) {
+        throw std::runtime_error("ProcessMetrics: cannot open /proc/self/stat: " + std::string(std::strerror(errno)));
+    }
+    int dir_fd = ::open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    fd_dir_ = dir_fd >= 0 ? ::fdopendir(dir_fd) : nullptr;
+    if (fd_dir_ == nullptr) {
+        int err = errno;
+        if (dir_fd >= 0) {
+            ::close(dir_fd);
+        }
+        ::close(stat_fd_);
+        throw std::runtime_error("ProcessMetrics: cannot open /proc/self/fd: " + std::string(std::strerror(err)));
+    }
+    // Старые ядра возвращают нулевой размер каталога; открыты как минимум два дескриптора выше
+    struct stat info{};
+    fd_count_from_size_ = ::fstat(dir_fd, &info) == 0 && info.st_size > 0;
+
+    if (!read(last_)) {
+        ::closedir(fd_dir_);
+        ::close(stat_fd_);
+        throw std::runtime_error("ProcessMetrics: cannot read /proc/self/stat");
+    }
+    last_time_ = std::chrono::steady_clock::now();
+}
+
+ProcessMetrics::~ProcessMetrics() {
+    ::closedir(fd_dir_);
+    ::close(stat_fd_);
+}
+
+std::vector<std::shared_ptr<Metric>> ProcessMetrics::metrics() const {
+    return {cpu_usage_, cpu_time_, rss_, open_fds_, threads_,
+            minor_faults_, major_faults_, voluntary_switches_, involuntary_switches_};
+}
+
+bool ProcessMetrics::read(ProcessStats &stats) {
+    rusage usage{};
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats.cpu_user_us = microseconds(usage.ru_utime);
+        stats.cpu_system_us = microseconds(usage.ru_stime);
+        stats.minor_faults = static_cast<std::uint64_t>(usage.ru_minflt);
+        stats.major_faults = static_cast<std::uint64_t>(usage.ru_majflt);
+        stats.voluntary_switches = static_cast<std::uint64_t>(usage.ru_nvcsw);
+        stats.involuntary_switches = static_cast<std::uint64_t>(usage.ru_nivcsw);
+    }
+    stats.open_fds = countFds();
+
+    // Файл не кэшируется ядром: каждое чтение с начала формирует свежие значения
+    char buffer[1024];
+    ssize_t size = ::pread(stat_fd_, buffer, sizeof(buffer) - 1, 0);
+    if (size <= 0) {
+        return false;
+    }
+    buffer[size] = '\0';
+    // Имя процесса (поле 2) в скобках может содержать пробелы и скобки, поэтому поля считаются
+    // от последней ')': дальше идут поле 3 (состояние) и следующие
+    const char *cursor = std::strrchr(buffer, ')');
+    if (cursor == nullptr) {
+        return false;
+    }
+    ++cursor;
+    std::uint64_t threads = 0;
+    std::uint64_t rss_pages = 0;
+    for (int field = 3; field <= 24 && *cursor != '\0'; ++field) {
+        while (*cursor == ' ') {
+            ++cursor;
+        }
+        if (field == 20) {
+            threads = std::strtoull(cursor, nullptr, 10);
+        } else if (field == 24) {
+            rss_pages = std::strtoull(cursor, nullptr, 10);
+        }
+        while (*cursor != ' ' && *cursor != '\0') {
+            ++cursor;
+        }
+    }
+    static const long page_size = ::sysconf(_SC_PAGESIZE);
+    stats.threads = threads;
+    stats.rss_bytes = rss_pages * static_cast<std::uint64_t>(page_size);
+    return true;
+}
+
+std::uint64_t ProcessMetrics::countFds() {
+    if (fd_count_from_size_) {
+        struct stat info{};
+        if (::fstat(::dirfd(fd_dir_), &info) == 0) {
+            return static_cast<std::uint64_t>(info.st_size);
+        }
+    }
+    std::uint64_t count = 0;
+    ::rewinddir(fd_dir_);
+    while (const dirent *entry = ::readdir(fd_dir_)) {
+        if (entry->d_name[0] != '.') {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void ProcessMetrics::update() {
+    ProcessStats stats = last_;
+    if (!read(stats)) {
+        Logger::getInstance().logError("ProcessMetrics: reading /proc/self/stat failed: " +
+                                       std::string(std::strerror(errno)));
+    }
+    auto now = std::chrono::steady_clock::now();
+
+    std::uint64_t cpu_now = stats.cpu_user_us + stats.cpu_system_us;
+    std::uint64_t cpu_last = last_.cpu_user_us + last_.cpu_system_us;
+    double elapsed_us = std::chrono::duration<double, std::micro>(now - last_time_).count();
+    cpu_usage_->update(elapsed_us > 0 ? static_cast<double>(cpu_now - cpu_last) / elapsed_us * 100.0 : 0.0);
+    // Миллисекунды считаются от начала, чтобы дробные части интервалов не терялись
+    cpu_time_->increment(delta(cpu_now / 1000, cpu_last / 1000));
+    rss_->update(static_cast<double>(stats.rss_bytes));
+    open_fds_->update(static_cast<double>(stats.open_fds));
+    threads_->update(static_cast<double>(stats.threads));
+    minor_faults_->increment(delta(stats.minor_faults, last_.minor_faults));
+    major_faults_->increment(delta(stats.major_faults, last_.major_faults));
+    voluntary_switches_->increment(delta(stats.voluntary_switches, last_.voluntary_switches));
+    involuntary_switches_->increment(delta(stats.involuntary_switches, last_.involuntary_switches));
+
+    last_ = stats;
+    last_time_ = now;
+}
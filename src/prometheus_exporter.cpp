@@ -0,0 +1,521 @@
+#include "prometheus_exporter.h"
+#include "logger.h"
+#include "value_format.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Максимальный размер заголовков запроса
+constexpr std::size_t kMaxRequestSize = 8192;
+
+// Дописывает имя метрики, заменяя недопустимые для Prometheus символы на '_'
+void appendMetricName(std::string &out, const std::string &prefix, const std::string &name, const char *suffix) {
+    std::size_t start = out.size();
+    out += prefix;
+    out += name;
+    out += suffix;
+    for (std::size_t i = start; i < out.size(); ++i) {
+        char c = out[i];
+        bool valid = std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == ':' ||
+                     (i > start && std::isdigit(static_cast<unsigned char>(c)));
+        if (!valid) {
+            out[i] = '_';
+        }
+    }
+    if (out.size() == start) {
+        out += '_';
+    }
+}
+
+// Дописывает значение с плавающей точкой в нотации Prometheus (NaN, +Inf, -Inf)
+void appendSampleValue(std::string &out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+    } else if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+    } else {
+        appendGauge(out, value, kShortestPrecision);
+    }
+}
+
+// Дописывает строку # TYPE и начало строки значения (имя метрики)
+void appendFamily(std::string &out, const std::string &prefix, const std::string &name, const char *suffix,
+                  const char *type) {
+    out += "# TYPE ";
+    appendMetricName(out, prefix, name, suffix);
+    out += ' ';
+    out += type;
+    out += '\n';
+    appendMetricName(out, prefix, name, suffix);
+}
+
+// Дописывает значение метки с экранированием \, " и перевода строки
+void appendLabelValue(std::string &out, const std::string &value) {
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+// Прибавляет значение гистограммы за интервал к накопленному; при смене границ начинает накопление заново
+void accumulate(HistogramValue &total, const HistogramValue &value) {
+    bool same_bounds = total.bounds == value.bounds ||
+                       (total.bounds && value.bounds && *total.bounds == *value.bounds);
+    if (!same_bounds || total.counts.size() != value.counts.size()) {
+        total.bounds = value.bounds;
+        total.counts.assign(value.counts.size(), 0);
+        total.count = 0;
+        total.sum = 0.0;
+    }
+    for (std::size_t i = 0; i < value.counts.size(); ++i) {
+        total.counts[i] += value.counts[i];
+    }
+    total.count += value.count;
+    total.sum += value.sum;
+}
+
+bool parseNumber(const std::string &text, double &value) {
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+} // namespace
+
+/*
+    Готовый HTTP-ответ. Соединения удерживают его через shared_ptr, пока не допишут,
+    поэтому новый снимок не портит ответ, который еще отправляется.
+*/
+struct PrometheusExporter::Response
+{
+    std::string data;              // Заголовки и тело.
+    std::size_t header_length = 0; // Длина заголовков (ответ на HEAD).
+    bool close = false;            // Закрыть соединение после отправки.
+};
+
+/*
+    Состояние клиентского соединения.
+*/
+struct PrometheusExporter::Connection
+{
+    std::string in;                         // Полученные, еще не разобранные данные.
+    std::shared_ptr<const Response> out;    // Отправляемый ответ.
+    std::size_t sent = 0;                   // Сколько байт ответа отправлено.
+    std::size_t limit = 0;                  // Сколько байт ответа нужно отправить.
+    bool close_after = false;               // Закрыть соединение после ответа.
+    bool write_interest = false;            // Подписано ли соединение на EPOLLOUT.
+    bool read_closed = false;               // Клиент закрыл свою сторону (shutdown(SHUT_WR)).
+};
+
+std::shared_ptr<PrometheusExporter::Response> PrometheusExporter::makeResponse(const char *status,
+                                                                              const std::string &body, bool close) {
+    auto response = std::make_shared<Response>();
+    response->data = "HTTP/1.1 ";
+    response->data += status;
+    response->data += "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ";
+    appendCounter(response->data, static_cast<std::int64_t>(body.size()));
+    response->data += close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n";
+    response->header_length = response->data.size();
+    response->data += body;
+    response->close = close;
+    return response;
+}
+
+// ================= PrometheusExporter =================
+PrometheusExporter::PrometheusExporter(const PrometheusOptions &options) : options_(options) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.port);
+    if (::inet_pton(AF_INET, options_.bind_address.c_str(), &address.sin_addr) != 1) {
+        throw std::runtime_error("PrometheusExporter: invalid bind address: " + options_.bind_address);
+    }
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("PrometheusExporter: socket failed: " + std::string(std::strerror(errno)));
+    }
+    int enable = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    socklen_t length = sizeof(address);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listen_fd_, 64) != 0 ||
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        int err = errno;
+        ::close(listen_fd_);
+        throw std::runtime_error("PrometheusExporter: cannot listen on " + options_.bind_address + ":" +
+                                 std::to_string(options_.port) + ": " + std::strerror(err));
+    }
+    port_ = ntohs(address.sin_port);
+
+    event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (event_fd_ < 0 || epoll_fd_ < 0) {
+        int err = errno;
+        ::close(listen_fd_);
+        if (event_fd_ >= 0) {
+            ::close(event_fd_);
+        }
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+        }
+        throw std::runtime_error("PrometheusExporter: cannot create epoll: " + std::string(std::strerror(err)));
+    }
+    for (int fd : {listen_fd_, event_fd_}) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    response_ = makeResponse("200 OK", "", false);
+    not_found_ = makeResponse("404 Not Found", "Not Found\n", false);
+    bad_request_ = makeResponse("400 Bad Request", "Bad Request\n", true);
+    not_allowed_ = makeResponse("405 Method Not Allowed", "Method Not Allowed\n", false);
+    thread_ = std::thread(&PrometheusExporter::run, this);
+}
+
+PrometheusExporter::~PrometheusExporter() {
+    running_ = false;
+    std::uint64_t one = 1;
+    if (::write(event_fd_, &one, sizeof(one)) < 0) {
+        // eventfd переполнен — поток и так будет разбужен
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto &entry : connections_) {
+        ::close(entry.first);
+    }
+    ::close(epoll_fd_);
+    ::close(event_fd_);
+    ::close(listen_fd_);
+}
+
+void PrometheusExporter::publish(std::shared_ptr<const Snapshot> snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.push_back(std::move(snapshot));
+    }
+    std::uint64_t one = 1;
+    if (::write(event_fd_, &one, sizeof(one)) < 0) {
+        // Счетчик eventfd не сбрасывался — поток уже разбужен
+    }
+}
+
+// Формирует тело и заголовки ответа один раз на снимок
+void PrometheusExporter::render(const std::vector<std::shared_ptr<const Snapshot>> &snapshots) {
+    // Значения Counter и Histogram сбрасываются при каждом сборе, поэтому учитываются все снимки, а не только последний
+    for (std::size_t i = 0; i + 1 < snapshots.size(); ++i) {
+        for (const auto &sample : snapshots[i]->samples) {
+            if (sample.type == MetricType::Counter) {
+                totals_[sample.name] += sample.counter;
+            } else if (sample.type == MetricType::Histogram) {
+                accumulate(histograms_[sample.name], sample.histogram);
+            }
+        }
+    }
+    const Snapshot &snapshot = *snapshots.back();
+    body_.clear();
+    for (const auto &sample : snapshot.samples) {
+        switch (sample.type) {
+        case MetricType::Gauge:
+            appendFamily(body_, options_.prefix, sample.name, "", "gauge");
+            body_ += ' ';
+            appendSampleValue(body_, sample.gauge);
+            break;
+        case MetricType::Counter: {
+            std::int64_t &total = totals_[sample.name];
+            total += sample.counter;
+            appendFamily(body_, options_.prefix, sample.name, "_total", "counter");
+            body_ += ' ';
+            appendCounter(body_, total);
+            break;
+        }
+        case MetricType::Text: {
+            double value;
+            if (parseNumber(sample.text, value)) {
+                appendFamily(body_, options_.prefix, sample.name, "", "untyped");
+                body_ += ' ';
+                appendSampleValue(body_, value);
+            } else {
+                appendFamily(body_, options_.prefix, sample.name, "_info", "gauge");
+                body_ += "{value=\"";
+                appendLabelValue(body_, sample.text);
+                body_ += "\"} 1";
+            }
+            break;
+        }
+        case MetricType::Histogram: {
+            HistogramValue &total = histograms_[sample.name];
+            accumulate(total, sample.histogram);
+            body_ += "# TYPE ";
+            appendMetricName(body_, options_.prefix, sample.name, "");
+            body_ += " histogram\n";
+            std::size_t bounds = total.bounds ? total.bounds->size() : 0;
+            std::uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < total.counts.size(); ++i) {
+                cumulative += total.counts[i];
+                appendMetricName(body_, options_.prefix, sample.name, "_bucket");
+                body_ += "{le=\"";
+                appendSampleValue(body_, i < bounds ? (*total.bounds)[i] : std::numeric_limits<double>::infinity());
+                body_ += "\"} ";
+                appendCounter(body_, static_cast<std::int64_t>(cumulative));
+                body_ += '\n';
+            }
+            appendMetricName(body_, options_.prefix, sample.name, "_sum");
+            body_ += ' ';
+            appendSampleValue(body_, total.sum);
+            body_ += '\n';
+            appendMetricName(body_, options_.prefix, sample.name, "_count");
+            body_ += ' ';
+            appendCounter(body_, static_cast<std::int64_t>(total.count));
+            break;
+        }
+        }
+        body_ += '\n';
+    }
+
+    // Буфер переиспользуется, если его не отправляет ни одно соединение
+    if (response_.use_count() != 1) {
+        response_ = std::make_shared<Response>();
+    }
+    std::string &data = response_->data;
+    data = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ";
+    appendCounter(data, static_cast<std::int64_t>(body_.size()));
+    data += "\r\n\r\n";
+    response_->header_length = data.size();
+    data += body_;
+}
+
+void PrometheusExporter::run() {
+    epoll_event events[64];
+    while (running_) {
+        int count = ::epoll_wait(epoll_fd_, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::getInstance().logError("PrometheusExporter: epoll_wait failed: " + std::string(std::strerror(errno)));
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                acceptConnections();
+            } else if (fd == event_fd_) {
+                std::uint64_t value;
+                if (::read(event_fd_, &value, sizeof(value)) < 0) {
+                    // Нет новых событий
+                }
+                {
+                    std::lock_guard<std::mutex> lock(pending_mutex_);
+                    rendering_.swap(pending_);
+                }
+                if (!rendering_.empty()) {
+                    render(rendering_);
+                    rendering_.clear();
+                }
+            } else {
+                auto it = connections_.find(fd);
+                if (it == connections_.end()) {
+                    continue;
+                }
+                Connection &connection = *it->second;
+                if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 && (events[i].events & EPOLLIN) == 0) {
+                    closeConnection(fd);
+                    continue;
+                }
+                if ((events[i].events & EPOLLIN) != 0 && !readRequest(fd, connection)) {
+                    continue;
+                }
+                serve(fd, connection);
+            }
+        }
+    }
+}
+
+void PrometheusExporter::acceptConnections() {
+    while (true) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                // При исчерпании дескрипторов (EMFILE) ошибка повторяется на каждом событии epoll
+                METRICS_LOG_RATE_LIMITED(LogLevel::Error, 1.0, 5, "PrometheusExporter: accept failed: {}",
+                                         std::strerror(errno));
+            }
+            return;
+        }
+        if (connections_.size() >= options_.max_connections) {
+            ::close(fd);
+            continue;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        connections_.emplace(fd, std::make_unique<Connection>());
+    }
+}
+
+bool PrometheusExporter::readRequest(int fd, Connection &connection) {
+    char buffer[4096];
+    while (true) {
+        ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.in.append(buffer, static_cast<std::size_t>(received));
+            if (connection.in.size() > 4 * kMaxRequestSize) {
+                closeConnection(fd);
+                return false;
+            }
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received == 0) {
+            // Клиент закрыл только свою сторону: запросы из буфера еще обслуживаются, затем
+            // соединение закрывается. EPOLLIN снимается, иначе EOF сообщался бы на каждой итерации
+            connection.read_closed = true;
+            updateEvents(fd, connection);
+            return true;
+        }
+        // Ошибка чтения
+        closeConnection(fd);
+        return false;
+    }
+}
+
+bool PrometheusExporter::nextRequest(Connection &connection) {
+    std::size_t end = connection.in.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        if (connection.in.size() <= kMaxRequestSize) {
+            return false;
+        }
+        connection.out = bad_request_;
+    } else {
+        // Строка запроса: METHOD SP target SP version
+        std::size_t line_end = connection.in.find("\r\n");
+        std::size_t first = connection.in.find(' ');
+        std::size_t second = first == std::string::npos ? first : connection.in.find(' ', first + 1);
+        if (second == std::string::npos || second > line_end) {
+            connection.out = bad_request_;
+        } else {
+            std::string method = connection.in.substr(0, first);
+            std::string target = connection.in.substr(first + 1, second - first - 1);
+            std::string version = connection.in.substr(second + 1, line_end - second - 1);
+            target = target.substr(0, target.find('?'));
+
+            std::string headers = connection.in.substr(line_end, end - line_end);
+            std::transform(headers.begin(), headers.end(), headers.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            bool keep_alive = headers.find("\nconnection: keep-alive") != std::string::npos;
+            connection.close_after = headers.find("\nconnection: close") != std::string::npos ||
+                                     (version == "HTTP/1.0" && !keep_alive);
+
+            if (method != "GET" && method != "HEAD") {
+                connection.out = not_allowed_;
+            } else if (target != options_.path) {
+                connection.out = not_found_;
+            } else {
+                connection.out = response_;
+                scrapes_.fetch_add(1, std::memory_order_relaxed);
+            }
+            connection.limit = method == "HEAD" ? connection.out->header_length : connection.out->data.size();
+            connection.in.erase(0, end + 4);
+            connection.sent = 0;
+            return true;
+        }
+    }
+    connection.close_after = true;
+    connection.limit = connection.out->data.size();
+    connection.sent = 0;
+    connection.in.clear();
+    return true;
+}
+
+void PrometheusExporter::serve(int fd, Connection &connection) {
+    while (true) {
+        if (!connection.out && !nextRequest(connection)) {
+            // Незавершенный запрос после закрытия стороны клиента уже не дополнится
+            if (connection.read_closed) {
+                closeConnection(fd);
+                return;
+            }
+            setWriteInterest(fd, connection, false);
+            return;
+        }
+        while (connection.sent < connection.limit) {
+            ssize_t sent = ::send(fd, connection.out->data.data() + connection.sent, connection.limit - connection.sent,
+                                  MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.sent += static_cast<std::size_t>(sent);
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                setWriteInterest(fd, connection, true);
+                return;
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else {
+                closeConnection(fd);
+                return;
+            }
+        }
+        if (connection.close_after || connection.out->close) {
+            closeConnection(fd);
+            return;
+        }
+        connection.out.reset();
+    }
+}
+
+void PrometheusExporter::setWriteInterest(int fd, Connection &connection, bool enabled) {
+    if (connection.write_interest == enabled) {
+        return;
+    }
+    connection.write_interest = enabled;
+    updateEvents(fd, connection);
+}
+
+void PrometheusExporter::updateEvents(int fd, Connection &connection) {
+    epoll_event event{};
+    if (!connection.read_closed) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (connection.write_interest) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+}
+
+void PrometheusExporter::closeConnection(int fd) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+}
@@ -0,0 +1,232 @@
+#include "segment_archiver.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+// Константы ioprio_set (нет в заголовках glibc)
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+
+constexpr char kGzSuffix[] = ".gz";
+
+bool endsWith(const std::string &value, const std::string &suffix) {
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Разделяет путь на каталог и имя файла
+std::pair<std::string, std::string> splitPath(const std::string &path) {
+    auto slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return {".", path};
+    }
+    return {slash == 0 ? "/" : path.substr(0, slash), path.substr(slash + 1)};
+}
+
+// Проверяет, что suffix имеет вид YYYYMMDDTHHMMSSZ[-N][.gz]
+bool isSegmentSuffix(const std::string &suffix) {
+    if (suffix.size() < 16 || suffix[8] != 'T' || suffix[15] != 'Z') {
+        return false;
+    }
+    for (int i = 0; i < 15; ++i) {
+        if (i != 8 && (suffix[i] < '0' || suffix[i] > '9')) {
+            return false;
+        }
+    }
+    std::string rest = suffix.substr(16);
+    if (endsWith(rest, kGzSuffix)) {
+        rest.resize(rest.size() - (sizeof(kGzSuffix) - 1));
+    }
+    if (rest.empty()) {
+        return true;
+    }
+    if (rest[0] != '-' || rest.size() == 1) {
+        return false;
+    }
+    return std::all_of(rest.begin() + 1, rest.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// Ключ сортировки сегмента: время ротации и номер при совпадении времени
+std::pair<std::string, long> segmentKey(const std::string &name, std::size_t prefix_length) {
+    std::string suffix = name.substr(prefix_length);
+    if (endsWith(suffix, kGzSuffix)) {
+        suffix.resize(suffix.size() - (sizeof(kGzSuffix) - 1));
+    }
+    long index = suffix.size() > 16 ? std::strtol(suffix.c_str() + 17, nullptr, 10) : 0;
+    return {suffix.substr(0, 16), index};
+}
+
+bool fileExists(const std::string &path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+} // namespace
+
+// ================= SegmentArchiver =================
+SegmentArchiver::SegmentArchiver(const std::string &base_filename, unsigned retention, bool compress)
+    : base_filename_(base_filename), retention_(retention), compress_(compress) {
+    if (compress_) {
+        for (const auto &segment : listSegments(base_filename_)) {
+            if (!endsWith(segment, kGzSuffix)) {
+                pending_.push_back(segment);
+            }
+        }
+    }
+    thread_ = std::thread(&SegmentArchiver::run, this);
+}
+
+SegmentArchiver::~SegmentArchiver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_var_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SegmentArchiver::submit(const std::string &segment) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(segment);
+    }
+    cond_var_.notify_one();
+}
+
+std::string SegmentArchiver::segmentName(const std::string &base_filename, std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::tm tm;
+    ::gmtime_r(&seconds, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%dT%H%M%SZ", &tm);
+
+    std::string name = base_filename + "." + stamp;
+    for (int index = 1; fileExists(name) || fileExists(name + kGzSuffix); ++index) {
+        name = base_filename + "." + stamp + "-" + std::to_string(index);
+    }
+    return name;
+}
+
+std::vector<std::string> SegmentArchiver::listSegments(const std::string &base_filename) {
+    auto [directory, base] = splitPath(base_filename);
+    std::string prefix = base + ".";
+    std::vector<std::string> names;
+
+    DIR *dir = ::opendir(directory.c_str());
+    if (dir == nullptr) {
+        return names;
+    }
+    while (dirent *entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0 && isSegmentSuffix(name.substr(prefix.size()))) {
+            names.push_back(name);
+        }
+    }
+    ::closedir(dir);
+
+    std::sort(names.begin(), names.end(), [&prefix](const std::string &a, const std::string &b) {
+        return segmentKey(a, prefix.size()) < segmentKey(b, prefix.size());
+    });
+    std::vector<std::string> segments;
+    segments.reserve(names.size());
+    std::string dir_prefix = base_filename.find('/') == std::string::npos ? "" : directory + "/";
+    for (const auto &name : names) {
+        segments.push_back(dir_prefix + name);
+    }
+    return segments;
+}
+
+void SegmentArchiver::run() {
+    // Наименьший приоритет CPU и класс ввода-вывода idle только для этого потока
+    pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 19);
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+
+    for (;;) {
+        std::string segment;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_var_.wait(lock, [this]{ return !pending_.empty() || stopped_; });
+            if (pending_.empty()) {
+                return;
+            }
+            segment = std::move(pending_.front());
+            pending_.pop_front();
+        }
+        if (compress_) {
+            compress(segment);
+        }
+        applyRetention();
+    }
+}
+
+// Сжимает сегмент во временный файл, атомарно переименовывает его в .gz и удаляет исходный
+void SegmentArchiver::compress(const std::string &segment) {
+    std::FILE *in = std::fopen(segment.c_str(), "rb");
+    if (in == nullptr) {
+        Logger::getInstance().logError("SegmentArchiver: cannot open " + segment + ": " + std::strerror(errno));
+        return;
+    }
+    const std::string target = segment + kGzSuffix;
+    const std::string temp = target + ".tmp";
+    gzFile out = ::gzopen(temp.c_str(), "wb6");
+    if (out == nullptr) {
+        std::fclose(in);
+        Logger::getInstance().logError("SegmentArchiver: cannot create " + temp);
+        return;
+    }
+
+    std::vector<char> buffer(256 * 1024);
+    bool ok = true;
+    std::size_t read;
+    while ((read = std::fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+        if (::gzwrite(out, buffer.data(), static_cast<unsigned>(read)) != static_cast<int>(read)) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && !std::ferror(in);
+    std::fclose(in);
+    ok = ::gzclose(out) == Z_OK && ok;
+
+    if (!ok || std::rename(temp.c_str(), target.c_str()) != 0) {
+        std::remove(temp.c_str());
+        Logger::getInstance().logError("SegmentArchiver: failed to compress " + segment);
+        return;
+    }
+    std::remove(segment.c_str());
+}
+
+void SegmentArchiver::applyRetention() {
+    if (retention_ == 0) {
+        return;
+    }
+    auto segments = listSegments(base_filename_);
+    if (segments.size() <= retention_) {
+        return;
+    }
+    std::size_t excess = segments.size() - retention_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < excess; ++i) {
+        // Сегмент, еще ожидающий сжатия, не трогаем: он будет учтен при следующем проходе
+        if (std::find(pending_.begin(), pending_.end(), segments[i]) != pending_.end()) {
+            continue;
+        }
+        std::remove(segments[i].c_str());
+    }
+}
@@ -0,0 +1,261 @@
+#include "statsd_sink.h"
+#include "logger.h"
+#include "value_format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Максимум датаграмм за один вызов sendmmsg
+constexpr std::size_t kMaxBatch = 1024;
+
+// Дописывает имя метрики, заменяя символы, недопустимые в протоколе StatsD (':', '|', '@', '#', пробелы)
+void appendStatsdName(std::string &out, const std::string &prefix, const std::string &name) {
+    std::size_t start = out.size();
+    out += prefix;
+    out += name;
+    for (std::size_t i = start; i < out.size(); ++i) {
+        char c = out[i];
+        if (c == ':' || c == '|' || c == '@' || c == '#' || c == ' ' || c == '\n' || c == '\t' || c == ',') {
+            out[i] = '_';
+        }
+    }
+}
+
+// Значение gauge со знаком StatsD понимает как изменение ("name:-5|g" уменьшает gauge на 5),
+// поэтому перед отрицательным значением gauge обнуляется строкой в той же датаграмме.
+// line содержит "name:", в конце снова остается "name:"
+void appendGaugeReset(std::string &line, const std::string &tags) {
+    std::size_t name_length = line.size();
+    line += "0|g";
+    line += tags;
+    line += '\n';
+    line.append(line, 0, name_length);
+}
+
+} // namespace
+
+// ================= StatsdSink =================
+StatsdSink::StatsdSink(const StatsdOptions &options) : options_(options) {
+    options_.max_datagram = std::max<std::size_t>(options_.max_datagram, 64);
+    options_.queue_limit = std::max<std::size_t>(options_.queue_limit, 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *addresses = nullptr;
+    const std::string port = std::to_string(options_.port);
+    int rc = ::getaddrinfo(options_.host.c_str(), port.c_str(), &hints, &addresses);
+    if (rc != 0) {
+        throw std::runtime_error("StatsdSink: cannot resolve " + options_.host + ": " + ::gai_strerror(rc));
+    }
+    int err = 0;
+    for (addrinfo *address = addresses; address != nullptr; address = address->ai_next) {
+        fd_ = ::socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd_ < 0) {
+            err = errno;
+            continue;
+        }
+        // connect задает адрес назначения, поэтому sendmmsg не передает адрес в каждом сообщении
+        if (::connect(fd_, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        err = errno;
+        ::close(fd_);
+        fd_ = -1;
+    }
+    ::freeaddrinfo(addresses);
+    if (fd_ < 0) {
+        throw std::runtime_error("StatsdSink: cannot connect to " + options_.host + ":" + port + ": " +
+                                 std::strerror(err));
+    }
+
+    for (std::size_t i = 0; i < options_.tags.size(); ++i) {
+        suffix_tags_ += i == 0 ? "|#" : ",";
+        suffix_tags_ += options_.tags[i];
+    }
+    packets_.reserve(64 * 1024);
+    thread_ = std::thread(&StatsdSink::run, this);
+}
+
+StatsdSink::~StatsdSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_var_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    ::close(fd_);
+}
+
+void StatsdSink::publish(std::shared_ptr<const Snapshot> snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= options_.queue_limit) {
+            dropped_snapshots_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue_.push_back(std::move(snapshot));
+    }
+    cond_var_.notify_one();
+}
+
+StatsdStats StatsdSink::getStats() const {
+    StatsdStats stats;
+    stats.snapshots = snapshots_.load(std::memory_order_relaxed);
+    stats.dropped_snapshots = dropped_snapshots_.load(std::memory_order_relaxed);
+    stats.datagrams = datagrams_.load(std::memory_order_relaxed);
+    stats.dropped_datagrams = dropped_datagrams_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.send_calls = send_calls_.load(std::memory_order_relaxed);
+    stats.oversized_lines = oversized_lines_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SinkStats StatsdSink::sinkStats() const {
+    SinkStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queued = queue_.size();
+    }
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_snapshots_.load(std::memory_order_relaxed);
+    stats.errors = dropped_datagrams_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void StatsdSink::run() {
+    while (true) {
+        std::shared_ptr<const Snapshot> snapshot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_var_.wait(lock, [this] { return stopped_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            snapshot = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        encode(*snapshot);
+        send();
+        snapshots_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Строки дописываются в текущую датаграмму, пока она не превысит max_datagram
+void StatsdSink::encode(const Snapshot &snapshot) {
+    packets_.clear();
+    boundaries_.clear();
+    std::size_t packet_start = 0;
+    for (const auto &sample : snapshot.samples) {
+        line_.clear();
+        appendStatsdName(line_, options_.prefix, sample.name);
+        line_ += ':';
+        switch (sample.type) {
+        case MetricType::Gauge:
+            // NaN и бесконечности в протоколе не представимы
+            if (!std::isfinite(sample.gauge)) {
+                continue;
+            }
+            if (sample.gauge < 0) {
+                appendGaugeReset(line_, suffix_tags_);
+            }
+            appendGauge(line_, sample.gauge, kShortestPrecision);
+            line_ += "|g";
+            break;
+        case MetricType::Counter:
+            appendCounter(line_, sample.counter);
+            line_ += "|c";
+            break;
+        case MetricType::Text: {
+            // В StatsD нет строковых значений: отправляются только числовые
+            double value;
+            const char *end = sample.text.data() + sample.text.size();
+            auto result = std::from_chars(sample.text.data(), end, value);
+            if (sample.text.empty() || result.ec != std::errc() || result.ptr != end || !std::isfinite(value)) {
+                continue;
+            }
+            if (value < 0) {
+                appendGaugeReset(line_, suffix_tags_);
+            }
+            line_ += sample.text;
+            line_ += "|g";
+            break;
+        }
+        case MetricType::Histogram:
+            // Гистограммы StatsD строит на агенте из отдельных значений, а снимок содержит уже агрегат
+            continue;
+        }
+        line_ += suffix_tags_;
+
+        if (line_.size() > options_.max_datagram) {
+            oversized_lines_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        std::size_t packet_size = packets_.size() - packet_start;
+        if (packet_size > 0 && packet_size + 1 + line_.size() > options_.max_datagram) {
+            boundaries_.push_back(packets_.size());
+            packet_start = packets_.size();
+            packet_size = 0;
+        }
+        if (packet_size > 0) {
+            packets_ += '\n';
+        }
+        packets_ += line_;
+    }
+    if (packets_.size() > packet_start) {
+        boundaries_.push_back(packets_.size());
+    }
+}
+
+void StatsdSink::send() {
+    iovecs_.resize(boundaries_.size());
+    messages_.resize(boundaries_.size());
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < boundaries_.size(); ++i) {
+        iovecs_[i].iov_base = &packets_[start];
+        iovecs_[i].iov_len = boundaries_[i] - start;
+        std::memset(&messages_[i], 0, sizeof(messages_[i]));
+        messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+        messages_[i].msg_hdr.msg_iovlen = 1;
+        start = boundaries_[i];
+    }
+
+    std::size_t sent = 0;
+    while (sent < messages_.size()) {
+        unsigned batch = static_cast<unsigned>(std::min(kMaxBatch, messages_.size() - sent));
+        int rc = ::sendmmsg(fd_, &messages_[sent], batch, MSG_DONTWAIT);
+        send_calls_.fetch_add(1, std::memory_order_relaxed);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            // Буфер сокета заполнен или агент недоступен: остаток снимка отбрасывается
+            int err = rc < 0 ? errno : EAGAIN;
+            if (err != EAGAIN && err != EWOULDBLOCK && err != last_error_) {
+                Logger::getInstance().logError("StatsdSink: sendmmsg failed: " + std::string(std::strerror(err)));
+            }
+            last_error_ = err;
+            dropped_datagrams_.fetch_add(messages_.size() - sent, std::memory_order_relaxed);
+            return;
+        }
+        last_error_ = 0;
+        for (int i = 0; i < rc; ++i) {
+            bytes_.fetch_add(messages_[sent + i].msg_len, std::memory_order_relaxed);
+        }
+        datagrams_.fetch_add(static_cast<std::uint64_t>(rc), std::memory_order_relaxed);
+        sent += static_cast<std::size_t>(rc);
+    }
+}
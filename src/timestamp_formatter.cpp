@@ -0,0 +1,94 @@
+#include "timestamp_formatter.h"
+
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+namespace {
+
+// Интервал, внутри которого смещение локального времени от UTC считается неизменным
+constexpr std::int64_t kOffsetWindowSeconds = 15 * 60;
+
+inline std::int64_t floorDiv(std::int64_t value, std::int64_t divisor) {
+    std::int64_t quotient = value / divisor;
+    return (value % divisor < 0) ? quotient - 1 : quotient;
+}
+
+inline void writeTwoDigits(char *out, unsigned value) {
+    out[0] = static_cast<char>('0' + value / 10);
+    out[1] = static_cast<char>('0' + value % 10);
+}
+
+} // namespace
+
+TimestampFormatter::TimestampFormatter(Zone zone)
+    : zone_(zone),
+      cached_second_(std::numeric_limits<std::int64_t>::min()),
+      offset_window_(std::numeric_limits<std::int64_t>::min()) {
+    std::memset(prefix_, 0, sizeof(prefix_));
+}
+
+void TimestampFormatter::renderSecond(std::int64_t epoch_seconds) {
+    std::int64_t seconds = epoch_seconds;
+    if (zone_ == Zone::Local) {
+        std::int64_t window = floorDiv(epoch_seconds, kOffsetWindowSeconds);
+        if (window != offset_window_) {
+            std::time_t time = static_cast<std::time_t>(epoch_seconds);
+            std::tm tm;
+            localtime_r(&time, &tm);
+            offset_seconds_ = tm.tm_gmtoff;
+            offset_window_ = window;
+        }
+        seconds += offset_seconds_;
+    }
+
+    // Преобразование дней от начала эпохи в дату григорианского календаря (алгоритм civil_from_days)
+    std::int64_t days = floorDiv(seconds, 86400);
+    auto second_of_day = static_cast<unsigned>(seconds - days * 86400);
+    days += 719468;
+    const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const auto doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    const auto year = static_cast<unsigned>(static_cast<std::int64_t>(yoe) + era * 400 + (month <= 2));
+
+    writeTwoDigits(prefix_, year / 100 % 100);
+    writeTwoDigits(prefix_ + 2, year % 100);
+    prefix_[4] = '-';
+    writeTwoDigits(prefix_ + 5, month);
+    prefix_[7] = '-';
+    writeTwoDigits(prefix_ + 8, day);
+    prefix_[10] = ' ';
+    writeTwoDigits(prefix_ + 11, second_of_day / 3600);
+    prefix_[13] = ':';
+    writeTwoDigits(prefix_ + 14, second_of_day / 60 % 60);
+    prefix_[16] = ':';
+    writeTwoDigits(prefix_ + 17, second_of_day % 60);
+    prefix_[19] = '.';
+    cached_second_ = epoch_seconds;
+}
+
+void TimestampFormatter::format(std::int64_t epoch_ms, char *out) {
+    std::int64_t seconds = floorDiv(epoch_ms, 1000);
+    auto millis = static_cast<unsigned>(epoch_ms - seconds * 1000);
+    if (seconds != cached_second_) {
+        renderSecond(seconds);
+    }
+    std::memcpy(out, prefix_, kSecondsLength + 1);
+    out[20] = static_cast<char>('0' + millis / 100);
+    out[21] = static_cast<char>('0' + millis / 10 % 10);
+    out[22] = static_cast<char>('0' + millis % 10);
+}
+
+void TimestampFormatter::format(std::chrono::system_clock::time_point time, char *out) {
+    format(std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count(), out);
+}
+
+void TimestampFormatter::append(std::chrono::system_clock::time_point time, std::string &out) {
+    std::size_t size = out.size();
+    out.resize(size + kLength);
+    format(time, &out[size]);
+}
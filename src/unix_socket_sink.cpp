@@ -0,0 +1,182 @@
+#include "unix_socket_sink.h"
+#include "logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ================= UnixSocketSink =================
+UnixSocketSink::UnixSocketSink(const UnixSocketOptions &options, std::unique_ptr<Encoder> encoder)
+    : options_(options), encoder_(encoder ? std::move(encoder) : makeEncoder(OutputFormat::Text)) {
+    if (options_.queue_limit == 0) {
+        options_.queue_limit = 1;
+    }
+    buffer_.reserve(64 * 1024);
+    thread_ = std::thread(&UnixSocketSink::run, this);
+}
+
+UnixSocketSink::~UnixSocketSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_var_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void UnixSocketSink::publish(std::shared_ptr<const Snapshot> snapshot) {
+    if (!snapshot || snapshot->samples.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= options_.queue_limit) {
+            dropped_snapshots_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue_.push_back(std::move(snapshot));
+    }
+    cond_var_.notify_one();
+}
+
+void UnixSocketSink::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::uint64_t request = ++flush_requested_;
+    queue_.push_back(nullptr);
+    cond_var_.notify_one();
+    flush_cv_.wait(lock, [this, request] { return flush_done_ >= request; });
+}
+
+UnixSocketStats UnixSocketSink::getStats() const {
+    UnixSocketStats stats;
+    stats.snapshots = snapshots_.load(std::memory_order_relaxed);
+    stats.dropped_snapshots = dropped_snapshots_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.connects = connects_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SinkStats UnixSocketSink::sinkStats() const {
+    SinkStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queued = queue_.size();
+    }
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_snapshots_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Основной цикл: все снимки, накопившиеся в очереди, кодируются в один буфер и отправляются одним вызовом
+void UnixSocketSink::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cond_var_.wait(lock, [this] { return !queue_.empty() || stopped_; });
+        if (queue_.empty()) {
+            break;
+        }
+        sending_.swap(queue_);
+        lock.unlock();
+
+        std::uint64_t flushes = 0;
+        std::uint64_t snapshots = 0;
+        buffer_.clear();
+        bool connected = fd_ >= 0;
+        for (const auto &snapshot : sending_) {
+            if (!snapshot) {
+                ++flushes;
+                continue;
+            }
+            if (!connected) {
+                connected = connect();
+                if (!connected) {
+                    dropped_snapshots_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                // Новое соединение — новый поток для кодировщика
+                encoder_->begin(buffer_, true);
+            }
+            encoder_->encode(*snapshot, snapshot->captureTime(std::chrono::system_clock::now()), buffer_);
+            ++snapshots;
+        }
+        sending_.clear();
+        if (snapshots > 0) {
+            encoder_->finish(buffer_);
+            if (sendAll(buffer_.data(), buffer_.size())) {
+                snapshots_.fetch_add(snapshots, std::memory_order_relaxed);
+                bytes_.fetch_add(buffer_.size(), std::memory_order_relaxed);
+            } else {
+                dropped_snapshots_.fetch_add(snapshots, std::memory_order_relaxed);
+            }
+        }
+
+        lock.lock();
+        if (flushes > 0) {
+            flush_done_ += flushes;
+            flush_cv_.notify_all();
+        }
+    }
+}
+
+// Подключает сокет; повторные попытки — не чаще reconnect_delay
+bool UnixSocketSink::connect() {
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_connect_) {
+        return false;
+    }
+    next_connect_ = now + options_.reconnect_delay;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options_.path.size() >= sizeof(address.sun_path)) {
+        Logger::getInstance().logError("UnixSocketSink: socket path is too long: " + options_.path);
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(address.sun_path, options_.path.c_str(), options_.path.size() + 1);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        int err = errno;
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        METRICS_LOG_RATE_LIMITED(LogLevel::Error, 1.0, 5, "UnixSocketSink: cannot connect to {}: {}", options_.path,
+                                 std::strerror(err));
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    connects_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool UnixSocketSink::sendAll(const char *data, std::size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(fd_, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            Logger::getInstance().logError("UnixSocketSink: send failed: " + std::string(std::strerror(errno)));
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            // Соединение разорвано: при следующем снимке подключение будет повторено
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        data += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#include "value_format.h"
+
+#include <algorithm>
+#include <charconv>
+
+std::size_t formatGauge(double value, int precision, char *out) {
+    char *end = out + kMaxValueLength;
+    if (precision != kShortestPrecision) {
+        auto result = std::to_chars(out, end, value, std::chars_format::fixed,
+                                    std::clamp(precision, 0, kMaxGaugePrecision));
+        if (result.ec == std::errc()) {
+            return static_cast<std::size_t>(result.ptr - out);
+        }
+    }
+    // Кратчайшее представление всегда помещается в kMaxValueLength символов
+    auto result = std::to_chars(out, end, value);
+    return static_cast<std::size_t>(result.ptr - out);
+}
+
+std::size_t formatCounter(std::int64_t value, char *out) {
+    auto result = std::to_chars(out, out + kMaxValueLength, value);
+    return static_cast<std::size_t>(result.ptr - out);
+}
+
+void appendGauge(std::string &out, double value, int precision) {
+    char buffer[kMaxValueLength];
+    out.append(buffer, formatGauge(value, precision, buffer));
+}
+
+void appendCounter(std::string &out, std::int64_t value) {
+    char buffer[kMaxValueLength];
+    out.append(buffer, formatCounter(value, buffer));
+}
+
+void appendHistogram(std::string &out, const HistogramValue &histogram) {
+    out += "count=";
+    appendCounter(out, static_cast<std::int64_t>(histogram.count));
+    out += ";sum=";
+    appendGauge(out, histogram.sum, kShortestPrecision);
+    std::size_t bounds = histogram.bounds ? histogram.bounds->size() : 0;
+    for (std::size_t i = 0; i < histogram.counts.size(); ++i) {
+        out += ';';
+        if (i < bounds) {
+            appendGauge(out, (*histogram.bounds)[i], kShortestPrecision);
+        } else {
+            out += "+Inf";
+        }
+        out += ':';
+        appendCounter(out, static_cast<std::int64_t>(histogram.counts[i]));
+    }
+}
+
+void appendValue(std::string &out, const MetricSample &sample) {
+    switch (sample.type) {
+    case MetricType::Gauge:
+        appendGauge(out, sample.gauge, sample.precision);
+        break;
+    case MetricType::Counter:
+        appendCounter(out, sample.counter);
+        break;
+    case MetricType::Text:
+        out += sample.text;
+        break;
+    case MetricType::Histogram:
+        appendHistogram(out, sample.histogram);
+        break;
+    }
+}
+
+void appendDelimitedField(std::string &out, const std::string &field, char delimiter) {
+    if (delimiter == '\t') {
+        if (field.find_first_of("\t\n\r\\") == std::string::npos) {
+            out += field;
+            return;
+        }
+        for (char c : field) {
+            switch (c) {
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\\': out += "\\\\"; break;
+            default: out += c;
+            }
+        }
+        return;
+    }
+
+    const char special[] = {delimiter, '"', '\n', '\r', '\0'};
+    if (field.find_first_of(special) == std::string::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
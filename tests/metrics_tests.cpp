@@ -1,9 +1,39 @@
 #include "metrics_library.h"
 #include "metrics_tests.h"
+#include "metrics_reader.h"
+#include "prometheus_exporter.h"
+#include "statsd_sink.h"
+#include "influx_sink.h"
+#include "memory_sink.h"
+#include "otlp_encoder.h"
+#include "unix_socket_sink.h"
+#include "binary_log.h"
+#include "io_executor.h"
+#include "process_metrics.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <sstream>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <random>
 #include <thread>
+#include <zlib.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 // Макрос для проверки условий с выводом сообщений
 #define TEST_ASSERT(condition, message) \
@@ -88,6 +118,1671 @@ bool test_metrics_collector() {
     return true;
 }
 
+// Тест MetricsWriter с буферизацией: строки копятся в буфере и сбрасываются одним write,
+// когда по часам писателя с первой строки в буфере прошел flush_interval
+bool test_buffered_writer() {
+    const std::string test_filename = "test_buffered_metrics.txt";
+    setup_test_environment(test_filename);
+
+    VirtualClock clock;
+    WriterOptions options;
+    options.flush_bytes = 1 << 20;
+    options.flush_interval = std::chrono::milliseconds(50);
+    options.clock = &clock;
+    {
+        MetricsWriter writer(test_filename, options);
+        // Писатель читает часы, когда обрабатывает снимок, поэтому часы сдвигаются только после обработки
+        auto waitLines = [&writer](std::uint64_t lines) {
+            for (int i = 0; i < 5000 && writer.getStats().lines < lines; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return writer.getStats().lines == lines;
+        };
+        for (int i = 0; i < 10; ++i) {
+            writer.write({{"buffered", std::to_string(i)}});
+        }
+        TEST_ASSERT(waitLines(10), "Lines were not processed");
+        // Срок отсчитывается от первой строки буфера, а не от последней
+        clock.advance(std::chrono::milliseconds(40));
+        writer.write({{"buffered", "10"}});
+        TEST_ASSERT(waitLines(11), "Lines were not processed");
+        TEST_ASSERT(writer.getStats().write_calls == 0, "Buffer was written before flush_interval");
+        clock.advance(std::chrono::milliseconds(20));
+        writer.write({{"buffered", "11"}});
+        TEST_ASSERT(waitLines(12), "Lines were not processed");
+        // Эта строка открывает новый буфер и попадает в файл только при flush()
+        writer.write({{"buffered", "12"}});
+        writer.flush();
+
+        WriterStats stats = writer.getStats();
+        TEST_ASSERT(stats.lines == 13, "Not all lines were formatted");
+        TEST_ASSERT(stats.write_calls == 2, "Expected one write() at the interval and one at flush(), got " +
+                                                std::to_string(stats.write_calls));
+    }
+
+    std::ifstream file(test_filename);
+    std::string line;
+    int lines = 0;
+    while (std::getline(file, line)) {
+        TEST_ASSERT(line.find("\"buffered\" " + std::to_string(lines)) != std::string::npos, "Unexpected line: " + line);
+        ++lines;
+    }
+    TEST_ASSERT(lines == 13, "Expected 13 lines in file");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест бэкенда io_uring (или запасного pwrite): строки доходят до файла в исходном порядке,
+// а при занятых буферах append() возвращает управление, приняв только часть данных
+bool test_uring_writer() {
+    const std::string test_filename = "test_uring_metrics.txt";
+    setup_test_environment(test_filename);
+
+    WriterOptions options;
+    options.backend = WriterBackend::IoUring;
+    options.flush_bytes = 4096;
+    {
+        MetricsWriter writer(test_filename, options);
+        for (int i = 0; i < 1000; ++i) {
+            writer.write({{"uring", std::to_string(i)}});
+        }
+        writer.flush();
+        TEST_ASSERT(writer.getStats().errors == 0, "Backend reported write errors");
+    }
+
+    std::ifstream file(test_filename);
+    std::string line;
+    int lines = 0;
+    while (std::getline(file, line)) {
+        TEST_ASSERT(line.find("\"uring\" " + std::to_string(lines)) != std::string::npos, "Unexpected line: " + line);
+        ++lines;
+    }
+    TEST_ASSERT(lines == 1000, "Expected 1000 lines in file");
+    teardown_test_environment(test_filename);
+
+    // Запись в FIFO, из которого никто не читает, не завершается: буфер остается занятым.
+    // Один буфер сохраняет порядок данных в канале
+    const std::string fifo_name = "test_uring.fifo";
+    setup_test_environment(fifo_name);
+    TEST_ASSERT(::mkfifo(fifo_name.c_str(), 0644) == 0, "Failed to create FIFO");
+    int reader = ::open(fifo_name.c_str(), O_RDONLY | O_NONBLOCK);
+    {
+        UringFileBackend backend(fifo_name, 4096, 1);
+        std::string data(256 * 1024, '\0');
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<char>('a' + i % 26);
+        }
+        std::size_t accepted = backend.append(data.data(), data.size());
+        if (backend.usingUring()) {
+            TEST_ASSERT(accepted < data.size() && backend.stalls() == 1, "append() waited for a busy buffer");
+        }
+        std::string received;
+        char buffer[65536];
+        for (int attempt = 0; attempt < 100000 && received.size() < data.size(); ++attempt) {
+            if (accepted < data.size()) {
+                accepted += backend.append(data.data() + accepted, data.size() - accepted);
+            }
+            ssize_t count = ::read(reader, buffer, sizeof(buffer));
+            if (count > 0) {
+                received.append(buffer, static_cast<std::size_t>(count));
+            }
+        }
+        backend.drain();
+        TEST_ASSERT(received == data && backend.errors() == 0, "Data written after stalls was corrupted");
+    }
+    ::close(reader);
+    teardown_test_environment(fifo_name);
+    return true;
+}
+
+// Тест mmap-бэкенда: заголовок с длиной данных, отрезание хвоста экстента и продолжение записи
+bool test_mmap_writer() {
+    const std::string test_filename = "test_mmap_metrics.txt";
+    setup_test_environment(test_filename);
+
+    WriterOptions options;
+    options.backend = WriterBackend::Mmap;
+    options.mmap_extent = 4096;
+    for (int round = 0; round < 2; ++round) {
+        MetricsWriter writer(test_filename, options);
+        for (int i = 0; i < 100; ++i) {
+            writer.write({{"mmap", std::to_string(round * 100 + i)}});
+        }
+        writer.flush();
+        TEST_ASSERT(writer.getStats().errors == 0, "Backend reported write errors");
+    }
+
+    std::ifstream file(test_filename, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    TEST_ASSERT(content.size() > sizeof(MmapFileHeader), "File is too short");
+    MmapFileHeader header;
+    std::memcpy(&header, content.data(), sizeof(header));
+    TEST_ASSERT(std::memcmp(header.magic, MmapFileHeader::kMagic, sizeof(header.magic)) == 0, "Invalid header magic");
+    TEST_ASSERT(sizeof(MmapFileHeader) + header.committed == content.size(), "File was not truncated to committed length");
+
+    std::istringstream data(content.substr(sizeof(MmapFileHeader)));
+    std::string line;
+    int lines = 0;
+    while (std::getline(data, line)) {
+        TEST_ASSERT(line.find("\"mmap\" " + std::to_string(lines)) != std::string::npos, "Unexpected line: " + line);
+        ++lines;
+    }
+    TEST_ASSERT(lines == 200, "Expected 200 lines in file");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест ротации по размеру: лимит хранения и сжатие закрытых сегментов
+bool test_rotation() {
+    const std::string test_filename = "test_rotated_metrics.txt";
+    setup_test_environment(test_filename);
+    for (const auto &segment : SegmentArchiver::listSegments(test_filename)) {
+        std::remove(segment.c_str());
+    }
+
+    WriterOptions options;
+    options.rotate_bytes = 256;
+    options.retention = 2;
+    options.compress_rotated = true;
+    {
+        MetricsWriter writer(test_filename, options);
+        for (int i = 0; i < 50; ++i) {
+            writer.write({{"rotated", std::to_string(i)}});
+        }
+        writer.flush();
+        TEST_ASSERT(writer.getStats().rotations >= 3, "File was not rotated");
+    }
+
+    auto segments = SegmentArchiver::listSegments(test_filename);
+    TEST_ASSERT(segments.size() == 2, "Retention limit was not applied");
+    std::string content;
+    for (const auto &segment : segments) {
+        TEST_ASSERT(segment.size() > 3 && segment.compare(segment.size() - 3, 3, ".gz") == 0,
+                    "Segment was not compressed: " + segment);
+        gzFile gz = gzopen(segment.c_str(), "rb");
+        TEST_ASSERT(gz != nullptr, "Cannot open segment: " + segment);
+        char buffer[4096];
+        int read;
+        while ((read = gzread(gz, buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, read);
+        }
+        gzclose(gz);
+        std::remove(segment.c_str());
+    }
+    std::ifstream file(test_filename);
+    content.append((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Сохраненные сегменты и активный файл вместе содержат последние строки без пропусков
+    std::istringstream lines(content);
+    std::string line;
+    std::vector<int> values;
+    while (std::getline(lines, line)) {
+        values.push_back(std::stoi(line.substr(line.rfind(' ') + 1)));
+    }
+    TEST_ASSERT(!values.empty() && values.back() == 49, "Last line is missing");
+    for (std::size_t i = 1; i < values.size(); ++i) {
+        TEST_ASSERT(values[i] == values[i - 1] + 1, "Lines were lost during rotation");
+    }
+    teardown_test_environment(test_filename);
+
+    // Пустой отображенный файл (только заголовок) на границе периода не превращается в сегмент
+    {
+        VirtualClock clock;
+        WriterOptions mmap_options;
+        mmap_options.backend = WriterBackend::Mmap;
+        mmap_options.mmap_extent = 64 * 1024;
+        mmap_options.rotate_interval = std::chrono::hours(1);
+        mmap_options.clock = &clock;
+        MetricsWriter writer(test_filename, mmap_options);
+        clock.advance(std::chrono::hours(2));
+        writer.write({{"rotated", "0"}});
+        writer.flush();
+        TEST_ASSERT(writer.getStats().rotations == 0, "Empty mmap file was rotated");
+    }
+    TEST_ASSERT(SegmentArchiver::listSegments(test_filename).empty(), "Empty mmap file became a segment");
+    teardown_test_environment(test_filename);
+
+    // Если новый файл не открывается, ошибка учитывается, а запись продолжается в прежний файл
+    {
+        WriterOptions failing_options;
+        failing_options.rotate_bytes = 256;
+        MetricsWriter writer(test_filename, failing_options);
+        rlimit saved{};
+        getrlimit(RLIMIT_NOFILE, &saved);
+        int probe = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        ::close(probe);
+        rlimit limited = saved;
+        limited.rlim_cur = static_cast<rlim_t>(probe);
+        setrlimit(RLIMIT_NOFILE, &limited);
+        for (int i = 0; i < 20; ++i) {
+            writer.write({{"rotated", std::to_string(i)}});
+        }
+        writer.flush();
+        setrlimit(RLIMIT_NOFILE, &saved);
+        WriterStats stats = writer.getStats();
+        TEST_ASSERT(stats.rotations == 0 && stats.errors > 0, "Failed reopening was not counted");
+        writer.write({{"rotated", "20"}});
+        writer.flush();
+        TEST_ASSERT(writer.getStats().rotations == 1, "Rotation did not recover after the failure");
+    }
+    auto recovered = SegmentArchiver::listSegments(test_filename);
+    TEST_ASSERT(recovered.size() == 1, "Expected one segment after recovery");
+    std::ifstream segment_file(recovered[0]);
+    int segment_lines = 0;
+    while (std::getline(segment_file, line)) {
+        ++segment_lines;
+    }
+    std::remove(recovered[0].c_str());
+    TEST_ASSERT(segment_lines == 21, "Lines written while reopening failed were lost");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест двоичного формата на данных, похожих на реальные (Gauge со случайным блужданием,
+// Counter с разбросом значений): значения восстанавливаются без потерь через все бэкенды записи,
+// смена набора метрик приводит к новому словарю, а файл минимум в 10 раз меньше текстового;
+// Gauge без фиксированной точности хранятся XOR без потерь
+bool test_binary_format() {
+    const std::string binary_filename = "test_binary_metrics.bin";
+    const std::string text_filename = "test_binary_metrics.txt";
+    setup_test_environment(text_filename);
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> jitter(0.0, 1.5);
+    std::uniform_int_distribution<int> spread(-200, 200);
+    std::vector<double> levels(51);
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        levels[i] = 20.0 + static_cast<double>(i);
+    }
+    std::vector<Snapshot> snapshots;
+    for (int row = 0; row < 200; ++row) {
+        Snapshot snapshot;
+        int metrics = row < 150 ? 50 : 51;
+        for (int i = 0; i < metrics; ++i) {
+            // Значения с точностью вывода, как у Gauge с двумя знаками после запятой
+            levels[i] = std::max(0.0, levels[i] + jitter(generator));
+            MetricSample gauge;
+            gauge.name = "gauge_metric_" + std::to_string(i);
+            gauge.type = MetricType::Gauge;
+            gauge.gauge = std::round(levels[i] * 100.0) / 100.0;
+            snapshot.samples.push_back(gauge);
+
+            MetricSample counter;
+            counter.name = "counter_metric_" + std::to_string(i);
+            counter.type = MetricType::Counter;
+            counter.counter = 1000 + 10 * i + spread(generator);
+            snapshot.samples.push_back(counter);
+        }
+        snapshots.push_back(std::move(snapshot));
+    }
+    {
+        MetricsWriter text(text_filename);
+        for (const Snapshot &snapshot : snapshots) {
+            text.write(snapshot);
+        }
+    }
+    std::ifstream text_file(text_filename, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(text_file)), std::istreambuf_iterator<char>());
+
+    for (WriterBackend backend : {WriterBackend::Posix, WriterBackend::IoUring, WriterBackend::Mmap}) {
+        const std::string backend_name = std::to_string(static_cast<int>(backend));
+        setup_test_environment(binary_filename);
+        WriterOptions binary_options;
+        binary_options.format = OutputFormat::Binary;
+        binary_options.binary_block_rows = 64;
+        binary_options.backend = backend;
+        binary_options.mmap_extent = 64 * 1024;
+        {
+            MetricsWriter binary(binary_filename, binary_options);
+            for (const Snapshot &snapshot : snapshots) {
+                binary.write(snapshot);
+            }
+        }
+
+        std::ifstream binary_file(binary_filename, std::ios::binary);
+        std::string binary((std::istreambuf_iterator<char>(binary_file)), std::istreambuf_iterator<char>());
+        if (backend == WriterBackend::Mmap) {
+            MmapFileHeader header;
+            TEST_ASSERT(binary.size() >= sizeof(header), "Mmap file is too short");
+            std::memcpy(&header, binary.data(), sizeof(header));
+            binary = binary.substr(sizeof(header), header.committed);
+        }
+        TEST_ASSERT(BinaryDecoder::hasMagic(binary.data(), binary.size()), "Missing binary magic, backend " + backend_name);
+        TEST_ASSERT(binary.size() * 10 <= text.size(), "Binary format is not 10x smaller: " +
+                    std::to_string(binary.size()) + " vs " + std::to_string(text.size()));
+
+        BinaryDecoder decoder(binary.data(), binary.size());
+        BinaryBlock block;
+        std::size_t row = 0;
+        std::int64_t prev_ts = 0;
+        while (decoder.next(block)) {
+            for (std::size_t r = 0; r < block.timestamps.size(); ++r, ++row) {
+                TEST_ASSERT(row < snapshots.size(), "Too many rows decoded");
+                const Snapshot &expected = snapshots[row];
+                TEST_ASSERT(block.columns.size() == expected.samples.size(), "Unexpected column count");
+                TEST_ASSERT(block.timestamps[r] >= prev_ts, "Timestamps are not monotonic");
+                prev_ts = block.timestamps[r];
+                for (std::size_t c = 0; c < block.columns.size(); ++c) {
+                    const MetricSample &sample = expected.samples[c];
+                    TEST_ASSERT(block.columns[c].name == sample.name, "Unexpected column name");
+                    if (sample.type == MetricType::Gauge) {
+                        TEST_ASSERT(block.columns[c].gauges[r] == sample.gauge && block.columns[c].precision == 2,
+                                    "Gauge value mismatch");
+                    } else {
+                        TEST_ASSERT(block.columns[c].counters[r] == sample.counter, "Counter value mismatch");
+                    }
+                }
+            }
+        }
+        TEST_ASSERT(!decoder.error(), "Decoder reported a format error, backend " + backend_name);
+        TEST_ASSERT(row == 200, "Expected 200 rows, decoded " + std::to_string(row) + ", backend " + backend_name);
+    }
+
+    // Кратчайшая точность и значения, не помещающиеся в целые после масштабирования, хранятся XOR без потерь
+    BinaryEncoder encoder(4);
+    std::string encoded;
+    encoder.begin(encoded, true);
+    const double exact[] = {0.1 + 0.2, 1.0 / 3.0, 2.5e-7};
+    const double huge[] = {1e300, -1e17, std::numeric_limits<double>::infinity()};
+    for (int r = 0; r < 3; ++r) {
+        Snapshot snapshot;
+        MetricSample shortest;
+        shortest.name = "shortest";
+        shortest.type = MetricType::Gauge;
+        shortest.precision = kShortestPrecision;
+        shortest.gauge = exact[r];
+        MetricSample large = shortest;
+        large.name = "large";
+        large.precision = 2;
+        large.gauge = huge[r];
+        snapshot.samples = {shortest, large};
+        encoder.add(snapshot, 1000 * r, encoded);
+    }
+    encoder.finishBlock(encoded);
+    BinaryDecoder decoder(encoded.data(), encoded.size());
+    BinaryBlock block;
+    TEST_ASSERT(decoder.next(block) && block.timestamps.size() == 3, "Failed to decode XOR gauges");
+    TEST_ASSERT(block.columns[0].precision == kShortestPrecision && block.columns[1].precision == kShortestPrecision,
+                "Unscalable gauges were not stored with XOR");
+    for (int r = 0; r < 3; ++r) {
+        TEST_ASSERT(block.columns[0].gauges[r] == exact[r] && block.columns[1].gauges[r] == huge[r],
+                    "XOR gauge value mismatch");
+    }
+
+    teardown_test_environment(binary_filename);
+    teardown_test_environment(text_filename);
+    return true;
+}
+
+// Тест MetricsReader: запрос по диапазону времени в текстовом и двоичном файлах
+// читает только часть файла, а индекс текстового файла сохраняется и дополняется
+bool test_metrics_reader() {
+    const std::string text_filename = "test_reader_metrics.txt";
+    const std::string binary_filename = "test_reader_metrics.bin";
+    setup_test_environment(text_filename);
+    setup_test_environment(text_filename + ".idx");
+    setup_test_environment(binary_filename);
+
+    // Текстовый файл с известными метками времени: одна строка в секунду
+    const std::int64_t base_ms = 1700000000000;
+    auto writeText = [&](int from_row, int to_row) {
+        std::ofstream out(text_filename, std::ios::app);
+        for (int row = from_row; row < to_row; ++row) {
+            std::time_t seconds = static_cast<std::time_t>((base_ms + row * 1000) / 1000);
+            std::tm tm;
+            localtime_r(&seconds, &tm);
+            char stamp[32];
+            std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+            out << stamp << ".000 \"CPU\" " << row << " \"Other\" 1\n";
+        }
+    };
+    writeText(0, 5000);
+
+    ReaderOptions options;
+    options.index_stride = 4096;
+    {
+        MetricsReader reader(text_filename, options);
+        TEST_ASSERT(reader.format() == MetricsReader::Format::Text, "Text format was not detected");
+        TEST_ASSERT(reader.indexSize() > 10, "Text index was not built");
+        auto points = reader.query("CPU", base_ms + 1000 * 1000, base_ms + 1009 * 1000);
+        TEST_ASSERT(points.size() == 10, "Expected 10 points, got " + std::to_string(points.size()));
+        TEST_ASSERT(points.front().sample.text == "1000" && points.back().sample.text == "1009", "Unexpected values");
+        TEST_ASSERT(reader.lastScannedBytes() < 3 * options.index_stride, "Query did not use the index");
+    }
+    writeText(5000, 6000);
+    {
+        MetricsReader reader(text_filename, options);
+        auto points = reader.query("CPU", base_ms + 5500 * 1000, base_ms + 5500 * 1000);
+        TEST_ASSERT(points.size() == 1 && points[0].sample.text == "5500", "Appended tail was not indexed");
+        TEST_ASSERT(reader.query("Missing", base_ms, base_ms + 6000 * 1000).empty(), "Found a missing metric");
+    }
+
+    // Двоичный файл читается одинаково при записи через write(2) и в отображенный файл с заголовком
+    for (WriterBackend backend : {WriterBackend::Posix, WriterBackend::Mmap}) {
+        setup_test_environment(binary_filename);
+        WriterOptions binary_options;
+        binary_options.format = OutputFormat::Binary;
+        binary_options.binary_block_rows = 16;
+        binary_options.backend = backend;
+        binary_options.mmap_extent = 64 * 1024;
+        {
+            MetricsWriter writer(binary_filename, binary_options);
+            for (int row = 0; row < 200; ++row) {
+                Snapshot snapshot;
+                MetricSample sample;
+                sample.name = "HTTP";
+                sample.type = MetricType::Counter;
+                sample.counter = row;
+                snapshot.samples.push_back(sample);
+                writer.write(std::move(snapshot));
+            }
+        }
+        MetricsReader reader(binary_filename);
+        TEST_ASSERT(reader.format() == MetricsReader::Format::Binary, "Binary format was not detected");
+        TEST_ASSERT(reader.indexSize() >= 13, "Binary block index was not built");
+        auto all = reader.query("HTTP", 0, std::numeric_limits<std::int64_t>::max());
+        TEST_ASSERT(all.size() == 200, "Expected 200 points");
+        std::int64_t from = all[100].timestamp_ms;
+        auto points = reader.query("HTTP", from, from);
+        TEST_ASSERT(!points.empty() && points.front().sample.counter <= 100 && points.back().sample.counter >= 100,
+                    "Range query returned unexpected values");
+    }
+
+    teardown_test_environment(text_filename);
+    teardown_test_environment(text_filename + ".idx");
+    teardown_test_environment(binary_filename);
+    return true;
+}
+
+// Тест TimestampFormatter: UTC для известных моментов и совпадение с localtime/strftime при переходе секунд
+bool test_timestamp_formatter() {
+    TimestampFormatter utc(TimestampFormatter::Zone::Utc);
+    char out[TimestampFormatter::kLength];
+    utc.format(INT64_C(1709251199999), out);
+    TEST_ASSERT(std::string(out, sizeof(out)) == "2024-02-29 23:59:59.999", "Unexpected UTC timestamp");
+    utc.format(INT64_C(1709251200000), out);
+    TEST_ASSERT(std::string(out, sizeof(out)) == "2024-03-01 00:00:00.000", "Cached prefix was not refreshed");
+    utc.format(INT64_C(-1), out);
+    TEST_ASSERT(std::string(out, sizeof(out)) == "1969-12-31 23:59:59.999", "Negative time was not floored");
+
+    TimestampFormatter local;
+    std::int64_t base_ms = INT64_C(1700000000000);
+    for (std::int64_t ms = base_ms; ms < base_ms + 3 * 86400 * 1000; ms += 7777777) {
+        local.format(ms, out);
+        std::time_t seconds = static_cast<std::time_t>(ms / 1000);
+        std::tm tm;
+        localtime_r(&seconds, &tm);
+        char expected[32];
+        std::size_t length = std::strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", &tm);
+        std::snprintf(expected + length, sizeof(expected) - length, ".%03d", static_cast<int>(ms % 1000));
+        TEST_ASSERT(std::string(out, sizeof(out)) == expected,
+                    "Local timestamp mismatch: " + std::string(out, sizeof(out)) + " != " + expected);
+    }
+    return true;
+}
+
+// Тест форматирования значений: фиксированная точность, кратчайшее представление, запись в файл
+bool test_value_format() {
+    std::string out;
+    appendGauge(out, 3.14159, 3);
+    TEST_ASSERT(out == "3.142", "Unexpected fixed value: " + out);
+    out.clear();
+    appendGauge(out, 0.1, kShortestPrecision);
+    TEST_ASSERT(out == "0.1", "Unexpected shortest value: " + out);
+    out.clear();
+    appendGauge(out, 1e300, 2);
+    TEST_ASSERT(std::stod(out) == 1e300, "Large value was not formatted: " + out);
+    out.clear();
+    appendCounter(out, std::numeric_limits<std::int64_t>::min());
+    TEST_ASSERT(out == "-9223372036854775808", "Unexpected counter value: " + out);
+
+    Gauge shortest("shortest", kShortestPrecision);
+    shortest.update(0.30000000000000004);
+    TEST_ASSERT(std::stod(shortest.getValueAsString()) == 0.30000000000000004, "Value does not round-trip");
+
+    const std::string test_filename = "test_value_format.txt";
+    setup_test_environment(test_filename);
+    auto precise = std::make_shared<Gauge>("Precise", 4);
+    {
+        MetricsCollector collector(test_filename);
+        collector.addMetric(precise);
+        precise->update(2.5);
+        collector.collectAndWrite();
+    }
+    std::ifstream file(test_filename);
+    std::string line;
+    std::getline(file, line);
+    TEST_ASSERT(line.find("\"Precise\" 2.5000") != std::string::npos, "Precision was not applied: " + line);
+    file.close();
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест форматов Csv/Tsv: заголовок только при смене набора метрик, экранирование, чтение MetricsReader
+bool test_delimited_format() {
+    const std::string csv_filename = "test_metrics.csv";
+    const std::string tsv_filename = "test_metrics.tsv";
+    setup_test_environment(csv_filename);
+    setup_test_environment(tsv_filename);
+
+    auto makeSnapshot = [](int row, bool extra) {
+        Snapshot snapshot;
+        MetricSample cpu;
+        cpu.name = "CPU";
+        cpu.type = MetricType::Gauge;
+        cpu.gauge = row + 0.5;
+        snapshot.samples.push_back(cpu);
+        MetricSample status;
+        status.name = "Status, text";
+        status.text = "a\t\"b\"";
+        snapshot.samples.push_back(status);
+        if (extra) {
+            MetricSample http;
+            http.name = "HTTP";
+            http.type = MetricType::Counter;
+            http.counter = row;
+            snapshot.samples.push_back(http);
+        }
+        return snapshot;
+    };
+
+    for (OutputFormat format : {OutputFormat::Csv, OutputFormat::Tsv}) {
+        const std::string &filename = format == OutputFormat::Csv ? csv_filename : tsv_filename;
+        WriterOptions options;
+        options.format = format;
+        {
+            MetricsWriter writer(filename, options);
+            for (int row = 0; row < 10; ++row) {
+                writer.write(makeSnapshot(row, row >= 5));
+            }
+        }
+
+        std::ifstream file(filename);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+        TEST_ASSERT(lines.size() == 12, "Expected 2 headers and 10 rows, got " + std::to_string(lines.size()));
+        if (format == OutputFormat::Csv) {
+            TEST_ASSERT(lines[0] == "timestamp,CPU,\"Status, text\"", "Unexpected CSV header: " + lines[0]);
+            TEST_ASSERT(lines[1].substr(23) == ",0.50,\"a\t\"\"b\"\"\"", "Unexpected CSV row: " + lines[1]);
+            TEST_ASSERT(lines[6] == "timestamp,CPU,\"Status, text\",HTTP", "Header was not repeated: " + lines[6]);
+        } else {
+            TEST_ASSERT(lines[0] == "timestamp\tCPU\tStatus, text", "Unexpected TSV header: " + lines[0]);
+            TEST_ASSERT(lines[1].substr(23) == "\t0.50\ta\\t\"b\"", "Unexpected TSV row: " + lines[1]);
+        }
+
+        MetricsReader reader(filename);
+        TEST_ASSERT(reader.format() == (format == OutputFormat::Csv ? MetricsReader::Format::Csv : MetricsReader::Format::Tsv),
+                    "Delimited format was not detected");
+        auto all = std::numeric_limits<std::int64_t>::max();
+        auto cpu = reader.query("CPU", 0, all);
+        TEST_ASSERT(cpu.size() == 10 && cpu.back().sample.text == "9.50", "Unexpected CPU values");
+        auto http = reader.query("HTTP", 0, all);
+        TEST_ASSERT(http.size() == 5 && http.front().sample.text == "5", "Unexpected HTTP values");
+        auto status = reader.query("Status, text", 0, all);
+        TEST_ASSERT(status.size() == 10 && status[0].sample.text == "a\t\"b\"", "Text value was not unescaped");
+    }
+
+    teardown_test_environment(csv_filename);
+    teardown_test_environment(csv_filename + ".idx");
+    teardown_test_environment(tsv_filename);
+    teardown_test_environment(tsv_filename + ".idx");
+    return true;
+}
+
+// Отправляет HTTP-запрос на 127.0.0.1:port и возвращает весь ответ (соединение закрывается сервером).
+// half_close закрывает сторону клиента сразу после запроса, как curl или прокси после последнего запроса
+std::string http_request(std::uint16_t port, const std::string &request, bool half_close = false) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string response;
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+        if (half_close) {
+            ::shutdown(fd, SHUT_WR);
+        }
+        char buffer[4096];
+        ssize_t received;
+        while ((received = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<std::size_t>(received));
+        }
+    }
+    ::close(fd);
+    return response;
+}
+
+// Тест PrometheusExporter: ответ по /metrics из последнего снимка, накопление Counter, 404, HEAD и полузакрытие
+bool test_prometheus_exporter() {
+    const std::string test_filename = "test_prometheus.txt";
+    setup_test_environment(test_filename);
+
+    PrometheusOptions options;
+    options.port = 0;
+    options.prefix = "app_";
+    auto exporter = std::make_shared<PrometheusExporter>(options);
+    TEST_ASSERT(exporter->port() != 0, "Exporter did not bind a port");
+
+    auto cpu = std::make_shared<Gauge>("CPU");
+    auto requests = std::make_shared<Counter>("HTTP requests");
+    auto latency = std::make_shared<Histogram>("latency", std::vector<double>{0.1, 1});
+    {
+        MetricsCollector collector(test_filename);
+        collector.addMetric(cpu);
+        collector.addMetric(requests);
+        collector.addMetric(latency);
+        collector.addSink(exporter);
+        cpu->update(0.75);
+        requests->increment(3);
+        latency->observe(0.05);
+        collector.collectAndWrite();
+        requests->increment(4);
+        latency->observe(0.5);
+        latency->observe(2);
+        collector.collectAndWrite();
+    }
+
+    const std::string get = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::string response;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        response = http_request(exporter->port(), get);
+        if (response.find("app_HTTP_requests_total 7") != std::string::npos) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    TEST_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0, "Unexpected status: " + response);
+    TEST_ASSERT(response.find("# TYPE app_CPU gauge\napp_CPU 0\n") != std::string::npos, "Gauge not exported: " + response);
+    TEST_ASSERT(response.find("# TYPE app_HTTP_requests_total counter\napp_HTTP_requests_total 7\n") != std::string::npos,
+                "Counter was not accumulated: " + response);
+    TEST_ASSERT(response.find("# TYPE app_latency histogram\napp_latency_bucket{le=\"0.1\"} 1\n"
+                              "app_latency_bucket{le=\"1\"} 2\napp_latency_bucket{le=\"+Inf\"} 3\n"
+                              "app_latency_sum 2.55\napp_latency_count 3\n") != std::string::npos,
+                "Histogram was not accumulated: " + response);
+
+    std::string head = http_request(exporter->port(), "HEAD /metrics HTTP/1.0\r\n\r\n");
+    TEST_ASSERT(head.compare(0, 15, "HTTP/1.1 200 OK") == 0 && head.find("app_CPU") == std::string::npos,
+                "HEAD returned a body: " + head);
+    std::string missing = http_request(exporter->port(), "GET /other HTTP/1.1\r\nConnection: close\r\n\r\n");
+    TEST_ASSERT(missing.compare(0, 12, "HTTP/1.1 404") == 0, "Expected 404: " + missing);
+    // Запрос и EOF приходят одним чтением: ответ отправляется до закрытия соединения
+    std::string half_closed = http_request(exporter->port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", true);
+    TEST_ASSERT(half_closed.compare(0, 15, "HTTP/1.1 200 OK") == 0 &&
+                    half_closed.find("app_HTTP_requests_total 7\n") != std::string::npos,
+                "No response after half-close: " + half_closed);
+    TEST_ASSERT(exporter->scrapes() >= 2, "Scrapes were not counted");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест StatsdSink: строки упаковываются в датаграммы не больше max_datagram и доходят до агента,
+// отрицательные gauge обнуляются в той же датаграмме, нечисловые значения не отправляются
+bool test_statsd_sink() {
+    int agent = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    TEST_ASSERT(::bind(agent, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+                    ::getsockname(agent, reinterpret_cast<sockaddr *>(&address), &length) == 0,
+                "Failed to bind the test agent");
+    timeval timeout{1, 0};
+    ::setsockopt(agent, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    StatsdOptions options;
+    options.port = ntohs(address.sin_port);
+    options.prefix = "app.";
+    options.tags = {"env:test"};
+    options.max_datagram = 200;
+
+    auto snapshot = std::make_shared<Snapshot>();
+    for (int i = 0; i < 50; ++i) {
+        MetricSample sample;
+        sample.name = "metric " + std::to_string(i);
+        sample.type = i % 2 == 0 ? MetricType::Gauge : MetricType::Counter;
+        sample.gauge = i + 0.5;
+        sample.counter = i;
+        snapshot->samples.push_back(sample);
+    }
+    // Отрицательный gauge, NaN и текстовые -2 и -inf
+    const double gauges[] = {-3.5, std::nan("")};
+    for (double value : gauges) {
+        MetricSample sample;
+        sample.name = "temperature";
+        sample.type = MetricType::Gauge;
+        sample.gauge = value;
+        snapshot->samples.push_back(sample);
+    }
+    for (const char *text : {"-2", "-inf"}) {
+        MetricSample sample;
+        sample.name = "level";
+        sample.type = MetricType::Text;
+        sample.text = text;
+        snapshot->samples.push_back(sample);
+    }
+    StatsdStats stats;
+    {
+        StatsdSink sink(options);
+        sink.publish(snapshot);
+        for (int attempt = 0; attempt < 100 && sink.getStats().snapshots == 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        stats = sink.getStats();
+    }
+
+    std::vector<std::string> lines;
+    std::vector<std::string> packets;
+    char buffer[2048];
+    for (std::uint64_t i = 0; i < stats.datagrams; ++i) {
+        ssize_t received = ::recv(agent, buffer, sizeof(buffer), 0);
+        TEST_ASSERT(received > 0 && received <= 200, "Unexpected datagram size: " + std::to_string(received));
+        packets.emplace_back(buffer, static_cast<std::size_t>(received));
+        std::stringstream packet(packets.back());
+        std::string line;
+        while (std::getline(packet, line)) {
+            lines.push_back(line);
+        }
+    }
+    ::close(agent);
+
+    TEST_ASSERT(stats.snapshots == 1 && stats.dropped_datagrams == 0, "Snapshot was not sent");
+    TEST_ASSERT(stats.datagrams > 1 && stats.send_calls == 1, "Datagrams were not batched into one sendmmsg");
+    TEST_ASSERT(lines.size() == 54, "Expected 54 lines, got " + std::to_string(lines.size()));
+    TEST_ASSERT(lines[0] == "app.metric_0:0.5|g|#env:test", "Unexpected gauge line: " + lines[0]);
+    TEST_ASSERT(lines[1] == "app.metric_1:1|c|#env:test", "Unexpected counter line: " + lines[1]);
+    auto sent_together = [&](const std::string &pair) {
+        return std::any_of(packets.begin(), packets.end(),
+                           [&](const std::string &packet) { return packet.find(pair) != std::string::npos; });
+    };
+    TEST_ASSERT(sent_together("app.temperature:0|g|#env:test\napp.temperature:-3.5|g|#env:test"),
+                "Negative gauge was not reset in the same datagram");
+    TEST_ASSERT(sent_together("app.level:0|g|#env:test\napp.level:-2|g|#env:test"),
+                "Negative text gauge was not reset in the same datagram");
+    TEST_ASSERT(std::count(lines.begin(), lines.end(), "app.temperature:0|g|#env:test") == 1 &&
+                    std::find(lines.begin(), lines.end(), "app.level:-inf|g|#env:test") == lines.end(),
+                "Non-finite values were sent");
+    return true;
+}
+
+// Тест InfluxSink: формат строк, пакеты gzip в файле и отправка в Unix-сокет
+bool test_influx_sink() {
+    const std::string lp_filename = "test_metrics.lp";
+    const std::string gz_filename = "test_metrics.lp.gz";
+    const std::string socket_path = "test_influx.sock";
+    setup_test_environment(lp_filename);
+    setup_test_environment(gz_filename);
+    setup_test_environment(socket_path);
+
+    auto snapshot = std::make_shared<Snapshot>();
+    MetricSample cpu;
+    cpu.name = "CPU load";
+    cpu.type = MetricType::Gauge;
+    cpu.gauge = 0.5;
+    MetricSample requests;
+    requests.name = "HTTP";
+    requests.type = MetricType::Counter;
+    requests.counter = 42;
+    MetricSample status;
+    status.name = "status";
+    status.text = "say \"ok\"";
+    snapshot->samples = {cpu, requests, status};
+
+    InfluxOptions options;
+    options.path = lp_filename;
+    options.tags = {{"host", "web 1"}};
+    {
+        InfluxSink sink(options);
+        sink.publish(snapshot);
+        sink.publish(snapshot);
+        sink.flush();
+        InfluxStats stats = sink.getStats();
+        TEST_ASSERT(stats.points == 2 && stats.batches == 1, "Points were not batched");
+    }
+    std::ifstream file(lp_filename);
+    std::string line;
+    std::getline(file, line);
+    const std::string expected = "metrics,host=web\\ 1 CPU\\ load=0.5,HTTP=42i,status=\"say \\\"ok\\\"\" ";
+    TEST_ASSERT(line.compare(0, expected.size(), expected) == 0, "Unexpected line: " + line);
+    TEST_ASSERT(line.size() - expected.size() == 19, "Timestamp is not in nanoseconds: " + line);
+    file.close();
+
+    options.path = gz_filename;
+    options.gzip = true;
+    {
+        InfluxSink sink(options);
+        for (int batch = 0; batch < 3; ++batch) {
+            sink.publish(snapshot);
+            sink.flush();
+        }
+        TEST_ASSERT(sink.getStats().batches == 3, "Expected 3 gzip batches");
+    }
+    gzFile gz = ::gzopen(gz_filename.c_str(), "rb");
+    TEST_ASSERT(gz != nullptr, "Failed to open gzip output");
+    char buffer[4096];
+    int read = ::gzread(gz, buffer, sizeof(buffer));
+    ::gzclose(gz);
+    TEST_ASSERT(read > 0 && std::count(buffer, buffer + read, '\n') == 3, "Concatenated gzip batches were not readable");
+
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    TEST_ASSERT(::bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 && ::listen(server, 1) == 0,
+                "Failed to listen on a Unix socket");
+    InfluxOptions socket_options;
+    socket_options.target = InfluxTarget::Unix;
+    socket_options.path = socket_path;
+    {
+        InfluxSink sink(socket_options);
+        sink.publish(snapshot);
+        sink.flush();
+        TEST_ASSERT(sink.getStats().batches == 1 && sink.getStats().errors == 0, "Batch was not sent to the socket");
+    }
+    int client = ::accept(server, nullptr, nullptr);
+    std::string received;
+    ssize_t count;
+    while ((count = ::recv(client, buffer, sizeof(buffer), 0)) > 0) {
+        received.append(buffer, static_cast<std::size_t>(count));
+    }
+    ::close(client);
+    ::close(server);
+    TEST_ASSERT(received.compare(0, 8, "metrics ") == 0 && received.back() == '\n', "Unexpected socket data: " + received);
+
+    teardown_test_environment(lp_filename);
+    teardown_test_environment(gz_filename);
+    teardown_test_environment(socket_path);
+    return true;
+}
+
+// Пользовательский кодировщик: число метрик снимка и имя первой из них
+class SampleCountEncoder : public Encoder
+{
+public:
+    void begin(std::string &out, bool new_file) override {
+        out += new_file ? "begin\n" : "resume\n";
+    }
+    void encode(const Snapshot &snapshot, std::chrono::system_clock::time_point, std::string &out) override {
+        out += std::to_string(snapshot.samples.size()) + " " + snapshot.samples.front().name + "\n";
+    }
+};
+
+// Получатель, запоминающий переданные снимки
+class RecordingSink : public Sink
+{
+public:
+    void publish(std::shared_ptr<const Snapshot> snapshot) override { snapshots.push_back(std::move(snapshot)); }
+    std::vector<std::shared_ptr<const Snapshot>> snapshots;
+};
+
+bool test_sinks_encoders() {
+    const std::string test_filename = "test_metrics_encoder.txt";
+    setup_test_environment(test_filename);
+
+    auto gauge = std::make_shared<Gauge>("load");
+    auto counter = std::make_shared<Counter>("requests");
+    auto first = std::make_shared<MemorySink>();
+    auto second = std::make_shared<MemorySink>(makeEncoder(OutputFormat::Text));
+    auto csv = std::make_shared<MemorySink>(makeEncoder(OutputFormat::Csv));
+    auto recorder = std::make_shared<RecordingSink>();
+    MetricsCollector collector;
+    collector.addMetric(gauge);
+    collector.addMetric(counter);
+    collector.addSink(first);
+    collector.addSink(second);
+    collector.addSink(csv);
+    collector.addSink(recorder);
+    gauge->update(1.5);
+    counter->increment(3);
+    collector.collectAndWrite();
+
+    // Всем получателям передан один и тот же снимок; поля текстового формата нужны двоим и кодируются один раз
+    TEST_ASSERT(recorder->snapshots.size() == 1, "Snapshot was not published to a custom sink");
+    const Snapshot &snapshot = *recorder->snapshots.front();
+    TEST_ASSERT(snapshot.shared_encodings == encodingBit(SharedEncoding::TextFields),
+                "Unexpected shared encodings: " + std::to_string(snapshot.shared_encodings));
+    std::string first_text = first->take();
+    std::string second_text = second->take();
+    TEST_ASSERT(first_text.size() > TimestampFormatter::kLength &&
+                    first_text.substr(TimestampFormatter::kLength) == " \"load\" 1.50 \"requests\" 3\n",
+                "Unexpected text output: " + first_text);
+    TEST_ASSERT(second_text.substr(TimestampFormatter::kLength) == first_text.substr(TimestampFormatter::kLength),
+                "Shared text fields differ between sinks");
+    std::string csv_text = csv->take();
+    TEST_ASSERT(csv_text.compare(0, 24, "timestamp,load,requests\n") == 0, "Unexpected csv output: " + csv_text);
+    TEST_ASSERT(first->take().empty() && first->snapshots() == 1, "take() did not clear the buffer");
+
+    // Пользовательский кодировщик файла; пустой снимок не записывается
+    {
+        MetricsWriter writer(test_filename, std::make_unique<SampleCountEncoder>());
+        TEST_ASSERT(writer.sharedEncodings() == 0, "Custom encoder must not use shared encodings");
+        writer.write(snapshot);
+        writer.flush();
+    }
+    {
+        MetricsWriter writer(test_filename, std::make_unique<SampleCountEncoder>());
+        writer.publish(recorder->snapshots.front());
+        writer.publish(std::make_shared<Snapshot>());
+        writer.flush();
+    }
+    std::ifstream file(test_filename);
+    std::stringstream content;
+    content << file.rdbuf();
+    TEST_ASSERT(content.str() == "begin\n2 load\nresume\n2 load\n", "Unexpected custom encoder output: " + content.str());
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Поле сообщения protobuf: значение varint/fixed64 или содержимое поля с длиной
+struct ProtoField
+{
+    unsigned number = 0;
+    unsigned type = 0;
+    std::uint64_t value = 0;
+    std::string bytes;
+};
+
+bool read_proto_varint(const std::string &data, std::size_t &pos, std::uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; pos < data.size() && shift < 64; shift += 7) {
+        auto byte = static_cast<unsigned char>(data[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Разбирает поля верхнего уровня сообщения protobuf
+bool read_proto_fields(const std::string &data, std::vector<ProtoField> &fields) {
+    fields.clear();
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        ProtoField field;
+        std::uint64_t tag;
+        if (!read_proto_varint(data, pos, tag)) {
+            return false;
+        }
+        field.number = static_cast<unsigned>(tag >> 3);
+        field.type = static_cast<unsigned>(tag & 7);
+        if (field.type == 0) {
+            if (!read_proto_varint(data, pos, field.value)) {
+                return false;
+            }
+        } else if (field.type == 1) {
+            if (data.size() - pos < 8) {
+                return false;
+            }
+            for (int i = 0; i < 8; ++i) {
+                field.value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+            }
+            pos += 8;
+        } else if (field.type == 2) {
+            std::uint64_t length;
+            if (!read_proto_varint(data, pos, length) || length > data.size() - pos) {
+                return false;
+            }
+            field.bytes = data.substr(pos, length);
+            pos += length;
+        } else {
+            return false;
+        }
+        fields.push_back(std::move(field));
+    }
+    return true;
+}
+
+// Находит первое поле number в сообщении
+const ProtoField *find_proto_field(const std::vector<ProtoField> &fields, unsigned number) {
+    for (const auto &field : fields) {
+        if (field.number == number) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+bool test_otlp_encoder() {
+    const std::string socket_path = "test_otlp.sock";
+    setup_test_environment(socket_path);
+
+    auto latency = std::make_shared<Histogram>("latency", std::vector<double>{10, 1, 0.1});
+    TEST_ASSERT(latency->getBounds() == std::vector<double>({0.1, 1, 10}), "Histogram bounds were not sorted");
+    for (double value : {0.05, 0.1, 0.5, 5.0, 50.0}) {
+        latency->observe(value);
+    }
+    TEST_ASSERT(latency->getValueAsString() == "count=5;sum=55.65;0.1:2;1:1;10:1;+Inf:1",
+                "Unexpected histogram text: " + latency->getValueAsString());
+    auto requests = std::make_shared<Counter>("requests");
+    requests->increment(42);
+
+    Snapshot snapshot;
+    snapshot.samples.resize(4);
+    latency->collect(snapshot.samples[0]);
+    requests->collect(snapshot.samples[1]);
+    snapshot.samples[2].name = "ratio";
+    snapshot.samples[2].text = "0.5";
+    snapshot.samples[3].name = "status";
+    snapshot.samples[3].text = "ok";
+    TEST_ASSERT(latency->getValueAsString() == "count=0;sum=0;0.1:0;1:0;10:0;+Inf:0", "Histogram was not reset");
+
+    OtlpOptions options;
+    options.service_name = "test";
+    OtlpEncoder encoder(options);
+    std::string frame;
+    encoder.encode(snapshot, std::chrono::system_clock::now(), frame);
+
+    // Длина кадра, затем ExportMetricsServiceRequest.resource_metrics[0].scope_metrics[0].metrics
+    std::size_t pos = 0;
+    std::uint64_t length;
+    TEST_ASSERT(read_proto_varint(frame, pos, length) && length == frame.size() - pos, "Bad frame length");
+    std::vector<ProtoField> request, resource_metrics, scope_metrics, metric, data, point;
+    TEST_ASSERT(read_proto_fields(frame.substr(pos), request) && request.size() == 1, "Bad request");
+    TEST_ASSERT(read_proto_fields(request[0].bytes, resource_metrics), "Bad ResourceMetrics");
+    const ProtoField *scope = find_proto_field(resource_metrics, 2);
+    TEST_ASSERT(scope != nullptr && read_proto_fields(scope->bytes, scope_metrics), "Bad ScopeMetrics");
+    std::vector<std::string> names;
+    for (const auto &field : scope_metrics) {
+        if (field.number != 2) {
+            continue;
+        }
+        TEST_ASSERT(read_proto_fields(field.bytes, metric) && !metric.empty() && metric[0].number == 1, "Bad Metric");
+        names.push_back(metric[0].bytes);
+        // Counter — Sum (7) с точкой as_int (6), Histogram (9) — count (4) и 4 корзины (6)
+        if (metric[0].bytes == "requests") {
+            const ProtoField *sum = find_proto_field(metric, 7);
+            TEST_ASSERT(sum != nullptr && read_proto_fields(sum->bytes, data), "Counter is not a Sum");
+            TEST_ASSERT(read_proto_fields(data[0].bytes, point), "Bad NumberDataPoint");
+            const ProtoField *value = find_proto_field(point, 6);
+            TEST_ASSERT(value != nullptr && value->value == 42, "Bad counter value");
+        } else if (metric[0].bytes == "latency") {
+            const ProtoField *histogram = find_proto_field(metric, 9);
+            TEST_ASSERT(histogram != nullptr && read_proto_fields(histogram->bytes, data), "Histogram is missing");
+            TEST_ASSERT(read_proto_fields(data[0].bytes, point), "Bad HistogramDataPoint");
+            const ProtoField *count = find_proto_field(point, 4);
+            const ProtoField *buckets = find_proto_field(point, 6);
+            TEST_ASSERT(count != nullptr && count->value == 5, "Bad histogram count");
+            TEST_ASSERT(buckets != nullptr && buckets->bytes.size() == 4 * 8, "Bad histogram buckets");
+        }
+    }
+    TEST_ASSERT(names == std::vector<std::string>({"latency", "requests", "ratio"}),
+                "Non-numeric text must be skipped");
+
+    // Кадры через Unix-сокет: один кадр на снимок
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    TEST_ASSERT(::bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 && ::listen(server, 1) == 0,
+                "Failed to listen on a Unix socket");
+    UnixSocketOptions socket_options;
+    socket_options.path = socket_path;
+    {
+        UnixSocketSink sink(socket_options, std::make_unique<OtlpEncoder>(options));
+        auto shared = std::make_shared<const Snapshot>(snapshot);
+        sink.publish(shared);
+        sink.publish(shared);
+        sink.flush();
+        UnixSocketStats stats = sink.getStats();
+        TEST_ASSERT(stats.snapshots == 2 && stats.connects == 1 && stats.errors == 0, "Frames were not sent");
+    }
+    int client = ::accept(server, nullptr, nullptr);
+    std::string received;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = ::recv(client, buffer, sizeof(buffer), 0)) > 0) {
+        received.append(buffer, static_cast<std::size_t>(count));
+    }
+    ::close(client);
+    ::close(server);
+    int frames = 0;
+    for (pos = 0; pos < received.size() && read_proto_varint(received, pos, length); pos += length) {
+        ++frames;
+    }
+    TEST_ASSERT(frames == 2 && pos == received.size(), "Expected two length-delimited frames");
+
+    teardown_test_environment(socket_path);
+    return true;
+}
+
+// Тест Logger: записи из нескольких потоков не теряются и попадают в файл после flush()
+bool test_logger() {
+    const std::string tag = "test_logger_" + std::to_string(::getpid()) + "_" +
+                            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    const int kThreads = 4;
+    const int kRecords = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&tag, t] {
+            for (int i = 0; i < kRecords; ++i) {
+                Logger::getInstance().logInfo(tag + " " + std::to_string(t) + " " + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    Logger::getInstance().logError(tag + " done");
+    Logger::getInstance().flush();
+    TEST_ASSERT(Logger::getInstance().droppedRecords() == 0, "Records were dropped");
+
+    std::ifstream file("metrics.log");
+    std::string line;
+    int info = 0;
+    bool error = false;
+    while (std::getline(file, line)) {
+        std::size_t position = line.find(tag);
+        if (position == std::string::npos) {
+            continue;
+        }
+        TEST_ASSERT(line.size() > TimestampFormatter::kSecondsLength && line[4] == '-' && line[13] == ':',
+                    "Bad timestamp: " + line);
+        if (line.compare(TimestampFormatter::kSecondsLength, 8, " [INFO] ") == 0) {
+            ++info;
+        } else if (line.compare(TimestampFormatter::kSecondsLength, 9, " [ERROR] ") == 0 &&
+                   line.compare(position, std::string::npos, tag + " done") == 0) {
+            error = true;
+        }
+    }
+    TEST_ASSERT(info == kThreads * kRecords, "Expected " + std::to_string(kThreads * kRecords) + " records, got " +
+                                                 std::to_string(info));
+    TEST_ASSERT(error, "Error record was not written");
+    return true;
+}
+
+// Тест уровней журнала и отложенного форматирования
+bool test_log_levels() {
+    Logger &logger = Logger::getInstance();
+    const std::string tag = "test_log_levels_" + std::to_string(::getpid());
+    const LogLevel saved = logger.level();
+    logger.setLevel(LogLevel::Warn);
+
+    // Аргументы записи ниже порога не вычисляются
+    int evaluated = 0;
+    METRICS_LOG_INFO("{} hidden {}", tag, ++evaluated);
+    METRICS_LOG_DEBUG("{} hidden {}", tag, ++evaluated);
+    logger.logInfo(tag + " hidden");
+    TEST_ASSERT(evaluated == 0, "Arguments of a disabled record were evaluated");
+    TEST_ASSERT(!logger.enabled(LogLevel::Info) && logger.enabled(LogLevel::Warn), "Wrong threshold");
+
+    METRICS_LOG_WARN("{} warn {} {} {}", tag, 1, 2.5, true);
+    METRICS_LOG_ERROR("{} error {{}} {}", tag, std::string("text"));
+    logger.setLevel(LogLevel::Off);
+    METRICS_LOG_ERROR("{} hidden", tag);
+    logger.setLevel(saved);
+    logger.flush();
+
+    std::ifstream file("metrics.log");
+    std::string line;
+    std::vector<std::string> records;
+    while (std::getline(file, line)) {
+        if (line.find(tag) != std::string::npos) {
+            records.push_back(line.substr(TimestampFormatter::kSecondsLength));
+        }
+    }
+    TEST_ASSERT(records.size() == 2, "Expected 2 records, got " + std::to_string(records.size()));
+    TEST_ASSERT(records[0] == " [WARN] " + tag + " warn 1 2.5 true", "Bad record: " + records[0]);
+    TEST_ASSERT(records[1] == " [ERROR] " + tag + " error {} text", "Bad record: " + records[1]);
+    return true;
+}
+
+// Тест двоичного журнала: записи из нескольких потоков декодируются в текстовый формат
+bool test_binary_log() {
+    Logger &logger = Logger::getInstance();
+    const std::string tag = "test_binary_log_" + std::to_string(::getpid()) + "_" +
+                            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    const int kThreads = 3;
+    const int kRecords = 500;
+    const std::uint64_t dropped = logger.droppedRecords();
+    logger.setLogFormat(LogFormat::Binary);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&tag, t] {
+            for (int i = 0; i < kRecords; ++i) {
+                METRICS_LOG_INFO("{} {} {} {}", tag, t, i, 0.25 * i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    METRICS_LOG_WARN("{} {{}} {} {} {}", tag, 'c', -7, std::uint64_t(18446744073709551615ULL));
+    logger.logError(tag + " dynamic");
+    logger.flush();
+    logger.setLogFormat(LogFormat::Text);
+    TEST_ASSERT(logger.droppedRecords() == dropped, "Records were dropped");
+
+    std::ifstream file("metrics.log.bin", std::ios::binary);
+    TEST_ASSERT(file.is_open(), "Binary log was not created");
+    std::stringstream text;
+    binary_log::decodeBinaryLog(file, text);
+
+    std::string line;
+    int info = 0;
+    std::vector<std::string> others;
+    while (std::getline(text, line)) {
+        if (line.find(tag) == std::string::npos) {
+            continue;
+        }
+        std::string record = line.substr(TimestampFormatter::kSecondsLength);
+        if (record.compare(0, 8, " [INFO] ") == 0) {
+            std::istringstream fields(record.substr(8 + tag.size()));
+            int t = -1, i = -1;
+            double value = -1.0;
+            fields >> t >> i >> value;
+            TEST_ASSERT(t >= 0 && t < kThreads && value == 0.25 * i, "Bad record: " + line);
+            ++info;
+        } else {
+            others.push_back(record);
+        }
+    }
+    TEST_ASSERT(info == kThreads * kRecords, "Expected " + std::to_string(kThreads * kRecords) + " records, got " +
+                                                 std::to_string(info));
+    TEST_ASSERT(others.size() == 2, "Expected 2 other records, got " + std::to_string(others.size()));
+    TEST_ASSERT(others[0] == " [WARN] " + tag + " {} c -7 18446744073709551615", "Bad record: " + others[0]);
+    TEST_ASSERT(others[1] == " [ERROR] " + tag + " dynamic", "Bad record: " + others[1]);
+
+    // Поврежденный файл
+    std::istringstream broken(std::string("S") + "MLOGBIN1" + "R\x20");
+    std::ostringstream ignored;
+    bool thrown = false;
+    try {
+        binary_log::decodeBinaryLog(broken, ignored);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    TEST_ASSERT(thrown, "Truncated binary log was accepted");
+    return true;
+}
+
+// Тест выборки и ограничения частоты записей места вызова
+bool test_log_rate_limit() {
+    Logger &logger = Logger::getInstance();
+    const std::string tag = "test_log_rate_limit_" + std::to_string(::getpid());
+    const LogLevel saved = logger.level();
+    logger.setLevel(LogLevel::Info);
+
+    for (int i = 0; i < 25; ++i) {
+        METRICS_LOG_EVERY_N(LogLevel::Info, 10, "{} sampled {}", tag, i);
+    }
+    // Одно место вызова: запас в 3 сообщения исчерпывается сразу, а новые маркеры за время теста не появляются
+    for (int i = 0; i < 100; ++i) {
+        METRICS_LOG_RATE_LIMITED(LogLevel::Warn, 0.001, 3, "{} limited {}", tag, i);
+    }
+    logger.setLevel(saved);
+    logger.flush();
+
+    std::ifstream file("metrics.log");
+    std::string line;
+    std::vector<std::string> records;
+    while (std::getline(file, line)) {
+        if (line.find(tag) != std::string::npos) {
+            records.push_back(line.substr(TimestampFormatter::kSecondsLength));
+        }
+    }
+    const std::vector<std::string> expected = {
+        " [INFO] " + tag + " sampled 0",
+        " [INFO] " + tag + " sampled 10 (suppressed 9 messages)",
+        " [INFO] " + tag + " sampled 20 (suppressed 9 messages)",
+        " [WARN] " + tag + " limited 0",
+        " [WARN] " + tag + " limited 1",
+        " [WARN] " + tag + " limited 2"};
+    TEST_ASSERT(records.size() == expected.size(), "Expected " + std::to_string(expected.size()) + " records, got " +
+                                                       std::to_string(records.size()));
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        TEST_ASSERT(records[i] == expected[i], "Bad record: " + records[i]);
+    }
+
+    // Пополнение корзины по виртуальным часам: 50 сообщений в секунду — один маркер за 20 мс
+    VirtualClock clock;
+    LogRateLimiter limiter;
+    std::uint64_t suppressed = 0;
+    int allowed = 0;
+    for (int i = 0; i < 100; ++i) {
+        allowed += limiter.allow(50.0, 3, clock.steadyNow(), suppressed) ? 1 : 0;
+    }
+    TEST_ASSERT(allowed == 3, "Burst must allow exactly 3 messages");
+    clock.advance(std::chrono::milliseconds(10));
+    TEST_ASSERT(!limiter.allow(50.0, 3, clock.steadyNow(), suppressed), "Token appeared before 20 ms");
+    clock.advance(std::chrono::milliseconds(15));
+    TEST_ASSERT(limiter.allow(50.0, 3, clock.steadyNow(), suppressed) && suppressed == 98,
+                "Expected a token after 25 ms with 98 suppressed messages");
+    clock.advance(std::chrono::seconds(10));
+    allowed = 0;
+    for (int i = 0; i < 10; ++i) {
+        allowed += limiter.allow(50.0, 3, clock.steadyNow(), suppressed) ? 1 : 0;
+    }
+    TEST_ASSERT(allowed == 3, "Tokens must not accumulate beyond burst");
+    return true;
+}
+
+// Задача исполнителя, записывающая порядок своих обслуживаний
+class RecordingTask : public IoTask
+{
+public:
+    RecordingTask(std::string name, std::vector<std::string> &order, std::mutex &mutex)
+        : name_(std::move(name)), order_(order), mutex_(mutex) {}
+
+    std::function<void()> before_service;
+
+protected:
+    std::chrono::steady_clock::time_point service(std::chrono::steady_clock::time_point) override {
+        if (before_service) {
+            before_service();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        order_.push_back(name_);
+        return std::chrono::steady_clock::time_point::max();
+    }
+
+private:
+    std::string name_;
+    std::vector<std::string> &order_;
+    std::mutex &mutex_;
+};
+
+// Тест IoExecutor: порядок по приоритетам и запись нескольких файлов одним потоком
+bool test_io_executor() {
+    IoExecutor executor(1);
+    std::vector<std::string> order;
+    std::mutex order_mutex;
+    RecordingTask blocker("blocker", order, order_mutex);
+    RecordingTask low("low", order, order_mutex);
+    RecordingTask normal("normal", order, order_mutex);
+    RecordingTask high("high", order, order_mutex);
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    blocker.before_service = [&started, released] {
+        started.set_value();
+        released.wait();
+    };
+    executor.attach(blocker, IoPriority::Normal);
+    executor.attach(low, IoPriority::Low);
+    executor.attach(normal, IoPriority::Normal);
+    executor.attach(high, IoPriority::Low);
+
+    // Пока единственный поток занят, будятся задачи разных приоритетов
+    executor.wake(blocker);
+    started.get_future().wait();
+    executor.wake(low);
+    executor.wake(normal);
+    executor.wake(high, IoPriority::High);
+    release.set_value();
+    for (int i = 0; i < 100 && executor.services() < 4; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (IoTask *task : {static_cast<IoTask *>(&blocker), static_cast<IoTask *>(&low),
+                         static_cast<IoTask *>(&normal), static_cast<IoTask *>(&high)}) {
+        executor.detach(*task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        const std::vector<std::string> expected = {"blocker", "high", "normal", "low"};
+        TEST_ASSERT(order == expected, "Tasks were not serviced in priority order");
+    }
+
+    // Исключение одной задачи не останавливает поток исполнителя
+    RecordingTask failing("failing", order, order_mutex);
+    failing.before_service = [] { throw std::runtime_error("service failed"); };
+    executor.attach(failing, IoPriority::High);
+    executor.attach(low, IoPriority::Low);
+    executor.wake(failing);
+    executor.wake(low);
+    for (int i = 0; i < 100 && executor.services() < 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    executor.detach(failing);
+    executor.detach(low);
+    {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        TEST_ASSERT(order.size() == 5 && order.back() == "low", "Executor stopped after a failing task");
+    }
+
+    const std::string first_filename = "test_io_executor_1.txt";
+    const std::string second_filename = "test_io_executor_2.txt";
+    setup_test_environment(first_filename);
+    setup_test_environment(second_filename);
+    WriterOptions options;
+    options.executor = &executor;
+    {
+        MetricsWriter first(first_filename, options);
+        MetricsWriter second(second_filename, options);
+        for (int i = 0; i < 10; ++i) {
+            first.write({{"first", std::to_string(i)}});
+            second.write({{"second", std::to_string(i)}});
+        }
+        first.flush();
+        second.flush();
+        TEST_ASSERT(first.getStats().lines == 10 && second.getStats().lines == 10,
+                    "Shared executor did not write all lines");
+    }
+    for (const auto &filename : {first_filename, second_filename}) {
+        std::ifstream file(filename);
+        std::string line;
+        int lines = 0;
+        while (std::getline(file, line)) {
+            ++lines;
+        }
+        TEST_ASSERT(lines == 10, "Expected 10 lines in " + filename);
+        teardown_test_environment(filename);
+    }
+    TEST_ASSERT(executor.threads() == 1, "Executor must use a single thread");
+    return true;
+}
+
+// Тест собственных метрик библиотеки: размер снимка, записанные байты и глубина очереди
+bool test_self_metrics() {
+    const std::string test_filename = "test_self_metrics.txt";
+    setup_test_environment(test_filename);
+
+    auto writer = std::make_shared<MetricsWriter>(test_filename);
+    auto gauge = std::make_shared<Gauge>("self_test_gauge");
+    {
+        MetricsCollector collector;
+        collector.addSink(writer);
+        collector.addMetric(gauge);
+        collector.enableSelfMetrics("self_");
+        collector.enableSelfMetrics("self_");
+        for (int i = 0; i < 3; ++i) {
+            gauge->update(i);
+            collector.collectAndWrite();
+            writer->flush();
+        }
+    }
+    writer.reset();
+
+    std::ifstream file(test_filename);
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    TEST_ASSERT(lines.size() == 3, "Expected 3 lines in file");
+    // Значение метрики name в строке текстового формата
+    auto value = [](const std::string &text, const std::string &name) {
+        std::string key = "\"" + name + "\" ";
+        auto pos = text.find(key);
+        if (pos == std::string::npos) {
+            return std::string();
+        }
+        pos += key.size();
+        return text.substr(pos, text.find(' ', pos) - pos);
+    };
+    TEST_ASSERT(value(lines[0], "self_snapshot_samples") == "0", "First tick has no previous snapshot");
+    TEST_ASSERT(value(lines[1], "self_snapshot_samples") == "8", "Snapshot size must include self metrics");
+    TEST_ASSERT(value(lines[0], "self_bytes_written") == "0", "Nothing was written before the first tick");
+    TEST_ASSERT(value(lines[1], "self_bytes_written") == std::to_string(lines[0].size() + 1),
+                "bytes_written must equal the size of the previous line");
+    TEST_ASSERT(value(lines[2], "self_queue_depth") == "0", "Queue must be empty after flush()");
+    TEST_ASSERT(value(lines[2], "self_writer_errors") == "0", "Unexpected writer errors");
+    TEST_ASSERT(!value(lines[2], "self_write_latency_ms").empty(), "write_latency_ms is missing");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест времени сбора: в файл пишется время сбора снимка, задержка до записи попадает в гистограмму
+bool test_capture_time() {
+    const std::string test_filename = "test_capture_time.txt";
+    setup_test_environment(test_filename);
+
+    auto latency = std::make_shared<Histogram>("capture_to_durable_ms", std::vector<double>{10, 100, 1000});
+    WriterOptions options;
+    options.utc_timestamps = true;
+    options.fsync_interval = std::chrono::milliseconds(10);
+    options.durable_latency = latency;
+    {
+        MetricsWriter writer(test_filename, options);
+        // Снимок, собранный 2020-01-01 00:00:00 UTC и ожидавший записи 50 мс
+        Snapshot snapshot;
+        MetricSample sample;
+        sample.name = "captured";
+        sample.text = "1";
+        snapshot.samples.push_back(sample);
+        snapshot.captured_at = std::chrono::system_clock::from_time_t(1577836800);
+        snapshot.captured_steady = std::chrono::steady_clock::now() - std::chrono::milliseconds(50);
+        writer.write(snapshot);
+        // Время сбора снимка без него задает write()
+        writer.write({{"stamped", "2"}});
+        writer.flush();
+    }
+
+    std::ifstream file(test_filename);
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    TEST_ASSERT(lines.size() == 2, "Expected 2 lines in file");
+    TEST_ASSERT(lines[0].compare(0, 19, "2020-01-01 00:00:00") == 0, "Capture time was not written: " + lines[0]);
+    TEST_ASSERT(lines[1].compare(0, 4, "2020") != 0, "Snapshot without capture time must get the write() time");
+
+    MetricSample value;
+    latency->collect(value);
+    TEST_ASSERT(value.histogram.count == 2, "Expected 2 latency observations");
+    TEST_ASSERT(value.histogram.sum >= 50.0, "Latency must include the time before write()");
+
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест виртуальных часов: три часа сбора раз в минуту выполняются без ожидания, ротация — точно на границах часов
+bool test_virtual_clock() {
+    const std::string test_filename = "test_virtual_clock.txt";
+    setup_test_environment(test_filename);
+
+    // 2024-01-01 00:30:00 UTC
+    VirtualClock clock(std::chrono::system_clock::from_time_t(1704069000));
+    WriterOptions options;
+    options.clock = &clock;
+    options.utc_timestamps = true;
+    options.flush_bytes = 64 * 1024;
+    options.flush_interval = std::chrono::milliseconds(1000);
+    options.rotate_interval = std::chrono::hours(1);
+
+    auto real_start = std::chrono::steady_clock::now();
+    std::size_t ticks = 0;
+    {
+        MetricsCollector collector(test_filename, options);
+        auto gauge = std::make_shared<Gauge>("virtual_gauge");
+        collector.addMetric(gauge);
+        CollectionScheduler scheduler(collector, std::chrono::minutes(1), clock);
+        scheduler.onTick([&gauge](std::size_t tick) { gauge->update(static_cast<double>(tick)); });
+        ticks = scheduler.runFor(std::chrono::hours(3));
+    }
+    auto real_elapsed = std::chrono::steady_clock::now() - real_start;
+    TEST_ASSERT(ticks == 180, "Expected 180 ticks, got " + std::to_string(ticks));
+    TEST_ASSERT(real_elapsed < std::chrono::seconds(2), "Virtual time must not wait");
+
+    auto segments = SegmentArchiver::listSegments(test_filename);
+    TEST_ASSERT(segments.size() == 3, "Expected 3 hourly segments, got " + std::to_string(segments.size()));
+    std::ifstream file(test_filename);
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    TEST_ASSERT(lines.size() == 31, "Expected 31 lines after the last rotation");
+    TEST_ASSERT(lines.front().compare(0, 23, "2024-01-01 03:00:00.000") == 0, "Bad first timestamp: " + lines.front());
+    TEST_ASSERT(lines.back().compare(0, 23, "2024-01-01 03:30:00.000") == 0, "Bad last timestamp: " + lines.back());
+    TEST_ASSERT(lines.back().find("\"virtual_gauge\" 179.00") != std::string::npos, "Bad last value: " + lines.back());
+
+    for (const auto &segment : segments) {
+        std::remove(segment.c_str());
+    }
+    teardown_test_environment(test_filename);
+    return true;
+}
+
+// Тест ресурсов процесса: дескрипторы, потоки, память и процессорное время отражают нагрузку,
+// обновление стоит единицы микросекунд
+bool test_process_metrics() {
+    ProcessMetrics process("proc_");
+    ProcessStats before = process.last();
+    TEST_ASSERT(before.threads >= 1 && before.rss_bytes > 0 && before.open_fds >= 3, "Initial readings are empty");
+
+    int fds[3];
+    for (int &fd : fds) {
+        fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    std::promise<void> stop;
+    std::thread idle([future = stop.get_future()] { future.wait(); });
+    std::vector<char> memory(32 * 1024 * 1024);
+    for (std::size_t i = 0; i < memory.size(); i += 4096) {
+        memory[i] = 1;
+    }
+    volatile double sink = 0;
+    auto busy_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(30);
+    while (std::chrono::steady_clock::now() < busy_end) {
+        sink = sink + 1.0;
+    }
+
+    process.update();
+    ProcessStats after = process.last();
+    stop.set_value();
+    idle.join();
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    TEST_ASSERT(after.open_fds >= before.open_fds + 3, "Open descriptors were not counted");
+    TEST_ASSERT(after.threads >= before.threads + 1, "Thread was not counted");
+    TEST_ASSERT(after.rss_bytes >= before.rss_bytes + 16 * 1024 * 1024, "Touched memory is missing from RSS");
+    TEST_ASSERT(after.minor_faults > before.minor_faults, "Page faults were not counted");
+    TEST_ASSERT(after.cpu_user_us + after.cpu_system_us >= before.cpu_user_us + before.cpu_system_us + 10000,
+                "CPU time was not counted");
+
+    const int updates = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < updates; ++i) {
+        process.update();
+    }
+    double update_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / updates;
+    TEST_ASSERT(update_us < 100.0, "ProcessMetrics::update() is too slow: " + std::to_string(update_us) + " us");
+
+    auto sink_memory = std::make_shared<MemorySink>();
+    MetricsCollector collector;
+    collector.addSink(sink_memory);
+    collector.enableProcessMetrics();
+    collector.enableProcessMetrics();
+    collector.collectAndWrite();
+    std::string text = sink_memory->take();
+    TEST_ASSERT(text.find("\"process_rss_bytes\" ") != std::string::npos, "process_rss_bytes is missing");
+    TEST_ASSERT(text.find("\"process_threads\" ") != std::string::npos, "process_threads is missing");
+    TEST_ASSERT(text.find("\"process_cpu_time_ms\" ") == text.rfind("\"process_cpu_time_ms\" "),
+                "Process metrics were added twice");
+    return true;
+}
+
 // Структура для хранения информации о тесте
 struct TestInfo {
     const char* name;
@@ -98,7 +1793,30 @@ struct TestInfo {
 static const TestInfo TESTS[] = {
     {"test_gauge", test_gauge},
     {"test_counter", test_counter},
-    {"test_metrics_collector", test_metrics_collector}
+    {"test_metrics_collector", test_metrics_collector},
+    {"test_buffered_writer", test_buffered_writer},
+    {"test_uring_writer", test_uring_writer},
+    {"test_mmap_writer", test_mmap_writer},
+    {"test_rotation", test_rotation},
+    {"test_binary_format", test_binary_format},
+    {"test_metrics_reader", test_metrics_reader},
+    {"test_timestamp_formatter", test_timestamp_formatter},
+    {"test_value_format", test_value_format},
+    {"test_delimited_format", test_delimited_format},
+    {"test_prometheus_exporter", test_prometheus_exporter},
+    {"test_statsd_sink", test_statsd_sink},
+    {"test_influx_sink", test_influx_sink},
+    {"test_sinks_encoders", test_sinks_encoders},
+    {"test_otlp_encoder", test_otlp_encoder},
+    {"test_logger", test_logger},
+    {"test_log_levels", test_log_levels},
+    {"test_binary_log", test_binary_log},
+    {"test_log_rate_limit", test_log_rate_limit},
+    {"test_io_executor", test_io_executor},
+    {"test_self_metrics", test_self_metrics},
+    {"test_capture_time", test_capture_time},
+    {"test_virtual_clock", test_virtual_clock},
+    {"test_process_metrics", test_process_metrics}
     // Новые тесты добавляются сюда
 };
 